@@ -23,6 +23,8 @@
 #include <R_modelling/inference/sampling_distribution_draws.hpp>
 #include <R_modelling/inference/performance_divergence_draws.hpp>
 #include <R_modelling/inference/TruncatedKernelCLT.hpp>
+#include <R_modelling/inference/ParametricBootstrap.hpp>
+#include <R_modelling/inference/MovingBlockBootstrap.hpp>
 #include <R_modelling/fit.hpp>
 #include <R_modelling/forward.hpp>
 
@@ -73,18 +75,27 @@ void R_init_libprobabilistic_impl(DllInfo *dll_info) {
         {"R_ManufactureProbabilityCensoredLogScore", (DL_FUNC) &R_ManufactureCensoredLogScore, 3},
         {"R_ManufactureTickScore", (DL_FUNC) &R_ManufactureTickScore, 1},
         {"R_forward", (DL_FUNC) &R_forward, 2},
-        {"R_fit", (DL_FUNC) &R_fit, 12},
+        {"R_fit", (DL_FUNC) &R_fit, 14},
+        {"R_fit_replications", (DL_FUNC) &R_fit_replications, 11},
         {"R_parameters", (DL_FUNC) &R_parameters, 1},
         {"R_change_parameters", (DL_FUNC) &R_change_parameters, 2},
         {"R_average_score", (DL_FUNC) &R_average_score, 3},
         {"R_average_score_out_of_sample", (DL_FUNC) &R_average_score_out_of_sample, 4},
+        {"R_average_score_rolling_window", (DL_FUNC) &R_average_score_rolling_window, 8},
         {"R_draw_observations", (DL_FUNC) &R_draw_observations, 3},
         {"R_sampling_distribution_draws", (DL_FUNC) &R_sampling_distribution_draws, 2},
+        {"R_sampling_distribution_parameter_draws", (DL_FUNC) &R_sampling_distribution_parameter_draws, 5},
         {"R_performance_divergence_draws", (DL_FUNC) &R_performance_divergence_draws, 3},
+        {"R_performance_divergence_cumulants", (DL_FUNC) &R_performance_divergence_cumulants, 3},
+        {"R_performance_divergence_cdf", (DL_FUNC) &R_performance_divergence_cdf, 3},
+        {"R_performance_divergence_quantile", (DL_FUNC) &R_performance_divergence_quantile, 3},
         {"R_ManufactureTruncatedKernelCLT", (DL_FUNC) &R_ManufactureTruncatedKernelCLT, 2},
+        {"R_ManufactureParametricBootstrap", (DL_FUNC) &R_ManufactureParametricBootstrap, 5},
+        {"R_ManufactureMovingBlockBootstrap", (DL_FUNC) &R_ManufactureMovingBlockBootstrap, 5},
         {"R_empirical_coverage", (DL_FUNC) &R_empirical_coverage, 6},
-        {"R_empirical_coverage_expanding_window_obs", (DL_FUNC) &R_empirical_coverage_expanding_window_obs, 6},
-        {"R_empirical_coverage_expanding_window_noobs", (DL_FUNC) &R_empirical_coverage_expanding_window_noobs, 5},
+        {"R_empirical_coverage_expanding_window_obs", (DL_FUNC) &R_empirical_coverage_expanding_window_obs, 10},
+        {"R_empirical_coverage_expanding_window_noobs", (DL_FUNC) &R_empirical_coverage_expanding_window_noobs, 9},
+        {"R_empirical_coverage_rolling_window", (DL_FUNC) &R_empirical_coverage_rolling_window, 10},
         {nullptr, nullptr, 0}
     };
     
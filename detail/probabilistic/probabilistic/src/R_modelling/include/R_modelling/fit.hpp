@@ -17,7 +17,23 @@ extern "C" {
         SEXP tolerance_change_R,
         SEXP maximum_optimiser_iterations_R,
         SEXP timeout_in_seconds_R,
-        SEXP return_diagnostics_R
+        SEXP return_diagnostics_R,
+        SEXP num_threads_R,
+        SEXP intra_op_threads_R
+    );
+
+    DLL_PUBLIC SEXP R_fit_replications(
+        SEXP model_R,
+        SEXP scoring_rule_R,
+        SEXP data_dict_R,
+        SEXP learning_rate_R,
+        SEXP barrier_begin_R,
+        SEXP barrier_end_R,
+        SEXP barrier_decay_R,
+        SEXP tolerance_grad_R,
+        SEXP tolerance_change_R,
+        SEXP maximum_optimiser_iterations_R,
+        SEXP timeout_in_seconds_R
     );
 }
 
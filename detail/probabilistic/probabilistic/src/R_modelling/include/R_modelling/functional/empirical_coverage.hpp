@@ -21,7 +21,11 @@ extern "C" {
         SEXP open_lower_probability_R,
         SEXP closed_upper_probability_R,
         SEXP complement_R,
-        SEXP min_in_sample_times_R
+        SEXP min_in_sample_times_R,
+        SEXP num_threads_R,
+        SEXP refit_every_R,
+        SEXP num_newton_steps_R,
+        SEXP chain_length_R
     );
 
     DLL_PUBLIC SEXP R_empirical_coverage_expanding_window_noobs(
@@ -29,7 +33,24 @@ extern "C" {
         SEXP open_lower_probability_R,
         SEXP closed_upper_probability_R,
         SEXP complement_R,
-        SEXP min_in_sample_times_R
+        SEXP min_in_sample_times_R,
+        SEXP num_threads_R,
+        SEXP refit_every_R,
+        SEXP num_newton_steps_R,
+        SEXP chain_length_R
+    );
+
+    DLL_PUBLIC SEXP R_empirical_coverage_rolling_window(
+        SEXP model_R,
+        SEXP data_dict_R,
+        SEXP open_lower_probability_R,
+        SEXP closed_upper_probability_R,
+        SEXP complement_R,
+        SEXP window_size_R,
+        SEXP num_threads_R,
+        SEXP refit_every_R,
+        SEXP num_newton_steps_R,
+        SEXP chain_length_R
     );
 
 } 
@@ -0,0 +1,17 @@
+#ifndef PROBABILISTIC_R_MODELLING_MOVING_BLOCK_BOOTSTRAP_HPP_GUARD
+#define PROBABILISTIC_R_MODELLING_MOVING_BLOCK_BOOTSTRAP_HPP_GUARD
+
+#include <Rinternals.h>
+#include <dll_visibility.h>
+
+extern "C" {
+    DLL_PUBLIC SEXP R_ManufactureMovingBlockBootstrap(
+        SEXP fit_R,
+        SEXP num_replications_R,
+        SEXP block_size_R,
+        SEXP gap_size_R,
+        SEXP num_threads_R
+    );
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef PROBABILISTIC_R_MODELLING_PARAMETRIC_BOOTSTRAP_HPP_GUARD
+#define PROBABILISTIC_R_MODELLING_PARAMETRIC_BOOTSTRAP_HPP_GUARD
+
+#include <Rinternals.h>
+#include <dll_visibility.h>
+
+extern "C" {
+    DLL_PUBLIC SEXP R_ManufactureParametricBootstrap(
+        SEXP fit_R,
+        SEXP num_replications_R,
+        SEXP burn_in_size_R,
+        SEXP first_draw_R,
+        SEXP num_threads_R
+    );
+}
+
+#endif
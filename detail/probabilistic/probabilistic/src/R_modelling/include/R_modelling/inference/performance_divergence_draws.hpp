@@ -10,6 +10,28 @@ extern "C" {
         SEXP scoring_rule_R,
         SEXP num_draws_R
     );
+
+    // The closed-form cumulants of the performance divergence, from the mean
+    // and variance on, without drawing.
+    DLL_PUBLIC SEXP R_performance_divergence_cumulants(
+        SEXP sampling_distribution_R,
+        SEXP scoring_rule_R,
+        SEXP num_cumulants_R
+    );
+
+    // The saddlepoint approximations to the cdf of the performance divergence
+    // at values_R, and to its quantiles at probabilities_R.
+    DLL_PUBLIC SEXP R_performance_divergence_cdf(
+        SEXP sampling_distribution_R,
+        SEXP scoring_rule_R,
+        SEXP values_R
+    );
+
+    DLL_PUBLIC SEXP R_performance_divergence_quantile(
+        SEXP sampling_distribution_R,
+        SEXP scoring_rule_R,
+        SEXP probabilities_R
+    );
 }
 
 #endif
@@ -9,6 +9,17 @@ extern "C" {
         SEXP sampling_distribution_R,
         SEXP num_draws_R
     );
+
+    // A list of the draws of the parameters, as a matrix with a row for each
+    // draw, the columns of each parameter, and, if score_R, the average score
+    // of the observations under each draw.
+    DLL_PUBLIC SEXP R_sampling_distribution_parameter_draws(
+        SEXP sampling_distribution_R,
+        SEXP num_draws_R,
+        SEXP observations_R,
+        SEXP scoring_rule_R,
+        SEXP score_R
+    );
 }
 
 #endif
@@ -17,6 +17,17 @@ extern "C" {
         SEXP scoring_rule_R,
         SEXP in_sample_times_R
     );
+
+    DLL_PUBLIC SEXP R_average_score_rolling_window(
+        SEXP model_R,
+        SEXP observations_R,
+        SEXP scoring_rule_R,
+        SEXP window_size_R,
+        SEXP num_threads_R,
+        SEXP refit_every_R,
+        SEXP num_newton_steps_R,
+        SEXP chain_length_R
+    );
 }
 
 #endif
@@ -0,0 +1,29 @@
+#include <Rinternals.h>
+#include <R_support/handle_exception.hpp>
+#include <R_support/memory.hpp>
+#include <R_protect_guard.hpp>
+#include <torch/torch.h>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/inference/ParametricBootstrap.hpp>
+#include <R_modelling/inference/ParametricBootstrap.hpp>
+
+SEXP R_ManufactureParametricBootstrap(
+    SEXP fit_R,
+    SEXP num_replications_R,
+    SEXP burn_in_size_R,
+    SEXP first_draw_R,
+    SEXP num_threads_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+    return shared_ptr_to_EXTPTRSXP(
+        ManufactureParametricBootstrap(
+            EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(fit_R),
+            INTEGER(num_replications_R)[0],
+            INTEGER(burn_in_size_R)[0],
+            REAL(first_draw_R)[0],
+            INTEGER(num_threads_R)[0]
+        ),
+        protect_guard
+    );
+});}
@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <Rinternals.h>
 #include <R_support/handle_exception.hpp>
 #include <R_support/memory.hpp>
 #include <R_protect_guard.hpp>
 #include <torch/torch.h>
+#include <modelling/functional/average_score.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <R_modelling/model/average_score.hpp>
 
@@ -98,3 +100,57 @@ SEXP R_average_score_out_of_sample(
     return ret_R;
 });}
 
+SEXP R_average_score_rolling_window(
+    SEXP model_R,
+    SEXP observations_R,
+    SEXP scoring_rule_R,
+    SEXP window_size_R,
+    SEXP num_threads_R,
+    SEXP refit_every_R,
+    SEXP num_newton_steps_R,
+    SEXP chain_length_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+
+    auto model = EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(model_R);
+    std::shared_ptr<torch::OrderedDict<std::string, torch::Tensor>> observations;
+    if (!Rf_isNull(observations_R)) { observations = EXTPTRSXP_to_shared_ptr<torch::OrderedDict<std::string, torch::Tensor>>(observations_R); }
+    std::shared_ptr<const ScoringRule> scoring_rule;
+    if (!Rf_isNull(scoring_rule_R)) { scoring_rule = EXTPTRSXP_to_shared_ptr<ScoringRule>(scoring_rule_R); }
+    int window_size = INTEGER(window_size_R)[0];
+    int num_threads = INTEGER(num_threads_R)[0];
+    int refit_every = INTEGER(refit_every_R)[0];
+    int num_newton_steps = INTEGER(num_newton_steps_R)[0];
+    int chain_length = INTEGER(chain_length_R)[0];
+
+    torch::Tensor per_origin;
+    auto avg = average_score_rolling_window(
+        model,
+        observations ? *observations : model->observations(),
+        std::move(scoring_rule),
+        window_size,
+        &per_origin,
+        /* time_dimension = */ -1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+
+    SEXP ret_R = protect_guard.protect(Rf_allocVector(VECSXP, 2));
+    SEXP ret_R_names = protect_guard.protect(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(ret_R_names, 0, Rf_mkChar("average"));
+    SET_STRING_ELT(ret_R_names, 1, Rf_mkChar("per_origin"));
+    Rf_setAttrib(ret_R, R_NamesSymbol, ret_R_names);
+
+    SEXP average_R = protect_guard.protect(Rf_allocVector(REALSXP, 1));
+    REAL(average_R)[0] = avg.item<double>();
+    SET_VECTOR_ELT(ret_R, 0, average_R);
+
+    auto per_origin_c = per_origin.to(torch::kDouble).contiguous();
+    SEXP per_origin_R = protect_guard.protect(Rf_allocVector(REALSXP, per_origin_c.numel()));
+    std::copy(per_origin_c.data_ptr<double>(), per_origin_c.data_ptr<double>() + per_origin_c.numel(), REAL(per_origin_R));
+    SET_VECTOR_ELT(ret_R, 1, per_origin_R);
+
+    return ret_R;
+});}
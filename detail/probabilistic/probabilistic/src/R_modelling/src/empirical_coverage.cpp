@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <R.h>
 #include <Rinternals.h>
@@ -51,7 +53,11 @@ SEXP R_empirical_coverage_expanding_window_obs(
     SEXP open_lower_probability_R,
     SEXP closed_upper_probability_R,
     SEXP complement_R,
-    SEXP min_in_sample_times_R
+    SEXP min_in_sample_times_R,
+    SEXP num_threads_R,
+    SEXP refit_every_R,
+    SEXP num_newton_steps_R,
+    SEXP chain_length_R
 ) { return R_handle_exception([&](){
     R_protect_guard protect_guard;
 
@@ -61,6 +67,10 @@ SEXP R_empirical_coverage_expanding_window_obs(
     double closed_upper_probability = REAL(closed_upper_probability_R)[0];
     int complement = LOGICAL(complement_R)[0];
     int min_in_sample_times = INTEGER(min_in_sample_times_R)[0];
+    int num_threads = INTEGER(num_threads_R)[0];
+    int refit_every = INTEGER(refit_every_R)[0];
+    int num_newton_steps = INTEGER(num_newton_steps_R)[0];
+    int chain_length = INTEGER(chain_length_R)[0];
 
     SEXP ret_R = protect_guard.protect(Rf_allocVector(REALSXP, 1));
     REAL(ret_R)[0] = empirical_coverage_expanding_window(
@@ -69,7 +79,12 @@ SEXP R_empirical_coverage_expanding_window_obs(
         open_lower_probability,
         closed_upper_probability,
         complement,
-        min_in_sample_times
+        min_in_sample_times,
+        /* time_dimension = */ -1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
     ).item<double>();
 
     return ret_R;
@@ -80,7 +95,11 @@ SEXP R_empirical_coverage_expanding_window_noobs(
     SEXP open_lower_probability_R,
     SEXP closed_upper_probability_R,
     SEXP complement_R,
-    SEXP min_in_sample_times_R
+    SEXP min_in_sample_times_R,
+    SEXP num_threads_R,
+    SEXP refit_every_R,
+    SEXP num_newton_steps_R,
+    SEXP chain_length_R
 ) { return R_handle_exception([&](){
     R_protect_guard protect_guard;
 
@@ -89,6 +108,10 @@ SEXP R_empirical_coverage_expanding_window_noobs(
     double closed_upper_probability = REAL(closed_upper_probability_R)[0];
     int complement = LOGICAL(complement_R)[0];
     int min_in_sample_times = INTEGER(min_in_sample_times_R)[0];
+    int num_threads = INTEGER(num_threads_R)[0];
+    int refit_every = INTEGER(refit_every_R)[0];
+    int num_newton_steps = INTEGER(num_newton_steps_R)[0];
+    int chain_length = INTEGER(chain_length_R)[0];
     
     SEXP ret_R = protect_guard.protect(Rf_allocVector(REALSXP, 1));
     REAL(ret_R)[0] = empirical_coverage_expanding_window(
@@ -96,10 +119,75 @@ SEXP R_empirical_coverage_expanding_window_noobs(
         open_lower_probability,
         closed_upper_probability,
         complement,
-        min_in_sample_times
+        min_in_sample_times,
+        /* time_dimension = */ -1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
    ).item<double>();
 
     return ret_R;
 
 });}
 
+
+SEXP R_empirical_coverage_rolling_window(
+    SEXP model_R,
+    SEXP data_dict_R,
+    SEXP open_lower_probability_R,
+    SEXP closed_upper_probability_R,
+    SEXP complement_R,
+    SEXP window_size_R,
+    SEXP num_threads_R,
+    SEXP refit_every_R,
+    SEXP num_newton_steps_R,
+    SEXP chain_length_R
+) { return R_handle_exception([&](){
+    R_protect_guard protect_guard;
+
+    auto model = EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(model_R);
+    std::shared_ptr<torch::OrderedDict<std::string, torch::Tensor>> data;
+    if (!Rf_isNull(data_dict_R)) { data = EXTPTRSXP_to_shared_ptr<torch::OrderedDict<std::string, torch::Tensor>>(data_dict_R); }
+    double open_lower_probability = REAL(open_lower_probability_R)[0];
+    double closed_upper_probability = REAL(closed_upper_probability_R)[0];
+    int complement = LOGICAL(complement_R)[0];
+    int window_size = INTEGER(window_size_R)[0];
+    int num_threads = INTEGER(num_threads_R)[0];
+    int refit_every = INTEGER(refit_every_R)[0];
+    int num_newton_steps = INTEGER(num_newton_steps_R)[0];
+    int chain_length = INTEGER(chain_length_R)[0];
+
+    torch::Tensor per_origin;
+    auto avg = empirical_coverage_rolling_window(
+        model,
+        data ? *data : model->observations(),
+        open_lower_probability,
+        closed_upper_probability,
+        complement,
+        window_size,
+        &per_origin,
+        /* time_dimension = */ -1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+
+    SEXP ret_R = protect_guard.protect(Rf_allocVector(VECSXP, 2));
+    SEXP ret_R_names = protect_guard.protect(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(ret_R_names, 0, Rf_mkChar("average"));
+    SET_STRING_ELT(ret_R_names, 1, Rf_mkChar("per_origin"));
+    Rf_setAttrib(ret_R, R_NamesSymbol, ret_R_names);
+
+    SEXP average_R = protect_guard.protect(Rf_allocVector(REALSXP, 1));
+    REAL(average_R)[0] = avg.item<double>();
+    SET_VECTOR_ELT(ret_R, 0, average_R);
+
+    auto per_origin_c = per_origin.to(torch::kDouble).contiguous();
+    SEXP per_origin_R = protect_guard.protect(Rf_allocVector(REALSXP, per_origin_c.numel()));
+    std::copy(per_origin_c.data_ptr<double>(), per_origin_c.data_ptr<double>() + per_origin_c.numel(), REAL(per_origin_R));
+    SET_VECTOR_ELT(ret_R, 1, per_origin_R);
+
+    return ret_R;
+});}
@@ -1,13 +1,17 @@
+#include <cstring>
 #include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 #include <R.h>
 #include <Rinternals.h>
 #include <R_protect_guard.hpp>
+#include <boost_log_R/sink_backend.hpp>
 #include <R_support/handle_exception.hpp>
 #include <R_support/memory.hpp>
 #include <torch/torch.h>
+#include <libtorch_support/parallel.hpp>
 #include <modelling/fit.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/score/ScoringRule.hpp>
@@ -126,7 +130,9 @@ SEXP R_fit(
     SEXP tolerance_change_R,
     SEXP maximum_optimiser_iterations_R,
     SEXP timeout_in_seconds_R,
-    SEXP return_diagnostics_R
+    SEXP return_diagnostics_R,
+    SEXP num_threads_R,
+    SEXP intra_op_threads_R
 ) { return R_handle_exception([&](){
     R_protect_guard protect_guard;
 
@@ -141,6 +147,8 @@ SEXP R_fit(
     int maximum_optimiser_iterations = INTEGER(maximum_optimiser_iterations_R)[0];
     int timeout_in_seconds = INTEGER(timeout_in_seconds_R)[0];
     int return_diagnostics = LOGICAL(return_diagnostics_R)[0];
+    int num_threads = INTEGER(num_threads_R)[0];
+    int intra_op_threads = INTEGER(intra_op_threads_R)[0];
 
     int64_t nmodels = Rf_length(models_R);
 
@@ -166,51 +174,119 @@ SEXP R_fit(
     lbfgs_options.tolerance_grad(tolerance_grad);
     lbfgs_options.tolerance_change(tolerance_change);
 
-    auto fit_i = [&](int64_t i, const auto& model, FitDiagnostics *diagnostics_ptr) {
-        bool success;
+    // Models are fit on a pool of C++ worker threads, whereas R objects are only
+    // touched on this thread, both before the pool starts and after it joins.
+    std::vector<std::shared_ptr<ProbabilisticModule>> models; models.reserve(nmodels);
+    for (int64_t i = 0; i != nmodels; ++i) {
+        models.emplace_back(EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(VECTOR_ELT(models_R, i)));
+    }
+
+    std::vector<std::shared_ptr<ProbabilisticModule>> fit_models(nmodels);
+    std::vector<char> success(nmodels, false);
+    std::vector<FitDiagnostics> diagnostics(return_diagnostics ? nmodels : 0);
+
+    parallel_for(nmodels, num_threads, intra_op_threads, [&](int64_t i) {
+        bool success_i;
+        fit_models.at(i) = fit(
+            models.at(i),
+            data,
+            scoring_rule,
+            barrier_begin,
+            barrier_end,
+            barrier_decay,
+            maximum_optimiser_iterations,
+            timeout_in_seconds,
+            lbfgs_options,
+            return_diagnostics ? &diagnostics.at(i) : nullptr,
+            &success_i
+        );
+        success.at(i) = success_i;
+    });
+    flush_boost_log_R_sink_backend();
+
+    for (int64_t i = 0; i != nmodels; ++i) {
         SET_VECTOR_ELT(
             fit_models_R,
             i,
             shared_ptr_to_EXTPTRSXP<ProbabilisticModule, torch::nn::Module>(
-                fit(
-                    model,
-                    data,
-                    scoring_rule,
-                    barrier_begin,
-                    barrier_end,
-                    barrier_decay,
-                    maximum_optimiser_iterations,
-                    timeout_in_seconds,
-                    lbfgs_options,
-                    diagnostics_ptr,
-                    &success
-                ),
+                fit_models.at(i),
                 protect_guard
             )
         );
         SEXP success_R_i = Rf_allocVector(LGLSXP, 1);
-        LOGICAL(success_R_i)[0] = success;
+        LOGICAL(success_R_i)[0] = success.at(i);
         SET_VECTOR_ELT(success_R, i, success_R_i);
-    };
-
-    for (int64_t i = 0; i != nmodels; ++i) {
-        auto model = EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(VECTOR_ELT(models_R, i));
         if (return_diagnostics) {
-            FitDiagnostics diagnostics;
-            fit_i(i, model, &diagnostics);
             SET_VECTOR_ELT(
                 diagnostics_R,
                 i,
                 fit_diagnostics_to_R_list(
-                    diagnostics,
+                    diagnostics.at(i),
                     protect_guard
                 )
             );
-        } else {
-            fit_i(i, model, nullptr);
         }
     }
 
     return ret_R;
 });}
 
+
+SEXP R_fit_replications(
+    SEXP model_R,
+    SEXP scoring_rule_R,
+    SEXP data_dict_R,
+    SEXP learning_rate_R,
+    SEXP barrier_begin_R,
+    SEXP barrier_end_R,
+    SEXP barrier_decay_R,
+    SEXP tolerance_grad_R,
+    SEXP tolerance_change_R,
+    SEXP maximum_optimiser_iterations_R,
+    SEXP timeout_in_seconds_R
+) { return R_handle_exception([&](){
+    R_protect_guard protect_guard;
+
+    auto model = EXTPTRSXP_to_shared_ptr<ProbabilisticModule, torch::nn::Module>(model_R);
+    auto scoring_rule = EXTPTRSXP_to_shared_ptr<ScoringRule>(scoring_rule_R);
+    auto data = EXTPTRSXP_to_shared_ptr<torch::OrderedDict<std::string, torch::Tensor>>(data_dict_R);
+    FitPlan plan;
+    plan.learning_rate = REAL(learning_rate_R)[0];
+    plan.barrier_begin = REAL(barrier_begin_R)[0];
+    plan.barrier_end = REAL(barrier_end_R)[0];
+    plan.barrier_decay = REAL(barrier_decay_R)[0];
+    plan.tolerance_grad = REAL(tolerance_grad_R)[0];
+    plan.tolerance_change = REAL(tolerance_change_R)[0];
+    plan.maximum_optimiser_iterations = INTEGER(maximum_optimiser_iterations_R)[0];
+    plan.timeout_in_seconds = INTEGER(timeout_in_seconds_R)[0];
+
+    std::vector<char> success;
+    auto fit_models = model->fit_replications(*data, scoring_rule, plan, &success);
+    int64_t nreplications = fit_models.size();
+
+    SEXP ret_R = protect_guard.protect(Rf_allocVector(VECSXP, 2));
+    SEXP ret_R_names = Rf_allocVector(STRSXP, 2);
+    Rf_setAttrib(ret_R, R_NamesSymbol, ret_R_names);
+
+    SEXP fit_models_R = Rf_allocVector(VECSXP, nreplications);
+    SET_VECTOR_ELT(ret_R, 0, fit_models_R);
+    SET_STRING_ELT(ret_R_names, 0, Rf_mkChar("models"));
+
+    SEXP success_R = Rf_allocVector(LGLSXP, nreplications);
+    SET_VECTOR_ELT(ret_R, 1, success_R);
+    SET_STRING_ELT(ret_R_names, 1, Rf_mkChar("success"));
+
+    for (int64_t i = 0; i != nreplications; ++i) {
+        SET_VECTOR_ELT(
+            fit_models_R,
+            i,
+            shared_ptr_to_EXTPTRSXP<ProbabilisticModule, torch::nn::Module>(
+                fit_models.at(i),
+                protect_guard
+            )
+        );
+        LOGICAL(success_R)[i] = success.at(i);
+    }
+
+    return ret_R;
+});}
@@ -1,15 +1,50 @@
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <Rinternals.h>
 #include <R_support/handle_exception.hpp>
 #include <R_support/memory.hpp>
 #include <R_protect_guard.hpp>
 #include <torch/torch.h>
+#include <modelling/distribution/Distribution.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/inference/SamplingDistribution.hpp>
 #include <R_modelling/inference/performance_divergence_draws.hpp>
 
 #include <log/trivial.hpp>
 
+// The distribution of the performance divergence under scoring_rule_R, or
+// the scoring rule of the fit if scoring_rule_R is NULL.
+static std::shared_ptr<Distribution> performance_divergence_distribution(
+    const SamplingDistribution& sampling_distribution,
+    SEXP scoring_rule_R
+) {
+    bool scoring_rule_R_null = Rf_isNull(scoring_rule_R);
+    std::shared_ptr<ScoringRule> scoring_rule;
+    if (!scoring_rule_R_null) { scoring_rule = EXTPTRSXP_to_shared_ptr<ScoringRule>(scoring_rule_R); }
+    if (!scoring_rule_R_null && !scoring_rule) {
+        throw std::logic_error("!scoring_rule_R_null && !scoring_rule");
+    }
+    auto out = [&]() {
+        if (scoring_rule_R_null) {
+            return sampling_distribution.get_performance_divergence_distribution();
+        }
+        return sampling_distribution.get_performance_divergence_distribution(*scoring_rule);
+    }();
+    if (!out) {
+        throw std::logic_error("!performance_divergence_distribution");
+    }
+    return out;
+}
+
+static SEXP tensor_to_REALSXP(const torch::Tensor& x, R_protect_guard& protect_guard) {
+    auto x_c = x.to(torch::kDouble).contiguous();
+    auto x_numel = x_c.numel();
+    SEXP out = protect_guard.protect(Rf_allocVector(REALSXP, x_numel));
+    std::copy(x_c.data_ptr<double>(), x_c.data_ptr<double>() + x_numel, REAL(out));
+    return out;
+}
+
 SEXP R_performance_divergence_draws(
     SEXP sampling_distribution_R,
     SEXP scoring_rule_R,
@@ -17,30 +52,16 @@ SEXP R_performance_divergence_draws(
 ) { return R_handle_exception([&]() {
     R_protect_guard protect_guard;
     auto sampling_distribution = EXTPTRSXP_to_shared_ptr<SamplingDistribution>(sampling_distribution_R);
-    bool scoring_rule_R_null = Rf_isNull(scoring_rule_R);
-    std::shared_ptr<ScoringRule> scoring_rule;
-    if (!scoring_rule_R_null) { scoring_rule = EXTPTRSXP_to_shared_ptr<ScoringRule>(scoring_rule_R); }
     auto num_draws = INTEGER(num_draws_R)[0];
     SEXP draws_out = protect_guard.protect(Rf_allocVector(REALSXP, num_draws));
     auto draws_out_a = REAL(draws_out);
     if (!sampling_distribution) {
         throw std::logic_error("!sampling_distribution");
     }
-    if (!scoring_rule_R_null && !scoring_rule) {
-        throw std::logic_error("!scoring_rule_R_null && !scoring_rule");
-    }
     PROBABILISTIC_LOG_TRIVIAL_INFO << "Begin drawing predictive accuracy from a sampling distribution estimate for a \""
                                    << sampling_distribution->get_fit_ref().name() << "\" model.";
-    auto performance_divergence_distribution = [&]() {
-        if (scoring_rule_R_null) {
-            return sampling_distribution->get_performance_divergence_distribution();
-        }
-        return sampling_distribution->get_performance_divergence_distribution(*scoring_rule);
-    }();
-    if (!performance_divergence_distribution) {
-        throw std::logic_error("!performance_divergence_distribution");
-    }
-    auto draws_in = performance_divergence_distribution->generate(num_draws, 0, 0.0).front().value();
+    auto distribution = performance_divergence_distribution(*sampling_distribution, scoring_rule_R);
+    auto draws_in = distribution->generate(num_draws, 0, 0.0).front().value();
     auto draws_in_a = draws_in.accessor<double, 1>();
     for (decltype(num_draws) i = 0; i != num_draws; ++i) {
         draws_out_a[i] = draws_in_a[i];
@@ -49,3 +70,51 @@ SEXP R_performance_divergence_draws(
     return draws_out;
 });}
 
+SEXP R_performance_divergence_cumulants(
+    SEXP sampling_distribution_R,
+    SEXP scoring_rule_R,
+    SEXP num_cumulants_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+    auto sampling_distribution = EXTPTRSXP_to_shared_ptr<SamplingDistribution>(sampling_distribution_R);
+    if (!sampling_distribution) {
+        throw std::logic_error("!sampling_distribution");
+    }
+    auto distribution = performance_divergence_distribution(*sampling_distribution, scoring_rule_R);
+    auto num_cumulants = INTEGER(num_cumulants_R)[0];
+    return tensor_to_REALSXP(distribution->cumulants(num_cumulants).front().value(), protect_guard);
+});}
+
+SEXP R_performance_divergence_cdf(
+    SEXP sampling_distribution_R,
+    SEXP scoring_rule_R,
+    SEXP values_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+    auto sampling_distribution = EXTPTRSXP_to_shared_ptr<SamplingDistribution>(sampling_distribution_R);
+    if (!sampling_distribution) {
+        throw std::logic_error("!sampling_distribution");
+    }
+    auto distribution = performance_divergence_distribution(*sampling_distribution, scoring_rule_R);
+    auto num_values = Rf_xlength(values_R);
+    auto values = torch::from_blob(REAL(values_R), {static_cast<int64_t>(num_values)}, torch::kDouble);
+    auto name = distribution->cumulants(1).front().key();
+    return tensor_to_REALSXP(distribution->cdf({{name, values}}).front().value(), protect_guard);
+});}
+
+SEXP R_performance_divergence_quantile(
+    SEXP sampling_distribution_R,
+    SEXP scoring_rule_R,
+    SEXP probabilities_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+    auto sampling_distribution = EXTPTRSXP_to_shared_ptr<SamplingDistribution>(sampling_distribution_R);
+    if (!sampling_distribution) {
+        throw std::logic_error("!sampling_distribution");
+    }
+    auto distribution = performance_divergence_distribution(*sampling_distribution, scoring_rule_R);
+    auto num_probabilities = Rf_xlength(probabilities_R);
+    auto probabilities = torch::from_blob(REAL(probabilities_R), {static_cast<int64_t>(num_probabilities)}, torch::kDouble);
+    auto name = distribution->cumulants(1).front().key();
+    return tensor_to_REALSXP(distribution->quantile({{name, probabilities}}).front().value(), protect_guard);
+});}
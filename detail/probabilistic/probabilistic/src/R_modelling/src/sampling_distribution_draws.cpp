@@ -1,3 +1,5 @@
+#include <cstring>
+#include <stdexcept>
 #include <Rinternals.h>
 #include <R_support/handle_exception.hpp>
 #include <R_support/memory.hpp>
@@ -5,6 +7,7 @@
 #include <torch/torch.h>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/inference/ParameterDraws.hpp>
 #include <R_modelling/inference/sampling_distribution_draws.hpp>
 
 #include <log/trivial.hpp>
@@ -27,3 +30,73 @@ SEXP R_sampling_distribution_draws(
     return draws;
 });}
 
+
+SEXP R_sampling_distribution_parameter_draws(
+    SEXP sampling_distribution_R,
+    SEXP num_draws_R,
+    SEXP observations_R,
+    SEXP scoring_rule_R,
+    SEXP score_R
+) { return R_handle_exception([&]() {
+    R_protect_guard protect_guard;
+    auto sampling_distribution = EXTPTRSXP_to_shared_ptr<SamplingDistribution>(sampling_distribution_R);
+    if (!sampling_distribution) {
+        throw std::logic_error("!sampling_distribution");
+    }
+    const auto& fit = sampling_distribution->get_fit_ref();
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "Begin drawing parameters, without cloning the model, from a sampling distribution estimate for a \""
+                                   << fit.name() << "\" model.";
+    auto num_draws = INTEGER(num_draws_R)[0];
+    ParameterDraws draws(fit, sampling_distribution->draw_parameters(num_draws));
+
+    SEXP out = protect_guard.protect(Rf_allocVector(VECSXP, 3));
+    SEXP out_names = protect_guard.protect(Rf_allocVector(STRSXP, 3));
+    SET_STRING_ELT(out_names, 0, Rf_mkChar("draws"));
+    SET_STRING_ELT(out_names, 1, Rf_mkChar("indices"));
+    SET_STRING_ELT(out_names, 2, Rf_mkChar("average_scores"));
+    Rf_setAttrib(out, R_NamesSymbol, out_names);
+
+    // R matrices are column-major, so copy the transpose.
+    auto matrix = draws.matrix().t().to(torch::kDouble).contiguous();
+    auto num_parameters = matrix.size(0);
+    SEXP draws_R = protect_guard.protect(Rf_allocMatrix(REALSXP, num_draws, num_parameters));
+    std::memcpy(REAL(draws_R), matrix.data_ptr<double>(), sizeof(double)*matrix.numel());
+    SET_VECTOR_ELT(out, 0, draws_R);
+
+    // The columns of each parameter, indexed from one.
+    const auto& indices = draws.indices();
+    auto num_indices = indices.size();
+    SEXP indices_R = protect_guard.protect(Rf_allocVector(VECSXP, num_indices));
+    SEXP indices_R_names = protect_guard.protect(Rf_allocVector(STRSXP, num_indices));
+    auto columns = torch::arange(num_parameters, torch::kLong);
+    for (decltype(num_indices) i = 0; i != num_indices; ++i) {
+        const auto& item = indices[i];
+        SET_STRING_ELT(indices_R_names, i, Rf_mkChar(item.key().c_str()));
+        auto columns_i = columns.index({item.value()}).contiguous();
+        auto num_columns_i = columns_i.numel();
+        SEXP indices_R_i = Rf_allocVector(INTSXP, num_columns_i);
+        SET_VECTOR_ELT(indices_R, i, indices_R_i);
+        auto columns_i_a = columns_i.accessor<int64_t, 1>();
+        for (int64_t j = 0; j != num_columns_i; ++j) {
+            INTEGER(indices_R_i)[j] = columns_i_a[j] + 1;
+        }
+    }
+    Rf_setAttrib(indices_R, R_NamesSymbol, indices_R_names);
+    SET_VECTOR_ELT(out, 1, indices_R);
+
+    if (LOGICAL(score_R)[0]) {
+        const auto& observations = Rf_isNull(observations_R) ?
+            fit.observations() :
+            *EXTPTRSXP_to_shared_ptr<torch::OrderedDict<std::string, torch::Tensor>>(observations_R);
+        std::shared_ptr<const ScoringRule> scoring_rule = Rf_isNull(scoring_rule_R) ?
+            fit.scoring_rule() :
+            EXTPTRSXP_to_shared_ptr<ScoringRule>(scoring_rule_R);
+        auto average_scores = draws.average_scores(observations, *scoring_rule).to(torch::kDouble).contiguous();
+        SEXP average_scores_R = protect_guard.protect(Rf_allocVector(REALSXP, num_draws));
+        std::memcpy(REAL(average_scores_R), average_scores.data_ptr<double>(), sizeof(double)*num_draws);
+        SET_VECTOR_ELT(out, 2, average_scores_R);
+    }
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "End drawing.";
+    return out;
+});}
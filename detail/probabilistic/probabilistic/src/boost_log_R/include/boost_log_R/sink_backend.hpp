@@ -16,5 +16,8 @@ class R_sink_backend :
 
 void initialise_boost_log_R_sink_backend(void);
 
+// Prints messages logged from threads other than R's main thread. Call from the main thread.
+void flush_boost_log_R_sink_backend(void);
+
 #endif
 
@@ -1,3 +1,8 @@
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <boost/log/attributes/value_extraction_fwd.hpp>
 #include <boost/log/attributes/value_extraction.hpp>
 #include <boost/log/core.hpp>
@@ -9,24 +14,62 @@
 #include <R_ext/Print.h>
 #include "boost_log_R/sink_backend.hpp"
 
+namespace {
+
+    // R's print functions may only be called from R's main thread, so messages
+    // logged on any other thread are queued and printed by the main thread
+    // when it next logs, or flushes.
+    std::thread::id R_main_thread_id;
+    std::mutex deferred_messages_mutex;
+    std::vector<std::pair<bool, std::string>> deferred_messages;
+
+    void R_print(bool is_error, const std::string& message) {
+        if (is_error) {
+            REprintf("%s\n", message.c_str());
+        } else {
+            Rprintf("%s\n", message.c_str());
+        }
+    }
+
+    void R_print_deferred_messages(void) {
+        std::vector<std::pair<bool, std::string>> messages;
+        {
+            std::lock_guard<std::mutex> lock(deferred_messages_mutex);
+            messages.swap(deferred_messages);
+        }
+        for (const auto& message : messages) {
+            R_print(message.first, message.second);
+        }
+    }
+
+}
+
 void R_sink_backend::consume(const boost::log::record_view& record, const string_type& message) {
+    bool is_error = false;
     const boost::log::attribute_value_set& values = record.attribute_values();
     auto it = values.find(boost::log::aux::default_attribute_names::severity());
     if (it != values.end()) {
         const boost::log::attribute_value& value = it->second;
         auto record_severity = value.extract<boost::log::trivial::severity_level>();
-        if (record_severity && record_severity.get() < boost::log::trivial::error) {
-            Rprintf("%s\n", message.c_str());
-        } else {
-            REprintf("%s\n", message.c_str());
-        }
+        is_error = !(record_severity && record_severity.get() < boost::log::trivial::error);
+    }
+    if (std::this_thread::get_id() == R_main_thread_id) {
+        R_print_deferred_messages();
+        R_print(is_error, message);
     } else {
-        Rprintf("%s\n", message.c_str());
+        std::lock_guard<std::mutex> lock(deferred_messages_mutex);
+        deferred_messages.emplace_back(is_error, message);
     }
 }
 
 void initialise_boost_log_R_sink_backend(void) {
+    R_main_thread_id = std::this_thread::get_id();
     auto sink = boost::make_shared<boost::log::sinks::synchronous_sink<R_sink_backend>>();
     boost::log::core::get()->add_sink(sink);
 }
 
+void flush_boost_log_R_sink_backend(void) {
+    if (std::this_thread::get_id() == R_main_thread_id) {
+        R_print_deferred_messages();
+    }
+}
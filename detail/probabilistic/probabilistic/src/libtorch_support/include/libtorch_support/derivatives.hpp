@@ -2,6 +2,7 @@
 #define PROBABILISTIC_LIBTORCH_SUPPORT_DERIVATIVES_HPP_GUARD
 
 #include <utility>
+#include <vector>
 #include <std_specialisations/hash.hpp>
 #include <torch/torch.h>
 #include <libtorch_support/missing.hpp>
@@ -18,6 +19,18 @@ torch::Tensor jacobian(
     double na_jac = missing::na
 );
 
+// Output of jacobian is dy/dx for each of x, with the backward passes shared
+// between them, so there are as many as the elements of y in reverse mode,
+// or one more than the elements of x in forward mode.
+std::vector<torch::Tensor> jacobian(
+    const torch::Tensor& y,
+    const std::vector<torch::Tensor>& x,
+    JacobianMode mode = JacobianMode::Auto,
+    bool create_graph = false,
+    bool allow_unused = false,
+    double na_jac = missing::na
+);
+
 template<class T>
 torch::OrderedDict<T, torch::Tensor> jacobian(
     const torch::OrderedDict<T, torch::Tensor>& y,
@@ -43,9 +56,11 @@ torch::OrderedDict<T, torch::Tensor> jacobian(
     bool allow_unused = false,
     double na_jac = missing::na
 ) {
-    torch::OrderedDict<T, torch::Tensor> out;
+    auto jac = jacobian(y, x.values(), mode, create_graph, allow_unused, na_jac);
+    torch::OrderedDict<T, torch::Tensor> out; out.reserve(x.size());
+    int64_t i = 0;
     for (const auto& x_item : x) {
-        out.insert(x_item.key(), jacobian(y, x_item.value(), mode, create_graph, allow_unused, na_jac));
+        out.insert(x_item.key(), std::move(jac[i++]));
     }
     return out;
 }
@@ -62,29 +77,63 @@ torch::OrderedDict<T1, torch::OrderedDict<T2, torch::Tensor>> jacobian(
     torch::OrderedDict<T1, torch::OrderedDict<T2, torch::Tensor>> out;
     out.reserve(y.size());
     for (const auto& y_item : y) {
-        torch::OrderedDict<T2, torch::Tensor> out_nested;
-        out_nested.reserve(x.size());
-        const auto& y_item_value = y_item.value();
-        for (const auto& x_item : x) {
-            out_nested.insert(x_item.key(), jacobian(y_item_value, x_item.value(), mode, create_graph, allow_unused, na_jac));
-        }
-        out.insert(y_item.key(), std::move(out_nested));
+        out.insert(y_item.key(), jacobian(y_item.value(), x, mode, create_graph, allow_unused, na_jac));
     }
     return out;
 }
 
-// For torch::Tensors y and x, output of hessian is d2y/dx2 as a tensor of shape cat(y.sizes(), x.sizes(), x.sizes()).
-template<class Y, class X>
-auto hessian(
-    const Y& y,
-    const X& x,
-    JacobianMode mode_nested = JacobianMode::Auto,
-    JacobianMode mode_enclosing = JacobianMode::Auto,
-    bool create_graph = false,
+// For a scalar y, output of hessian is d2y/dx2 as a tensor of shape
+// cat(x.sizes(), x.sizes()). It is built from Hessian-vector products on the
+// upper triangle, and mirrored. If gradient is given, it receives dy/dx,
+// detached, so the first order graph is not kept beyond the call.
+torch::Tensor hessian(
+    const torch::Tensor& y,
+    const torch::Tensor& x,
+    torch::Tensor* gradient = nullptr,
+    bool allow_unused = false,
+    double na_hess = missing::na
+);
+
+// As hessian, with block [i][j] of shape cat(x[i].sizes(), x[j].sizes()).
+// Only blocks with j >= i are computed, so the saving is in the off-diagonal
+// blocks; each diagonal block still takes one backward pass per element. Blocks for parameters y does not
+// depend on, or depends on linearly, are zero without any backward passes.
+std::vector<std::vector<torch::Tensor>> hessian(
+    const torch::Tensor& y,
+    const std::vector<torch::Tensor>& x,
+    std::vector<torch::Tensor>* gradient = nullptr,
+    bool allow_unused = false,
+    double na_hess = missing::na
+);
+
+template<class T>
+torch::OrderedDict<T, torch::OrderedDict<T, torch::Tensor>> hessian(
+    const torch::Tensor& y,
+    const torch::OrderedDict<T, torch::Tensor>& x,
+    torch::OrderedDict<T, torch::Tensor>* gradient = nullptr,
     bool allow_unused = false,
     double na_hess = missing::na
 ) {
-    return jacobian(jacobian(y, x, mode_nested, true, allow_unused, na_hess), x, mode_enclosing, create_graph, allow_unused, na_hess);
+    std::vector<torch::Tensor> gradients;
+    auto hess = hessian(y, x.values(), gradient ? &gradients : nullptr, allow_unused, na_hess);
+    const auto& keys = x.keys();
+    auto x_size = keys.size();
+    torch::OrderedDict<T, torch::OrderedDict<T, torch::Tensor>> out; out.reserve(x_size);
+    for (decltype(x_size) i = 0; i != x_size; ++i) {
+        torch::OrderedDict<T, torch::Tensor> out_i; out_i.reserve(x_size);
+        for (decltype(x_size) j = 0; j != x_size; ++j) {
+            out_i.insert(keys[j], std::move(hess[i][j]));
+        }
+        out.insert(keys[i], std::move(out_i));
+    }
+    if (gradient) {
+        gradient->clear();
+        gradient->reserve(x_size);
+        for (decltype(x_size) i = 0; i != x_size; ++i) {
+            gradient->insert(keys[i], std::move(gradients[i]));
+        }
+    }
+    return out;
 }
 
 #endif
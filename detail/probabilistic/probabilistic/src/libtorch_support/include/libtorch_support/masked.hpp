@@ -0,0 +1,118 @@
+#ifndef PROBABILISTIC_MASKED_HPP_GUARD
+#define PROBABILISTIC_MASKED_HPP_GUARD
+
+#include <utility>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+
+// missing::handle_na finds where an operation's output is missing by running
+// it a second time, on clones of its arguments with NaN in place of na. As
+// missing.hpp notes, we can avoid that if we know, for the kind of operation,
+// where missing values ought to appear in the output. MaskedTensor carries a
+// presence mask alongside the values, and the functions below propagate it
+// with a rule for each kind of operation, so that each operation is run once,
+// on the values as they are, with no clones:
+//     elementwise: missing if any broadcast argument is missing,
+//     matmul: missing if any element of the row or column is missing,
+//     reduce: missing if any element along the reduced dimension is missing.
+// As with handle_na, outputs that are NaN are also missing. Values that are
+// missing always hold na, so they stay safe to feed to further operations,
+// and torch::where keeps their gradients out of the present values.
+
+namespace missing {
+
+    class MaskedTensor {
+        public:
+            // Missing where values are na.
+            explicit MaskedTensor(torch::Tensor values_in):
+                present_mask(is_present(values_in)),
+                vals(std::move(values_in))
+            { }
+
+            // Missing where present_in is false, or values_in is NaN.
+            MaskedTensor(torch::Tensor values_in, torch::Tensor present_in):
+                present_mask(present_in.logical_and(values_in.detach().isnan().logical_not())),
+                vals(torch::where(present_mask, values_in, values_in.new_full({}, na)))
+            { }
+
+            const torch::Tensor& values(void) const {
+                return vals;
+            }
+
+            const torch::Tensor& present(void) const {
+                return present_mask;
+            }
+
+            // The values, with na where missing, as handle_na returns them.
+            const torch::Tensor& to_na(void) const {
+                return vals;
+            }
+
+        private:
+            torch::Tensor present_mask;
+            torch::Tensor vals;
+    };
+
+    inline torch::Tensor all_present(const MaskedTensor& arg) {
+        return arg.present();
+    }
+
+    template<class... T>
+    torch::Tensor all_present(const MaskedTensor& arg, const T&... args) {
+        return arg.present().logical_and(all_present(args...));
+    }
+
+    template<class OP, class... T>
+    MaskedTensor elementwise(OP&& op, const T&... args) {
+        return MaskedTensor(op(args.values()...), all_present(args...));
+    }
+
+    inline MaskedTensor matmul(const MaskedTensor& lhs, const MaskedTensor& rhs) {
+        // A row of lhs and a column of rhs give a missing element if either
+        // has a missing element, so only the row and column masks are needed.
+        auto lhs_rows = lhs.present().ndimension() > 1 ? lhs.present().all(-1) : lhs.present().all();
+        auto rhs_cols = rhs.present().ndimension() > 1 ? rhs.present().all(-2) : rhs.present().all();
+        if (lhs.present().ndimension() > 1 && rhs.present().ndimension() > 1) {
+            lhs_rows = lhs_rows.unsqueeze(-1);
+            rhs_cols = rhs_cols.unsqueeze(-2);
+        }
+        return MaskedTensor(torch::matmul(lhs.values(), rhs.values()), lhs_rows.logical_and(rhs_cols));
+    }
+
+    // lhs [..., n, k] times rhs [..., k]. Any leading dimensions of rhs lead
+    // those of lhs, as for parameters stacked along a leading batch dimension,
+    // so that each batch of lhs is multiplied by its own row of rhs.
+    inline MaskedTensor matvec(const MaskedTensor& lhs, const MaskedTensor& rhs) {
+        if (rhs.present().ndimension() <= 1) {
+            return matmul(lhs, rhs);
+        }
+        auto rhs_values = rhs.values();
+        auto rhs_present = rhs.present();
+        while (rhs_values.ndimension() < lhs.values().ndimension() - 1) {
+            rhs_values = rhs_values.unsqueeze(-2);
+            rhs_present = rhs_present.unsqueeze(-2);
+        }
+        auto out = matmul(lhs, MaskedTensor(rhs_values.unsqueeze(-1), rhs_present.unsqueeze(-1)));
+        return MaskedTensor(out.values().squeeze(-1), out.present().squeeze(-1));
+    }
+
+    // op reduces its argument over dim, without keeping it.
+    template<class OP>
+    MaskedTensor reduce(OP&& op, const MaskedTensor& x, int64_t dim) {
+        return MaskedTensor(op(x.values(), dim), x.present().all(dim));
+    }
+
+    // Drop-in replacements for handle_na, for the kinds of operation above.
+
+    template<class OP, class... T>
+    torch::Tensor handle_na_elementwise(OP&& op, const T&... args) {
+        return elementwise(std::forward<OP>(op), MaskedTensor(args)...).to_na();
+    }
+
+    inline torch::Tensor handle_na_matmul(const torch::Tensor& lhs, const torch::Tensor& rhs) {
+        return matmul(MaskedTensor(lhs), MaskedTensor(rhs)).to_na();
+    }
+
+};
+
+#endif
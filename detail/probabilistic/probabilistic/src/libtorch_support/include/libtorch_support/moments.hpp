@@ -2,9 +2,11 @@
 #define PROBABILISTIC_LIBTORCH_SUPPORT_MOMENTS_HPP_GUARD
 
 #include <numeric>
+#include <cmath>
 #include <limits>
 #include <sstream>
 #include <vector>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/indexing.hpp>
 #include <libtorch_support/time_series.hpp>
@@ -254,6 +256,20 @@ torch::OrderedDict<T1, torch::OrderedDict<T2, torch::Tensor>> cross_covariance_m
     return cross_covariance_matrix(x, y, na_cov, dimensions_across_observations);
 }
 
+// The cross covariance matrices of x with lag(x, t_dim, j, na_cov), for
+// j = 0, ..., num_lags - 1, stacked along the first dimension, with the same
+// missing value semantics as cross_covariance_matrix. Rather than lag x and
+// form the outer products for each lag, the centred values and presence
+// indicators are multiplied once per lag as shifted views, with one GEMM
+// giving the sums and the pair sample sizes together. The mean of each
+// lagged series only shifts the centred values, so it is applied afterwards.
+torch::Tensor lagged_cross_covariance_matrices(
+    const torch::Tensor& x,
+    int64_t t_dim,
+    int64_t num_lags,
+    double na_cov = missing::na
+);
+
 // Need to double check that using the max sample size is appropriate.
 // In fact, we assume that for each parameterisation the sample size is
 // either zero or identical for each other parameter (or each element of
@@ -282,6 +298,26 @@ double truncated_kernel_lag_multiplier(
     return out;
 }
 
+// The number of lags, counting lag zero, over which the truncated kernel
+// sums the cross covariances, the square root of the sample size. As for
+// truncated_kernel_lag_multiplier, each element's sample size is either
+// zero or the sample size, so the maximum is the sample size.
+template<class T>
+int64_t truncated_kernel_num_lags(const torch::OrderedDict<T, torch::Tensor>& x_sample_size) {
+    int64_t max_x_sample_size = 0;
+    for (const auto& item : x_sample_size) {
+        const auto& item_value = item.value();
+        if (!item_value.numel()) continue;
+        auto max_candidate = static_cast<torch::Tensor>(item_value.max()).item<int64_t>();
+        if (max_candidate > max_x_sample_size) {
+            max_x_sample_size = max_candidate;
+        }
+    }
+
+    int64_t k = std::llround(std::sqrt(static_cast<double>(max_x_sample_size)));
+    return k < 1 ? 1 : k;
+}
+
 template<class T>
 torch::OrderedDict<T, torch::OrderedDict<T, torch::Tensor>> truncated_kernel_asymptotic_covariance_matrix(
     const torch::OrderedDict<T, torch::Tensor>& x,
@@ -298,21 +334,57 @@ torch::OrderedDict<T, torch::OrderedDict<T, torch::Tensor>> truncated_kernel_asy
 
     auto x_sample_size = sample_size(x, index_set, na_cov);
 
-    auto min_x_sample_size = std::numeric_limits<int64_t>::max();
+    int64_t k = dependent ? truncated_kernel_num_lags(x_sample_size) : 1;
+
+    // Stack the vectors along their last dimension, so that every pair of
+    // them is covered by the same products.
+    std::vector<int64_t> observation_sizes;
     for (const auto& item : x) {
-        auto min_candidate = static_cast<torch::Tensor>(item.value().min()).item<int64_t>();
-        if (min_candidate < min_x_sample_size) {
-            min_x_sample_size = min_candidate;
-        }
+        auto item_sizes = item.value().sizes();
+        auto item_observation_sizes = item_sizes.slice(0, item_sizes.size()-1);
+        observation_sizes = observation_sizes.empty() ?
+            item_observation_sizes.vec() :
+            at::infer_size(observation_sizes, item_observation_sizes);
+    }
+    std::vector<torch::Tensor> x_stacked; x_stacked.reserve(x.size());
+    std::vector<int64_t> offsets; offsets.reserve(x.size() + 1);
+    offsets.emplace_back(0);
+    for (const auto& item : x) {
+        auto item_sizes = observation_sizes;
+        item_sizes.emplace_back(item.value().sizes().back());
+        x_stacked.emplace_back(item.value().expand(item_sizes));
+        offsets.emplace_back(offsets.back() + item_sizes.back());
     }
 
-    auto k = std::llround(std::sqrt(static_cast<double>(min_x_sample_size)));
-
-    auto out = cross_covariance_matrix(x, x, na_cov);
-    if (dependent) for (int64_t j = 1; j < k; ++j) {
+    auto covariances = lagged_cross_covariance_matrices(torch::cat(x_stacked, -1), t_dim, k, na_cov);
+    // As with the arithmetic on dictionaries, an element is missing if it is
+    // missing for any lag.
+    auto out_stacked = missing::MaskedTensor(covariances[0]);
+    for (int64_t j = 1; j < covariances.size(0); ++j) {
         auto lag_multiplier = truncated_kernel_lag_multiplier(x_sample_size, j);
-        auto cov_x_x_lagged_t = cross_covariance_matrix(x, lag(x, t_dim, j, na_cov));
-        out += lag_multiplier*(cov_x_x_lagged_t + transpose(cov_x_x_lagged_t));
+        auto cov_x_x_lagged_t = covariances[j];
+        out_stacked = missing::elementwise(
+            [lag_multiplier](const torch::Tensor& out_j, const torch::Tensor& cov, const torch::Tensor& cov_t) {
+                return out_j + lag_multiplier*(cov + cov_t);
+            },
+            out_stacked,
+            missing::MaskedTensor(cov_x_x_lagged_t),
+            missing::MaskedTensor(cov_x_x_lagged_t.t())
+        );
+    }
+
+    torch::OrderedDict<T, torch::OrderedDict<T, torch::Tensor>> out; out.reserve(x.size());
+    int64_t i = 0;
+    for (const auto& item_i : x) {
+        auto out_stacked_i = out_stacked.to_na().narrow(0, offsets[i], offsets[i+1] - offsets[i]);
+        torch::OrderedDict<T, torch::Tensor> out_i; out_i.reserve(x.size());
+        int64_t j = 0;
+        for (const auto& item_j : x) {
+            out_i.insert(item_j.key(), out_stacked_i.narrow(1, offsets[j], offsets[j+1] - offsets[j]));
+            ++j;
+        }
+        out.insert(item_i.key(), std::move(out_i));
+        ++i;
     }
 
     return out;
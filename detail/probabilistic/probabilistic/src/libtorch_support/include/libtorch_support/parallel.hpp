@@ -0,0 +1,20 @@
+#ifndef PROBABILISTIC_LIBTORCH_SUPPORT_PARALLEL_HPP_GUARD
+#define PROBABILISTIC_LIBTORCH_SUPPORT_PARALLEL_HPP_GUARD
+
+#include <cstdint>
+#include <functional>
+
+// Calls task(i) for each i in [0, n), spreading the calls over num_workers threads.
+// Each worker thread sets its own libtorch intra-op thread budget to intra_op_threads,
+// or, if intra_op_threads <= 0, to an even share of the threads available to the caller.
+// If num_workers <= 1 the tasks run in order on the calling thread, which keeps its
+// intra-op thread budget. The first exception thrown by a task is rethrown on the
+// calling thread, once all workers have joined.
+void parallel_for(
+    int64_t n,
+    int64_t num_workers,
+    int64_t intra_op_threads,
+    const std::function<void(int64_t)>& task
+);
+
+#endif
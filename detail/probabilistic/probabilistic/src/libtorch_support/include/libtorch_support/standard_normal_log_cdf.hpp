@@ -1,7 +1,15 @@
 #ifndef PROBABILISTIC_STANDARD_NORMAL_LOG_CDF_HPP_GUARD
 #define PROBABILISTIC_STANDARD_NORMAL_LOG_CDF_HPP_GUARD
 
+#include <torch/torch.h>
+
 torch::Tensor standard_normal_log_cdf(torch::Tensor x);
 
-#endif
+// log(Phi(z_ub) - Phi(z_lb)), from whichever tail keeps the difference away
+// from cancellation, and -inf where z_ub <= z_lb.
+torch::Tensor standard_normal_log_interval_probability(const torch::Tensor& z_lb, const torch::Tensor& z_ub);
 
+// log(Phi(z_lb) + 1 - Phi(z_ub)), at most zero.
+torch::Tensor standard_normal_log_interval_complement_probability(const torch::Tensor& z_lb, const torch::Tensor& z_ub);
+
+#endif
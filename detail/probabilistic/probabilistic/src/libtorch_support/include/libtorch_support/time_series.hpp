@@ -39,6 +39,27 @@ std::vector<T> lag(
 torch::Tensor diff(const torch::Tensor& x, int64_t t_dim = -1);
 // by default make t_dim the last dimension.
 
+torch::Tensor take_times(const torch::Tensor& x, const torch::Tensor& times, int64_t t_dim = -1, double na_l = missing::na);
+// x at the times along t_dim given by the integer tensor times, with na_l
+// where times is out of range. The last dimension of times replaces t_dim,
+// and any leading dimensions of times lead the output, as for replications
+// stacked along a leading dimension. x is gathered once, by index_select,
+// rather than sliced into pieces and concatenated.
+
+template<class T>
+torch::OrderedDict<T, torch::Tensor> take_times(
+    const torch::OrderedDict<T, torch::Tensor>& x,
+    const torch::Tensor& times,
+    int64_t t_dim = -1,
+    double na_l = missing::na
+) {
+    torch::OrderedDict<T, torch::Tensor> out; out.reserve(x.size());
+    for (const auto& item : x) {
+        out.insert(item.key(), take_times(item.value(), times, t_dim, na_l));
+    }
+    return out;
+}
+
 class SampleSplitter {
     public:
         SampleSplitter(int64_t in_sample_times_in, int64_t time_dimension_in = -1):
@@ -631,12 +631,11 @@ torch::Tensor Simplex::get(void) {
         throw std::logic_error("Simplex::get called, but parameter disabled.");
     }
 
-    auto parameter_numel = parameter.numel();
-
-    parameter_on_paper = parameter.new_empty({parameter_numel+1});
-    parameter_on_paper.index_put_({torch::indexing::Slice(0, parameter_numel)}, parameter_scaling.item<double>()*parameter);
-    parameter_on_paper.index_put_({parameter_numel}, 0.0);
-    parameter_on_paper = parameter_on_paper.softmax(0);
+    // Along the last dimension, so that parameters stacked along leading
+    // dimensions give a point of the simplex for each row.
+    auto last_sizes = parameter.sizes().vec();
+    last_sizes.back() = 1;
+    parameter_on_paper = torch::cat({parameter_scaling.item<double>()*parameter, parameter.new_zeros(last_sizes)}, -1).softmax(-1);
 
     return parameter_on_paper;
 }
@@ -1,156 +1,290 @@
 #include <limits>
+#include <sstream>
+#include <stdexcept>
 #include <vector>
 #include <torch/torch.h>
 #include <libtorch_support/derivatives.hpp>
 
-// Inspired by https://gist.github.com/apaszke/226abdf867c4e9d6698bd198f3b45fb7.
+namespace {
 
-torch::Tensor jacobian_reverse_mode(
+    std::vector<int64_t> jacobian_sizes(const torch::Tensor& y, const torch::Tensor& x) {
+        auto y_shape = y.sizes();
+        auto x_shape = x.sizes();
+        std::vector<int64_t> grad_shape; grad_shape.reserve(y_shape.size() + x_shape.size());
+        grad_shape.insert(grad_shape.end(), y_shape.cbegin(), y_shape.cend());
+        grad_shape.insert(grad_shape.end(), x_shape.cbegin(), x_shape.cend());
+        return grad_shape;
+    }
+
+    // A fresh one-hot grad_output for each backward pass. If the graph is
+    // created, the backward pass may save grad_output for the next order, so
+    // it must not be reused and overwritten.
+    torch::Tensor one_hot(int64_t n, int64_t i) {
+        auto out = torch::zeros({n}, torch::kDouble);
+        out.accessor<double, 1>()[i] = 1.0;
+        return out;
+    }
+
+}
+
+// Inspired by https://gist.github.com/apaszke/226abdf867c4e9d6698bd198f3b45fb7.
+// Each backward pass gives the gradient of one element of y with respect to
+// all of x at once, so the number of passes is the number of elements of y,
+// however many tensors x holds.
+std::vector<torch::Tensor> jacobian_reverse_mode(
     const torch::Tensor& y,
-    const torch::Tensor& x,
+    const std::vector<torch::Tensor>& x,
     bool create_graph,
     bool allow_unused
 ) {
-    auto x_shape = x.sizes();
-    auto y_shape = y.sizes();
     auto flat_y = y.reshape({-1});
     auto ny = flat_y.numel();
-    
-    std::vector<int64_t> grad_shape;
-    grad_shape.insert(grad_shape.end(), y_shape.cbegin(), y_shape.cend());
-    grad_shape.insert(grad_shape.end(), x_shape.cbegin(), x_shape.cend());
-    
-    auto grad_output = torch::zeros_like(flat_y, torch::kDouble);
-    auto grad_output_a = grad_output.accessor<double, 1>();
-    
-    std::vector<torch::Tensor> grad_vec;
-
-    // If y and x don't belong on the same computation graph, then torch::autograd::grad returns an empty Tensor.
-    // In fact, we want to return all zeros instead, so for the first grad_output, return zeroes if the gradient
-    // is an empty vector.
-    grad_output_a[0] = 1.0;
-    auto grad_vec_0 = torch::autograd::grad({flat_y}, {x}, {grad_output}, true, create_graph, allow_unused).at(0);
-    if (allow_unused && grad_vec_0.numel() == 0) {
-        return y.new_zeros(grad_shape, torch::kDouble);
+    auto x_size = x.size();
+
+    std::vector<std::vector<torch::Tensor>> grad_vecs(x_size);
+    for (auto& grad_vec : grad_vecs) { grad_vec.reserve(ny); }
+
+    // If y and x don't belong on the same computation graph, then torch::autograd::grad returns an undefined Tensor.
+    // In fact, we want to return all zeros instead. This is the same for every element of y.
+    std::vector<bool> used(x_size, true);
+    for (int64_t i = 0; i < ny; ++i) { // Reverse mode means this loop is over y.
+        auto grads = torch::autograd::grad({flat_y}, x, {one_hot(ny, i)}, true, create_graph, allow_unused);
+        for (decltype(x_size) k = 0; k != x_size; ++k) {
+            if (!grads[k].defined()) {
+                used[k] = false;
+            } else if (used[k]) {
+                grad_vecs[k].emplace_back(grads[k].reshape(x[k].sizes()));
+            }
+        }
     }
-    grad_vec.emplace_back(grad_vec_0.reshape(x_shape));
-    grad_output_a[0] = 0.0;
 
-    for (int64_t i = 1; i < ny; ++i) { // Reverse mode means this loop is over y. Note that i = 0 was completed above.
-        grad_output_a[i] = 1.0;
-        grad_vec.emplace_back(torch::autograd::grad({flat_y}, {x}, {grad_output}, true, create_graph, allow_unused).at(0).reshape(x_shape));
-        grad_output_a[i] = 0.0;
+    std::vector<torch::Tensor> out; out.reserve(x_size);
+    for (decltype(x_size) k = 0; k != x_size; ++k) {
+        auto grad_shape = jacobian_sizes(y, x[k]);
+        if (!used[k] || !ny) {
+            out.emplace_back(y.new_zeros(grad_shape, torch::kDouble));
+        } else {
+            out.emplace_back(torch::stack(grad_vecs[k]).reshape(grad_shape));
+        }
     }
+    return out;
+}
 
-    return torch::stack(grad_vec).reshape(grad_shape);
+torch::Tensor jacobian_reverse_mode(
+    const torch::Tensor& y,
+    const torch::Tensor& x,
+    bool create_graph,
+    bool allow_unused
+) {
+    return jacobian_reverse_mode(y, std::vector<torch::Tensor>{x}, create_graph, allow_unused).at(0);
 }
 
 
 // Forward mode version inspired by https://colab.research.google.com/drive/1tcm7Lvdv0krpPdaYHtWe7NA2bDbEQ0uj
-torch::Tensor jacobian_forward_mode(
+// The first reverse mode pass is shared by all of x, leaving one pass for
+// each element of x.
+std::vector<torch::Tensor> jacobian_forward_mode(
     const torch::Tensor& y,
-    const torch::Tensor& x,
+    const std::vector<torch::Tensor>& x,
     bool create_graph,
     bool allow_unused
 ) {
-    auto x_shape = x.sizes();
-    auto flat_x = x.reshape({-1});
-    auto nx = flat_x.numel();
     auto y_shape = y.sizes();
     auto flat_y = y.reshape({-1});
     auto ny = flat_y.numel();
-
-    std::vector<int64_t> grad_shape;
-    grad_shape.insert(grad_shape.end(), y_shape.cbegin(), y_shape.cend());
-    grad_shape.insert(grad_shape.end(), x_shape.cbegin(), x_shape.cend());
+    auto x_size = x.size();
 
     // To achieve forward mode with two reverse mode passes, we take the
     // derivative of the first reverse mode pass using any vector.
     auto any_vector = torch::ones({ny}, torch::requires_grad().dtype(torch::kDouble));
-    auto vjp = torch::autograd::grad({flat_y}, {x}, {any_vector}, true, true, allow_unused).at(0)/*.reshape({-1})*/;
-    if (allow_unused && vjp.numel() == 0) {
-        return y.new_zeros(grad_shape, torch::kDouble);
-    }
-    vjp = vjp.reshape({-1});
-    
-    // Now pick off the vectors dy_./dx_i.
-    auto grad_output = torch::zeros_like(flat_x, torch::kDouble);
-    auto grad_output_a = grad_output.accessor<double, 1>();
-    std::vector<torch::Tensor> grad_vec;
-    for (int64_t i = 0; i != nx; ++i) { // Forward mode means this loop is over x.
-        grad_output_a[i] = 1.0;
-        grad_vec.emplace_back(torch::autograd::grad({vjp}, {any_vector}, {grad_output}, true, create_graph, allow_unused).at(0).reshape(y_shape));
-        grad_output_a[i] = 0.0;
+    auto vjps = torch::autograd::grad({flat_y}, x, {any_vector}, true, true, allow_unused);
+
+    std::vector<torch::Tensor> out; out.reserve(x_size);
+    for (decltype(x_size) k = 0; k != x_size; ++k) {
+        auto grad_shape = jacobian_sizes(y, x[k]);
+        const auto& vjp = vjps[k];
+        if (!vjp.defined() || !ny) {
+            out.emplace_back(y.new_zeros(grad_shape, torch::kDouble));
+            continue;
+        }
+        auto flat_vjp = vjp.reshape({-1});
+        auto nx = flat_vjp.numel();
+
+        // Now pick off the vectors dy_./dx_i.
+        std::vector<torch::Tensor> grad_vec; grad_vec.reserve(nx);
+        for (int64_t i = 0; i != nx; ++i) { // Forward mode means this loop is over x.
+            auto grad = torch::autograd::grad({flat_vjp}, {any_vector}, {one_hot(nx, i)}, true, create_graph, true).at(0);
+            grad_vec.emplace_back(grad.defined() ? grad.reshape(y_shape) : y.new_zeros(y_shape, torch::kDouble));
+        }
+        out.emplace_back(torch::stack(grad_vec, y.ndimension()).reshape(grad_shape));
     }
-    return torch::stack(grad_vec, y.ndimension()).reshape(grad_shape);
+    return out;
 }
 
-torch::Tensor jacobian(
+torch::Tensor jacobian_forward_mode(
     const torch::Tensor& y,
     const torch::Tensor& x,
+    bool create_graph,
+    bool allow_unused
+) {
+    return jacobian_forward_mode(y, std::vector<torch::Tensor>{x}, create_graph, allow_unused).at(0);
+}
+
+torch::Tensor set_missing_jacobian(
+    const torch::Tensor& jac,
+    const torch::Tensor& y,
+    const torch::Tensor& x,
+    double na_jac
+) {
+    auto y_detach = y.detach();
+    auto y_is_missing = y_detach.eq(na_jac);
+    auto y_is_missing_sizes = y_is_missing.sizes().vec();
+    y_is_missing_sizes.insert(y_is_missing_sizes.end(), x.ndimension(), 1);
+    auto jac_is_missing = torch::logical_or(y_is_missing.reshape(y_is_missing_sizes), x.detach().eq(na_jac));
+    return jac.masked_fill(jac_is_missing, missing::na);
+}
+
+std::vector<torch::Tensor> jacobian(
+    const torch::Tensor& y,
+    const std::vector<torch::Tensor>& x,
     JacobianMode mode,
     bool create_graph,
     bool allow_unused,
     double na_jac
 ) {
-    auto get_jac_no_missings = [&](const torch::Tensor& xn, const torch::Tensor& yn) {
-        switch(mode) {
-            case JacobianMode::Auto :
-                if (yn.numel() > xn.numel()) {
-                    return jacobian_forward_mode(yn, xn, create_graph, allow_unused);
-                } else {
-                    return jacobian_reverse_mode(yn, xn, create_graph, allow_unused);
-                }
-                break;
-            case JacobianMode::Forward :
-                return jacobian_forward_mode(yn, xn, create_graph, allow_unused);
-                break;
-            case JacobianMode::Reverse :
-                return jacobian_reverse_mode(yn, xn, create_graph, allow_unused);
-                break;
-        }
-    };
-
-    if (na_jac == 0.0) {
-        return get_jac_no_missings(x,y);
-    } else {
-        auto y_detach = y.detach();
-        auto y_sizes = y_detach.sizes();
-
-        auto x_detach = x.detach();
-        auto x_sizes = x_detach.sizes();
-        
-        auto jac_ndimension = y_detach.ndimension() + x_detach.ndimension();
-        std::vector<int64_t> jac_sizes; jac_sizes.reserve(jac_ndimension);
-        for (const auto& yi : y_sizes) { jac_sizes.emplace_back(yi); }
-        for (const auto& xi : x_sizes) { jac_sizes.emplace_back(xi); }
-
-        auto x_is_missing = x_detach.eq(na_jac);
-        while(x_is_missing.ndimension() < jac_ndimension) {
-            x_is_missing.unsqueeze_(0);
-        }
-        x_is_missing = x_is_missing.expand(jac_sizes);
+    if (mode == JacobianMode::Auto) {
+        int64_t nx = 0;
+        for (const auto& xk : x) { nx += xk.numel(); }
+        mode = y.numel() > nx ? JacobianMode::Forward : JacobianMode::Reverse;
+    }
 
-        auto y_is_missing = y_detach.eq(na_jac);
-        while(y_is_missing.ndimension() < jac_ndimension) {
-            y_is_missing.unsqueeze_(y_is_missing.ndimension());
+    auto out = mode == JacobianMode::Forward ?
+        jacobian_forward_mode(y, x, create_graph, allow_unused) :
+        jacobian_reverse_mode(y, x, create_graph, allow_unused);
+
+    if (na_jac != 0.0) {
+        auto x_size = x.size();
+        for (decltype(x_size) k = 0; k != x_size; ++k) {
+            out[k] = set_missing_jacobian(out[k], y, x[k], na_jac);
         }
-        y_is_missing = y_is_missing.expand(jac_sizes);
+    }
 
-        auto jac_is_missing = torch::logical_or(x_is_missing, y_is_missing);
+    return out;
+}
+
+torch::Tensor jacobian(
+    const torch::Tensor& y,
+    const torch::Tensor& x,
+    JacobianMode mode,
+    bool create_graph,
+    bool allow_unused,
+    double na_jac
+) {
+    return jacobian(y, std::vector<torch::Tensor>{x}, mode, create_graph, allow_unused, na_jac).at(0);
+}
+
+// Row i of the blocks is found from Hessian-vector products with the unit
+// vectors for the elements of x[i], against x[i], ..., x[n-1] only, so that
+// the backward passes stop short of the off-diagonal blocks in the lower
+// triangle, which are the transposes of those in the upper triangle. The
+// diagonal blocks still take one pass per element of x[i], and half of each
+// is dropped by the mirror. Parameters y does not depend on, or depends on
+// linearly, give blocks of zeros without any passes. The gradient of row i
+// is released once the row is done, so the first order graph is freed as
+// the rows go.
+std::vector<std::vector<torch::Tensor>> hessian(
+    const torch::Tensor& y,
+    const std::vector<torch::Tensor>& x,
+    std::vector<torch::Tensor>* gradient,
+    bool allow_unused,
+    double na_hess
+) {
+    if (y.numel() != 1) {
+        std::ostringstream ss;
+        ss << "hessian expects a scalar y, but y has " << y.numel() << " elements.";
+        throw std::logic_error(ss.str());
+    }
+    auto x_size = x.size();
 
-        auto jac = get_jac_no_missings(x,y);
+    auto grads = torch::autograd::grad({y.reshape({})}, x, {}, true, true, allow_unused);
+    std::vector<torch::Tensor> detached_grads(gradient ? x_size : 0);
+    auto y_missing = na_hess != 0.0 && static_cast<torch::Tensor>(y.detach().eq(na_hess)).item<bool>();
 
-        auto *jac_is_missing_ptr = jac_is_missing.data_ptr<bool>();
-        auto *jac_ptr = jac.data_ptr<double>();
-        auto numel = jac.numel();
-        for (decltype(numel) i = 0; i != numel; ++i) {
-            if (jac_is_missing_ptr[i]) {
-                jac_ptr[i] = missing::na;
+    std::vector<std::vector<torch::Tensor>> out(x_size, std::vector<torch::Tensor>(x_size));
+    for (decltype(x_size) i = 0; i != x_size; ++i) {
+        auto x_i_sizes = x[i].sizes();
+        auto x_i_numel = x[i].numel();
+        const auto& grad_i = grads[i];
+        std::vector<std::vector<torch::Tensor>> hvps(x_size);
+        if (grad_i.defined() && grad_i.requires_grad()) {
+            auto flat_grad_i = grad_i.reshape({-1});
+            std::vector<torch::Tensor> inputs; inputs.reserve(x_size - i);
+            std::vector<decltype(x_size)> input_indices; input_indices.reserve(x_size - i);
+            for (auto j = i; j != x_size; ++j) {
+                if (grads[j].defined()) {
+                    inputs.emplace_back(x[j]);
+                    input_indices.emplace_back(j);
+                }
+            }
+            for (int64_t e = 0; e != x_i_numel; ++e) {
+                auto hvp = torch::autograd::grad({flat_grad_i[e]}, inputs, {}, true, false, true);
+                for (decltype(x_size) k = 0; k != input_indices.size(); ++k) {
+                    auto j = input_indices[k];
+                    hvps[j].emplace_back(hvp[k].defined() ? hvp[k] : torch::zeros_like(x[j]));
+                }
             }
         }
+        for (auto j = i; j != x_size; ++j) {
+            auto block_sizes = jacobian_sizes(x[i], x[j]);
+            auto& block = out[i][j];
+            if (hvps[j].empty()) {
+                block = torch::zeros(block_sizes, torch::kDouble);
+            } else {
+                block = torch::stack(hvps[j]).reshape(block_sizes);
+            }
+            if (j == i) {
+                // Mirror the upper triangle, so that the diagonal block is exactly symmetric.
+                auto square = block.reshape({x_i_numel, x_i_numel});
+                block = (square.triu() + square.triu(1).t()).reshape(block_sizes);
+            }
+            if (na_hess != 0.0) {
+                block = set_missing_jacobian(block, x[i], x[j], na_hess);
+                if (y_missing) {
+                    block = torch::full_like(block, missing::na);
+                }
+            }
+            if (j != i) {
+                auto x_j_numel = x[j].numel();
+                out[j][i] = block.reshape({x_i_numel, x_j_numel}).t().reshape(jacobian_sizes(x[j], x[i]));
+            }
+        }
+        if (gradient && grads[i].defined()) {
+            detached_grads[i] = grads[i].detach();
+        }
+        grads[i] = torch::Tensor();
+    }
 
-        return jac;
+    if (gradient) {
+        gradient->clear();
+        gradient->reserve(x_size);
+        for (decltype(x_size) i = 0; i != x_size; ++i) {
+            auto grad_i = detached_grads[i].defined() ? detached_grads[i] : torch::zeros_like(x[i], torch::kDouble);
+            gradient->emplace_back(na_hess != 0.0 ? set_missing_jacobian(grad_i, y.reshape({}), x[i], na_hess) : grad_i);
+        }
     }
+
+    return out;
 }
 
+torch::Tensor hessian(
+    const torch::Tensor& y,
+    const torch::Tensor& x,
+    torch::Tensor* gradient,
+    bool allow_unused,
+    double na_hess
+) {
+    std::vector<torch::Tensor> gradients;
+    auto out = hessian(y, std::vector<torch::Tensor>{x}, gradient ? &gradients : nullptr, allow_unused, na_hess);
+    if (gradient) *gradient = std::move(gradients.at(0));
+    return out.at(0).at(0);
+}
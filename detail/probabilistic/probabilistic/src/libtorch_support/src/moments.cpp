@@ -1,3 +1,5 @@
+#include <sstream>
+#include <stdexcept>
 #include <vector>
 #include <torch/torch.h>
 #include <libtorch_support/missing.hpp>
@@ -276,6 +278,85 @@ torch::Tensor cross_covariance_matrix(
     return cross_covariance_matrix(x, y, na_cov, dimensions_across_observations);
 }
 
+torch::Tensor lagged_cross_covariance_matrices(
+    const torch::Tensor& x,
+    int64_t t_dim,
+    int64_t num_lags,
+    double na_cov
+) {
+    auto ndimension = x.ndimension();
+    if (t_dim < 0) t_dim += ndimension;
+    // Without lags, time plays no part, so any dimension across observations will do.
+    if (num_lags <= 1) t_dim = 0;
+    if (t_dim < 0 || t_dim >= ndimension-1) {
+        std::ostringstream ss;
+        ss << "t_dim (" << t_dim << ") must identify a dimension across observations of x, which has "
+           << ndimension << " dimensions.";
+        throw std::logic_error(ss.str());
+    }
+    auto t_size = x.size(t_dim);
+    auto p = x.size(-1);
+    if (num_lags > t_size) num_lags = t_size;
+
+    std::vector<int64_t> dimensions_across_observations;
+    get_dimensions_across_observations(dimensions_across_observations, x);
+
+    auto x_present = x.ne(na_cov);
+    auto x_centered_zeroed = torch::where(
+        x_present,
+        x - average(x, dimensions_across_observations, true, na_cov),
+        torch::zeros({}, x.options())
+    );
+
+    // The first p columns hold the centred values, the last p the presence
+    // indicators, so that one product gives the sums of the outer products
+    // of the centred values, their sums against the presence of the lagged
+    // values, and the pair sample sizes.
+    auto z = torch::cat({x_centered_zeroed, x_present.to(x.scalar_type())}, -1);
+
+    // The lagged series by lag j holds the values at the first t_size - j
+    // times, so its mean, relative to the mean of x, follows from the
+    // cumulative sums over time.
+    std::vector<int64_t> dimensions_across_other_observations;
+    dimensions_across_other_observations.reserve(ndimension-2);
+    for (auto i : dimensions_across_observations) {
+        if (i != t_dim) dimensions_across_other_observations.emplace_back(i);
+    }
+    auto z_cumulative_sums = (
+        dimensions_across_other_observations.empty() ? z : z.sum(dimensions_across_other_observations)
+    ).cumsum(0);
+
+    std::vector<torch::Tensor> out; out.reserve(num_lags);
+    for (int64_t j = 0; j != num_lags; ++j) {
+        auto products = torch::tensordot(
+            z.narrow(t_dim, j, t_size - j),
+            z.narrow(t_dim, 0, t_size - j),
+            dimensions_across_observations,
+            dimensions_across_observations
+        );
+        auto sums = products.narrow(0, 0, p).narrow(1, 0, p);
+        auto sums_lagged_present = products.narrow(0, 0, p).narrow(1, p, p);
+        auto sample_sizes = products.narrow(0, p, p).narrow(1, p, p);
+
+        auto lagged_sums = z_cumulative_sums[t_size - j - 1];
+        auto lagged_sample_sizes = lagged_sums.narrow(0, p, p);
+        auto lagged_mean_shift = torch::where(
+            lagged_sample_sizes.gt(0.5),
+            lagged_sums.narrow(0, 0, p)/lagged_sample_sizes,
+            torch::zeros({}, x.options())
+        );
+
+        auto positive_sample_size = sample_sizes.gt(0.5);
+        auto covariance = (sums - sums_lagged_present*lagged_mean_shift.unsqueeze(0))/torch::where(
+            positive_sample_size,
+            sample_sizes,
+            torch::ones({}, x.options())
+        );
+        out.emplace_back(torch::where(positive_sample_size, covariance, torch::full({}, na_cov, x.options())));
+    }
+    return torch::stack(out);
+}
+
 int64_t reduce_sample_size_by_parameterisation(
     const torch::Tensor& sample_size_to_reduce
 ) {
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <torch/torch.h>
+#include <libtorch_support/parallel.hpp>
+
+void parallel_for(
+    int64_t n,
+    int64_t num_workers,
+    int64_t intra_op_threads,
+    const std::function<void(int64_t)>& task
+) {
+    if (num_workers <= 1 || n <= 1) {
+        for (int64_t i = 0; i != n; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    num_workers = std::min(num_workers, n);
+    if (intra_op_threads <= 0) {
+        intra_op_threads = std::max<int64_t>(1, torch::get_num_threads()/num_workers);
+    }
+
+    // Workers claim the next task from a shared counter, so that slow fits
+    // don't hold up a fixed block of tasks behind them.
+    std::atomic<int64_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr first_exception;
+    std::mutex first_exception_mutex;
+
+    auto worker = [&]() {
+        torch::set_num_threads(intra_op_threads);
+        for (int64_t i = next++; i < n && !failed; i = next++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(first_exception_mutex);
+                if (!first_exception) { first_exception = std::current_exception(); }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_workers);
+    for (int64_t i = 0; i != num_workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    if (first_exception) {
+        std::rethrow_exception(first_exception);
+    }
+}
@@ -1,6 +1,8 @@
 #include <utility>
 #include <Faddeeva.hh>
+#include <ATen/Parallel.h>
 #include <torch/torch.h>
+#include <libtorch_support/logsubexp.hpp>
 #include <libtorch_support/standard_normal_log_cdf.hpp>
 #include <cmath>
 
@@ -15,56 +17,93 @@ constexpr double inv_sqrt_2 = 0.707106781186547524400844362104849039284835937688
 constexpr double log_2 = 0.6931471805599453094172321214581765680755001343602552541206800094;
 constexpr double sqrt_twoonpi = 0.7978845608028653558798921198687637369517172623298693153318516593;
 
-/*
-class ZLogCDFImpl : public Function<ZLogCDFImpl> {
+// Both branches are stable: for z <= 0 the cdf is small, and erfcx keeps
+// its logarithm from underflowing, while for z > 0 the cdf is near one, and
+// log1p keeps its logarithm from cancelling. Either way the derivative,
+// phi(z)/Phi(z), comes from the same special function evaluation.
+static inline void standard_normal_log_cdf_and_derivative(double z, double& log_cdf, double& derivative) {
+    if (z <= 0.0) {
+        double erfcx_z = Faddeeva::erfcx(-inv_sqrt_2*z);
+        log_cdf = std::log(erfcx_z) - 0.5*z*z - log_2;
+        derivative = sqrt_twoonpi/erfcx_z;
+    } else {
+        double erfc_z = Faddeeva::erfc(inv_sqrt_2*z);
+        log_cdf = std::log1p(-0.5*erfc_z);
+        derivative = sqrt_twoonpi*std::exp(-0.5*z*z)/(2.0 - erfc_z);
+    }
+}
+
+// phi(z)/Phi(z), the derivative of log Phi(z), whose own derivative is
+// -phi(z)/Phi(z)*(z + phi(z)/Phi(z)). Only used when backward passes are
+// themselves differentiated, as by hessian and forward mode jacobians.
+class InverseMillsRatioImpl : public Function<InverseMillsRatioImpl> {
     public:
         static torch::Tensor forward(AutogradContext *ctx, torch::Tensor input) {
-            auto output = input.clone().toType(torch::kDouble);
+            auto input_double = input.to(torch::kDouble).contiguous();
+            auto output = torch::empty_like(input_double);
+            const auto *input_data_ptr = input_double.data_ptr<double>();
             auto *output_data_ptr = output.data_ptr<double>();
-            auto output_size = output.numel();
-            for (decltype(output_size) i = 0; i != output_size; ++i) {
-                double z = output_data_ptr[i];
-                if (z <= 0.0) {
-                    output_data_ptr[i] = std::log(Faddeeva::erfcx(-inv_sqrt_2*z)) - 0.5*z*z - log_2;
-                } else {
-                    output_data_ptr[i] = std::log1p(-0.5*Faddeeva::erfc(inv_sqrt_2*z));
+            at::parallel_for(0, input_double.numel(), at::internal::GRAIN_SIZE, [&](int64_t begin, int64_t end) {
+                double log_cdf;
+                for (int64_t i = begin; i != end; ++i) {
+                    standard_normal_log_cdf_and_derivative(input_data_ptr[i], log_cdf, output_data_ptr[i]);
                 }
-            }
-            ctx->save_for_backward({input});
+            });
+            ctx->save_for_backward({std::move(input), output});
             return output;
         }
 
         static tensor_list backward(AutogradContext *ctx, tensor_list grad_outputs) {
             auto saved = ctx->get_saved_variables();
-            auto input = saved[0];
-            auto grad_output = grad_outputs[0];
+            const auto& input = saved[0];
+            const auto& output = saved[1];
+            return {-grad_outputs[0]*output*(input + output)};
+        }
+};
 
-            auto doutdin = input.clone().toType(torch::kDouble);
-            auto *doutdin_ptr = doutdin.data_ptr<double>();
-            auto doutdin_size = doutdin.numel();
-            for (decltype(doutdin_size) i = 0; i != doutdin_size; ++i) {
-                double z = doutdin_ptr[i];
-                if (z <= 0.0) {
-                    doutdin_ptr[i] = sqrt_twoonpi/Faddeeva::erfcx(-inv_sqrt_2*z);
-                } else {
-                    doutdin_ptr[i] = sqrt_twoonpi*std::exp(-0.5*z*z)/(Faddeeva::erf(inv_sqrt_2*z) + 1.0);
+// One pass over the input computes log Phi(z) and its derivative, which is
+// saved, so that the backward pass is a single multiplication.
+class StandardNormalLogCDFImpl : public Function<StandardNormalLogCDFImpl> {
+    public:
+        static torch::Tensor forward(AutogradContext *ctx, torch::Tensor input) {
+            auto input_double = input.to(torch::kDouble).contiguous();
+            auto output = torch::empty_like(input_double);
+            auto derivative = torch::empty_like(input_double);
+            const auto *input_data_ptr = input_double.data_ptr<double>();
+            auto *output_data_ptr = output.data_ptr<double>();
+            auto *derivative_data_ptr = derivative.data_ptr<double>();
+            at::parallel_for(0, input_double.numel(), at::internal::GRAIN_SIZE, [&](int64_t begin, int64_t end) {
+                for (int64_t i = begin; i != end; ++i) {
+                    standard_normal_log_cdf_and_derivative(input_data_ptr[i], output_data_ptr[i], derivative_data_ptr[i]);
                 }
-            }
+            });
+            ctx->save_for_backward({std::move(input), derivative});
+            return output;
+        }
 
-            return {grad_output*doutdin};
+        static tensor_list backward(AutogradContext *ctx, tensor_list grad_outputs) {
+            auto saved = ctx->get_saved_variables();
+            const auto& input = saved[0];
+            const auto& derivative = saved[1];
+            // With create_graph the derivative must itself be differentiable.
+            if (at::GradMode::is_enabled()) {
+                return {grad_outputs[0]*InverseMillsRatioImpl::apply(input)};
+            }
+            return {grad_outputs[0]*derivative};
         }
 };
 
-torch::Tensor standard_normal_log_cdf(torch::Tensor x) { return ZLogCDFImpl::apply(std::move(x)); }
-*/
+torch::Tensor standard_normal_log_cdf(torch::Tensor x) { return StandardNormalLogCDFImpl::apply(std::move(x)); }
 
-torch::Tensor standard_normal_log_cdf(torch::Tensor x) {
-    auto le_0 = x.le(0.0);
-    auto gt_0 = le_0.logical_not();
-    auto x_le_0 = x.index({le_0});
-    auto out = x.new_empty(x.sizes());
-    out.index_put_({le_0}, torch::log(torch::special::erfcx(-inv_sqrt_2*x_le_0)) - 0.5*x_le_0.square() - log_2);
-    out.index_put_({gt_0}, torch::log1p(-0.5*torch::special::erfc(inv_sqrt_2*x.index({gt_0}))));
-    return out;
+torch::Tensor standard_normal_log_interval_probability(const torch::Tensor& z_lb, const torch::Tensor& z_ub_in) {
+    auto z_ub = z_ub_in.max(z_lb);
+    return torch::where(
+        (z_lb + z_ub).le(0.0),
+        logsubexp(standard_normal_log_cdf(z_ub), standard_normal_log_cdf(z_lb)),
+        logsubexp(standard_normal_log_cdf(-z_lb), standard_normal_log_cdf(-z_ub))
+    );
 }
 
+torch::Tensor standard_normal_log_interval_complement_probability(const torch::Tensor& z_lb, const torch::Tensor& z_ub) {
+    return torch::logaddexp(standard_normal_log_cdf(z_lb), standard_normal_log_cdf(-z_ub)).clamp_max(0.0);
+}
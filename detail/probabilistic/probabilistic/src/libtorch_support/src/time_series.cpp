@@ -1,5 +1,6 @@
 #include <vector>
 #include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/time_series.hpp>
 
@@ -47,7 +48,7 @@ torch::Tensor lag(const torch::Tensor& x, int64_t t_dim, int64_t order, double n
 }
 
 torch::Tensor diff(const torch::Tensor& x, int64_t t_dim) {
-    return missing::handle_na(
+    return missing::handle_na_elementwise(
         [](const torch::Tensor& a, const torch::Tensor& b) {
             return a - b;
         },
@@ -56,3 +57,40 @@ torch::Tensor diff(const torch::Tensor& x, int64_t t_dim) {
     );
 }
 
+
+torch::Tensor take_times(const torch::Tensor& x, const torch::Tensor& times, int64_t t_dim, double na_l) {
+    auto x_sizes = x.sizes();
+    int64_t x_sizes_size = x_sizes.size();
+    if (t_dim < 0) { t_dim = x_sizes_size + t_dim; }
+    auto x_sizes_t_dim = x_sizes.at(t_dim);
+
+    // One na_l past the end, for times out of range to gather.
+    auto pad_sizes = x_sizes.vec();
+    pad_sizes.at(t_dim) = 1;
+    auto x_padded = torch::cat({x, x.new_full(pad_sizes, na_l)}, t_dim);
+    auto times_in_range = times.masked_fill(times.lt(0).logical_or(times.ge(x_sizes_t_dim)), x_sizes_t_dim);
+
+    auto ret = x_padded.index_select(t_dim, times_in_range.reshape({-1}));
+    if (times.ndimension() <= 1) {
+        return ret;
+    }
+
+    // Unflatten times along t_dim, then move its leading dimensions to the front.
+    int64_t times_lead = times.ndimension() - 1;
+    std::vector<int64_t> ret_sizes(x_sizes.begin(), x_sizes.begin() + t_dim);
+    ret_sizes.insert(ret_sizes.end(), times.sizes().begin(), times.sizes().end());
+    ret_sizes.insert(ret_sizes.end(), x_sizes.begin() + t_dim + 1, x_sizes.end());
+    ret = ret.view(ret_sizes);
+
+    std::vector<int64_t> permutation; permutation.reserve(ret_sizes.size());
+    for (int64_t i = 0; i != times_lead; ++i) {
+        permutation.emplace_back(t_dim + i);
+    }
+    for (int64_t i = 0; i != t_dim; ++i) {
+        permutation.emplace_back(i);
+    }
+    for (int64_t i = t_dim + times_lead; i != static_cast<int64_t>(ret_sizes.size()); ++i) {
+        permutation.emplace_back(i);
+    }
+    return ret.permute(permutation);
+}
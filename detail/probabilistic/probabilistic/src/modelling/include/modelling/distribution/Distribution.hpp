@@ -7,12 +7,37 @@
 #include <memory>
 #include <string>
 #include <initializer_list>
+#include <limits>
 #include <torch/torch.h>
 #include <libtorch_support/missing.hpp>
 #include <R_protect_guard.hpp>
 #include <R_rng_guard.hpp>
 #include <Rinternals.h>
 
+// Which quantities Distribution::evaluate should return. The interval
+// probabilities are of (open_lower_bound, closed_upper_bound], as for the
+// double overloads of log_interval_probability.
+struct DistributionEvaluationRequest {
+    bool log_density = false;
+    bool cdf = false;
+    bool log_cdf = false;
+    bool log_ccdf = false;
+    bool log_interval_probability = false;
+    bool log_interval_complement_probability = false;
+    double open_lower_bound = -std::numeric_limits<double>::infinity();
+    double closed_upper_bound = std::numeric_limits<double>::infinity();
+};
+
+// The quantities asked for, each empty if not.
+struct DistributionEvaluation {
+    torch::OrderedDict<std::string, torch::Tensor> log_density;
+    torch::OrderedDict<std::string, torch::Tensor> cdf;
+    torch::OrderedDict<std::string, torch::Tensor> log_cdf;
+    torch::OrderedDict<std::string, torch::Tensor> log_ccdf;
+    torch::OrderedDict<std::string, torch::Tensor> log_interval_probability;
+    torch::OrderedDict<std::string, torch::Tensor> log_interval_complement_probability;
+};
+
 class Distribution {
     public:
         virtual torch::OrderedDict<std::string, torch::Tensor> density(
@@ -97,14 +122,52 @@ class Distribution {
             double closed_upper_bound
         ) const;
 
+        // Several quantities at once, as scoring rules that need more than
+        // one ask for them. By default each is evaluated on its own;
+        // distributions override it to share their intermediate values, such
+        // as studentised observations and missingness, between them.
+        virtual DistributionEvaluation evaluate(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const DistributionEvaluationRequest& request
+        ) const;
+
         virtual torch::OrderedDict<std::string, torch::Tensor> draw(void) const {
             throw std::runtime_error("Distribution::draw unimplemented");
         }
 
+        // Draws only the elements where mask is true, for each series of
+        // mask, as draw()[series].index({mask[series]}) would, flattened in
+        // the same order. By default that is exactly how; distributions whose
+        // elements can be drawn independently override it to draw no more.
+        virtual torch::OrderedDict<std::string, torch::Tensor> draw_at(
+            const torch::OrderedDict<std::string, torch::Tensor>& mask
+        ) const;
+
         virtual torch::OrderedDict<std::string, torch::Tensor> generate(int64_t sample_size, int64_t burn_in_size, double first_draw) const {
             throw std::runtime_error("Distribution::generate unimplemented.");
         }
 
+        // As generate, for distributions which transform standard normal
+        // draws, given as a matrix with one row for each draw. Sharing the
+        // draws lets callers reuse them, or draw them in bulk beforehand.
+        virtual torch::OrderedDict<std::string, torch::Tensor> generate_from_standard_normal(
+            const torch::Tensor& standard_normal_draws
+        ) const {
+            throw std::runtime_error("Distribution::generate_from_standard_normal unimplemented.");
+        }
+
+        // For distributions which transform standard normal draws, the number
+        // of standard normals in each draw, the columns expected above.
+        virtual int64_t standard_normal_dimension(void) const {
+            throw std::runtime_error("Distribution::standard_normal_dimension unimplemented.");
+        }
+
+        // The first num_cumulants cumulants, from the mean and variance on,
+        // along the last dimension.
+        virtual torch::OrderedDict<std::string, torch::Tensor> cumulants(int64_t num_cumulants) const {
+            throw std::runtime_error("Distribution::cumulants unimplemented.");
+        }
+
         virtual SEXP to_R_list(R_protect_guard& protect_guard) const {
             return to_R_list(
                 R_dist_function(),
@@ -1,15 +1,78 @@
 #ifndef PROBABILISTIC_MODELLING_DISTRIBUTION_MIXTURE_HPP_GUARD
 #define PROBABILISTIC_MODELLING_DISTRIBUTION_MIXTURE_HPP_GUARD
 
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <tuple>
 #include <vector>
 #include <torch/torch.h>
 #include <modelling/distribution/Distribution.hpp>
 
+// Frozen mixture components, forecast at fixed observations. A Mixture made
+// from the cache evaluates each component value at most once, stacked with
+// the components along the last dimension, so that a mixture whose weights
+// alone vary costs a (log) weighted sum over a K×T matrix per evaluation.
+// The components should not require grad.
+class MixtureComponentCache {
+    public:
+        MixtureComponentCache(
+            std::vector<std::shared_ptr<Distribution>> components_in,
+            torch::OrderedDict<std::string, torch::Tensor> observations_in
+        ):
+            components(std::move(components_in)),
+            observations(std::move(observations_in))
+        { }
+
+        const std::vector<std::shared_ptr<Distribution>>& get_components(void) const {
+            return components;
+        }
+
+        // True if observations holds the very tensors the cache was made with.
+        bool is_cached(const torch::OrderedDict<std::string, torch::Tensor>& observations_in) const;
+
+        const torch::OrderedDict<std::string, torch::Tensor>& stacked(
+            const std::string& op_name,
+            const std::function<torch::OrderedDict<std::string, torch::Tensor>(void)>& stack,
+            double arg0 = 0.0,
+            double arg1 = 0.0
+        );
+
+    private:
+        std::vector<std::shared_ptr<Distribution>> components;
+        torch::OrderedDict<std::string, torch::Tensor> observations;
+        std::map<std::tuple<std::string, double, double>, torch::OrderedDict<std::string, torch::Tensor>> stacked_values;
+};
+
 std::unique_ptr<Distribution> ManufactureMixture(
     std::vector<std::shared_ptr<Distribution>> components,
     torch::Tensor weights
 );
 
-#endif
+std::unique_ptr<Distribution> ManufactureMixture(
+    std::shared_ptr<MixtureComponentCache> cache,
+    torch::Tensor weights
+);
 
+// As ManufactureMixture, for components that are all Normal (see is_normal).
+// Their means and standard deviations are stacked along a last, component,
+// dimension, so that densities, cdfs and interval probabilities are each a
+// single broadcast kernel and a (log) weighted sum over the components.
+std::unique_ptr<Distribution> ManufactureMixtureOfNormals(
+    std::vector<std::shared_ptr<Distribution>> components,
+    torch::Tensor weights
+);
+
+// As above, for cached components. At the cached observations, the stacked
+// component values are read from the cache, as for ManufactureMixture, so
+// that each mixture of them is a (log) weighted sum only.
+std::unique_ptr<Distribution> ManufactureMixtureOfNormals(
+    std::shared_ptr<MixtureComponentCache> cache,
+    torch::Tensor weights
+);
+
+// True if distribution was made by ManufactureMixtureOfNormals.
+bool is_mixture_of_normals(const Distribution& distribution);
+
+#endif
@@ -13,5 +13,8 @@ std::unique_ptr<Distribution> ManufactureNormal(
 
 std::unique_ptr<Distribution> ManufactureNormal(const torch::OrderedDict<std::string, torch::Tensor>& tensors);
 
+// True if distribution was made by ManufactureNormal.
+bool is_normal(const Distribution& distribution);
+
 #endif
 
@@ -0,0 +1,42 @@
+#ifndef PROBABILISTIC_MODELLING_FUNCTIONAL_AVERAGE_SCORE_HPP_GUARD
+#define PROBABILISTIC_MODELLING_FUNCTIONAL_AVERAGE_SCORE_HPP_GUARD
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/score/ScoringRule.hpp>
+
+// The average one step ahead score under scoring_rule, or the scoring rule
+// of the last fit if null, with fit refit at each origin as for
+// expanding_window_average.
+torch::Tensor average_score_expanding_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    std::shared_ptr<const ScoringRule> scoring_rule,
+    int64_t min_in_sample_times,
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+// As average_score_expanding_window, but with fit refit at each origin as for
+// rolling_window_average. per_origin, if given, receives the average score at
+// each origin.
+torch::Tensor average_score_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    std::shared_ptr<const ScoringRule> scoring_rule,
+    int64_t window_size,
+    torch::Tensor *per_origin = nullptr,
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+#endif
+
@@ -22,7 +22,11 @@ torch::Tensor empirical_coverage_expanding_window(
     double closed_upper_probability,
     bool complement,
     int64_t min_in_sample_times,
-    int64_t time_dimension = -1
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
 );
 
 torch::Tensor empirical_coverage_expanding_window(
@@ -31,7 +35,40 @@ torch::Tensor empirical_coverage_expanding_window(
     double closed_upper_probability,
     bool complement,
     int64_t min_in_sample_times,
-    int64_t time_dimension = -1
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+torch::Tensor empirical_coverage_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    double open_lower_probability,
+    double closed_upper_probability,
+    bool complement,
+    int64_t window_size,
+    torch::Tensor *per_origin = nullptr,
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+torch::Tensor empirical_coverage_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    double open_lower_probability,
+    double closed_upper_probability,
+    bool complement,
+    int64_t window_size,
+    torch::Tensor *per_origin = nullptr,
+    int64_t time_dimension = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
 );
 
 #endif
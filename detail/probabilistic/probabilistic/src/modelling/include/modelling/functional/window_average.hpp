@@ -25,19 +25,80 @@ torch::Tensor out_of_sample_average(
     int64_t time_dimension = -1
 );
 
+// The average of functional over the origins T from min_in_sample_times, with
+// model refit to the first T times of observations at each. If the functional
+// reads no further than max_horizon times past T, as with h_steps_ahead, only
+// the first T + max_horizon + 1 times are forecast. A negative max_horizon
+// forecasts all times. The origins are split into chains of chain_length
+// consecutive origins, counted from min_in_sample_times, or into one chain if
+// chain_length <= 0. Each chain starts from the parameters of model, and each
+// origin after the first in a chain is warm started from the fit at the
+// origin before it. That fit is refit in full every refit_every origins of
+// the chain, and in between updated with num_newton_steps Newton steps, see
+// ProbabilisticModule::update_fit, falling back to a full refit if they fail.
+// Chains are spread over num_threads threads, so the functional must be safe
+// to call from several threads at once. The chains do not depend on
+// num_threads, so neither do the results, but with one chain there is
+// nothing to spread.
 torch::Tensor expanding_window_average(
     std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
     std::shared_ptr<ProbabilisticModule> model,
     const torch::OrderedDict<std::string, torch::Tensor>& observations,
     int64_t min_in_sample_times,
-    int64_t time_dimension = -1
+    int64_t time_dimension = -1,
+    int64_t max_horizon = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
 );
 
 torch::Tensor expanding_window_average(
     std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
     std::shared_ptr<ProbabilisticModule> model,
     int64_t min_in_sample_times,
-    int64_t time_dimension = -1
+    int64_t time_dimension = -1,
+    int64_t max_horizon = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+// As expanding_window_average, but with model refit at each origin T from
+// window_size to the window_size times before T only, each window in a chain
+// warm started from the fit to the window before. The functional sees each
+// window, and the times after it that it reads, as views of observations, with
+// times counted from the start of the window, so that its SampleSplitter has
+// window_size in-sample times. per_origin, if given, receives the results of
+// the functional at each origin, stacked along a new leading dimension, so
+// that its first index is the origin less window_size. The functional must
+// then give results of the same shape at every origin.
+torch::Tensor rolling_window_average(
+    std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
+    std::shared_ptr<ProbabilisticModule> model,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t window_size,
+    torch::Tensor *per_origin = nullptr,
+    int64_t time_dimension = -1,
+    int64_t max_horizon = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
+);
+
+torch::Tensor rolling_window_average(
+    std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
+    std::shared_ptr<ProbabilisticModule> model,
+    int64_t window_size,
+    torch::Tensor *per_origin = nullptr,
+    int64_t time_dimension = -1,
+    int64_t max_horizon = -1,
+    int64_t num_threads = 1,
+    int64_t refit_every = 1,
+    int64_t num_newton_steps = 1,
+    int64_t chain_length = 0
 );
 
 #endif
@@ -0,0 +1,42 @@
+#ifndef PROBABILISTIC_MODELLING_INFERENCE_MOVING_BLOCK_BOOTSTRAP_HPP_GUARD
+#define PROBABILISTIC_MODELLING_INFERENCE_MOVING_BLOCK_BOOTSTRAP_HPP_GUARD
+
+#include <cstdint>
+#include <memory>
+#include <torch/torch.h>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+
+// This sampling distribution estimate resamples the observations the model
+// was fit to in blocks of block_size consecutive times, with block starts
+// drawn uniformly, until each of num_replications resamples holds as many
+// times as the observations. The model is refit to each resample, see
+// bootstrap_refits. Unlike TruncatedKernelCLT, it needs no estimate of the
+// long run variance of the estimating equations, so suits samples where
+// that is unstable, as for heavy tailed series.
+//
+// Consecutive blocks are separated by gap_size times with missing
+// observations, so that forecasts which depend on the observations before
+// a join are missing, and left out of the scores, rather than mixing two
+// blocks. gap_size should be at least the number of lags the model's
+// forecasts depend on.
+
+std::shared_ptr<SamplingDistribution> ManufactureMovingBlockBootstrap(
+    std::shared_ptr<ProbabilisticModule> fit,
+    int64_t num_replications,
+    int64_t block_size,
+    int64_t gap_size,
+    int64_t num_threads = 1
+);
+
+// The times of num_replications resamples of sample_size times, one row for
+// each, in blocks of block_size consecutive times, the last cut short to
+// make up sample_size, with gap_size times of -1 between blocks.
+torch::Tensor moving_block_times(
+    int64_t num_replications,
+    int64_t sample_size,
+    int64_t block_size,
+    int64_t gap_size
+);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PROBABILISTIC_MODELLING_INFERENCE_PARAMETER_DRAWS_HPP_GUARD
+#define PROBABILISTIC_MODELLING_INFERENCE_PARAMETER_DRAWS_HPP_GUARD
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <torch/torch.h>
+#include <libtorch_support/indexing.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/score/ScoringRule.hpp>
+
+// Draws of the parameters of a fit, such as those of
+// SamplingDistribution::draw_parameters, held as the rows of a matrix rather
+// than as a clone of the fit for each draw. The fit is cloned once, into a
+// working module whose parameters are overwritten with a row by module; the
+// average scores of all the draws come from one batched forward instead.
+class ParameterDraws {
+    public:
+        ParameterDraws(
+            const ProbabilisticModule& fit,
+            CollapsedTensor<std::string> draws_in
+        );
+
+        int64_t size(void) const {
+            return draws.tensor.size(0);
+        }
+
+        // One row for each draw, with the columns of each parameter given by indices.
+        const torch::Tensor& matrix(void) const {
+            return draws.tensor;
+        }
+
+        const torch::OrderedDict<std::string, torch::indexing::TensorIndex>& indices(void) const {
+            return draws.indices;
+        }
+
+        // The working module, with the parameters of the given draw. The same
+        // module is returned for every draw, so it holds the parameters of a
+        // draw until the next call.
+        ProbabilisticModule& module(int64_t draw);
+
+        // The average score of observations under each draw, with the barrier
+        // multiplied by barrier_multiplier. The draws are scored together, with
+        // the parameters stacked along a leading dimension, as by
+        // ProbabilisticModule::clone_batch, and the observations broadcast along
+        // it, through the fit's fused_average_scores kernel for the scoring rule
+        // if it has one, else through a single batched forward.
+        torch::Tensor average_scores(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const ScoringRule& scoring_rule,
+            double barrier_multiplier = 0.0
+        );
+
+    private:
+        CollapsedTensor<std::string> draws;
+        std::shared_ptr<ProbabilisticModule> working_module;
+        std::vector<std::pair<torch::Tensor, torch::indexing::TensorIndex>> working_parameters;
+        int64_t working_draw = -1;
+};
+
+#endif
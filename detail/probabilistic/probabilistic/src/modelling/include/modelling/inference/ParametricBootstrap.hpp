@@ -0,0 +1,26 @@
+#ifndef PROBABILISTIC_MODELLING_INFERENCE_PARAMETRIC_BOOTSTRAP_HPP_GUARD
+#define PROBABILISTIC_MODELLING_INFERENCE_PARAMETRIC_BOOTSTRAP_HPP_GUARD
+
+#include <cstdint>
+#include <memory>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+
+// This sampling distribution estimate draws num_replications samples from
+// the fitted model, each of the size of the observations it was fit to,
+// after burn_in_size draws that are discarded, starting from first_draw,
+// and refits the model to each, see bootstrap_refits. Refits share a fused
+// kernel if the model has one for its scoring rule, see
+// ProbabilisticModule::fit_replications, and are otherwise spread over
+// num_threads threads. Samples are drawn on the calling thread, so they do
+// not depend on num_threads.
+
+std::shared_ptr<SamplingDistribution> ManufactureParametricBootstrap(
+    std::shared_ptr<ProbabilisticModule> fit,
+    int64_t num_replications,
+    int64_t burn_in_size = 100,
+    double first_draw = 0.0,
+    int64_t num_threads = 1
+);
+
+#endif
@@ -10,6 +10,7 @@ class SamplingDistribution;
 #include <stdexcept>
 #include <string>
 #include <torch/torch.h>
+#include <libtorch_support/indexing.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/score/ScoringRule.hpp>
@@ -38,6 +39,11 @@ class SamplingDistribution {
 
         virtual std::shared_ptr<ProbabilisticModule> draw_stochastic_process(void) const; 
 
+        // num_draws draws of the parameters of the fit, as the rows of a matrix,
+        // with the columns of each parameter given by its index, without cloning
+        // the fit for each draw. See ParameterDraws to evaluate the fit under them.
+        CollapsedTensor<std::string> draw_parameters(int64_t num_draws) const;
+
         std::unique_ptr<Distribution> get_centered_function_estimate_distribution(
             std::string function_name,
             torch::OrderedDict<std::string, torch::Tensor> jac,
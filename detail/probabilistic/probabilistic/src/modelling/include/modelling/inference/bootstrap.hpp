@@ -0,0 +1,25 @@
+#ifndef PROBABILISTIC_MODELLING_INFERENCE_BOOTSTRAP_HPP_GUARD
+#define PROBABILISTIC_MODELLING_INFERENCE_BOOTSTRAP_HPP_GUARD
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <torch/torch.h>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+
+// The bootstrap estimate of the sampling distribution of the parameter
+// estimates of fit, given replicate_observations stacked along a leading
+// replication dimension. fit is refit to each replication with
+// fit_replications, starting from the point estimate, with the barrier at
+// which the point estimate was found, over num_threads threads. The
+// parameter estimates of the refits that converge are the draws of the
+// sampling distribution, which are resampled with replacement.
+
+std::shared_ptr<SamplingDistribution> bootstrap_refits(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& replicate_observations,
+    int64_t num_threads = 1
+);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROBABILISTIC_MISSINGNESS_INDEX_HPP_GUARD
+#define PROBABILISTIC_MISSINGNESS_INDEX_HPP_GUARD
+
+#include <cstdint>
+#include <string>
+#include <torch/torch.h>
+
+// Where the values of a dict of tensors, such as observations or their scores,
+// are present, found once so that it can be reused while the dict does not
+// change, as over a fit. Holds the presence masks, the flattened indices of
+// the present elements, the number present in each series (over the last
+// dimension) and in total.
+class MissingnessIndex {
+    public:
+        explicit MissingnessIndex(const torch::OrderedDict<std::string, torch::Tensor>& values);
+
+        const torch::OrderedDict<std::string, torch::Tensor>& present(void) const {
+            return present_masks;
+        }
+
+        const torch::OrderedDict<std::string, torch::Tensor>& present_indices(void) const {
+            return present_flat_indices;
+        }
+
+        const torch::OrderedDict<std::string, torch::Tensor>& series_sample_sizes(void) const {
+            return series_sizes;
+        }
+
+        int64_t sample_size(void) const {
+            return total_size;
+        }
+
+        // The sum of the present elements of values, which must be missing
+        // where the values this index was built from were missing, with
+        // no host synchronisation.
+        torch::Tensor sum(const torch::OrderedDict<std::string, torch::Tensor>& values) const;
+
+    private:
+        torch::OrderedDict<std::string, torch::Tensor> present_masks;
+        torch::OrderedDict<std::string, torch::Tensor> present_flat_indices;
+        torch::OrderedDict<std::string, torch::Tensor> series_sizes;
+        int64_t total_size = 0;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PROBABILISTIC_MODELLING_ARARCHTX_NORMAL_LOG_SCORE_HPP_GUARD
+#define PROBABILISTIC_MODELLING_ARARCHTX_NORMAL_LOG_SCORE_HPP_GUARD
+
+#include <cstdint>
+#include <torch/torch.h>
+
+// The sum of the log scores of an ARARCHTX model without exogenous
+// regressors, found in one pass over time, with an analytic gradient
+// with respect to mu, ar, sigma2 and arch, so that autograd never sees
+// the lag design tensors or the missing::handle_na clones in forward.
+// The regressand's last dimension is time, mu and sigma2 are scalars,
+// ar and arch are vectors (possibly empty, for disabled components),
+// and the number of log scores that are not missing is written to
+// sample_size. Agrees with LogScore::score applied to forward.
+torch::Tensor ARARCHTX_normal_log_score_sum(
+    const torch::Tensor& regressand,
+    torch::Tensor mu,
+    torch::Tensor ar,
+    torch::Tensor sigma2,
+    torch::Tensor arch,
+    double var_transformation_crimp,
+    double var_transformation_catch,
+    int64_t *sample_size
+);
+
+// As ARARCHTX_normal_log_score_sum, but one sum per series, that is per
+// element of the regressand with its last dimension dropped, flattened.
+// mu and sigma2 may instead have one element per series, and ar and arch
+// one row per series, so that independent fits can be stacked. The number
+// of log scores that are not missing in each series is written to
+// sample_sizes.
+torch::Tensor ARARCHTX_normal_log_score_sums(
+    const torch::Tensor& regressand,
+    torch::Tensor mu,
+    torch::Tensor ar,
+    torch::Tensor sigma2,
+    torch::Tensor arch,
+    double var_transformation_crimp,
+    double var_transformation_catch,
+    torch::Tensor *sample_sizes
+);
+
+#endif
@@ -41,8 +41,14 @@ class AutoRegressive : public ShapelyCloneable<AutoRegressive<CoefficientsParame
             return AutoRegressive_forward(std::move(x), coefficients->get());
         }
 
+        // The mean over the coefficients, for each row of any stacked coefficients.
         torch::Tensor barrier(torch::Tensor scaling) const {
-            return scaling*coefficients->barrier().mean();
+            return scaling*coefficients->barrier().mean(-1);
+        }
+
+        // As barrier, before the mean over the coefficients.
+        torch::Tensor barrier_elements(torch::Tensor scaling) const {
+            return scaling*coefficients->barrier();
         }
 
         torch::OrderedDict<std::string, std::vector<std::vector<torch::indexing::TensorIndex>>> observations_by_parameter(
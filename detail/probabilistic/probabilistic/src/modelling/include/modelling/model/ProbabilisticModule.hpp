@@ -13,7 +13,9 @@ class ProbabilisticModule;
 #include <utility>
 #include <vector>
 #include <torch/torch.h>
+#include <libtorch_support/indexing.hpp>
 #include <libtorch_support/Parameterisation.hpp>
+#include <modelling/missingness_index.hpp>
 #include <modelling/score/ScoringRule.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/model/ShapelyModule.hpp>
@@ -29,6 +31,17 @@ class ProbabilisticModule : public virtual ShapelyModule {
         virtual torch::OrderedDict<std::string, torch::Tensor> draw_observations(int64_t sample_size, int64_t burn_in_size, double first_draw) const {
             throw std::runtime_error("ProbabilisticModule::draw_observations unimplemented.");
         }
+
+        // num_paths independent draws of draw_observations, stacked along a leading
+        // path dimension. Modules with a simulation engine may spread the paths over
+        // num_threads threads, otherwise they are drawn in turn.
+        virtual torch::OrderedDict<std::string, torch::Tensor> draw_replicate_observations(
+            int64_t num_paths,
+            int64_t sample_size,
+            int64_t burn_in_size,
+            double first_draw,
+            int64_t num_threads = 1
+        ) const;
  
         virtual torch::OrderedDict<std::string, torch::Tensor> grad(bool recurse = true) const;
 
@@ -53,6 +66,79 @@ class ProbabilisticModule : public virtual ShapelyModule {
             FitDiagnostics *diagnostics
         );
 
+        // The average score of the forecasts of observations, including the barrier,
+        // as fit would find through forward, but computed by a specialised kernel.
+        // Returns an undefined tensor if the module has no such kernel for the scoring
+        // rule, in which case fit falls back to forward.
+        virtual torch::Tensor fused_average_score(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const ScoringRule& scoring_rule,
+            double barrier_multiplier
+        ) {
+            return torch::Tensor();
+        }
+
+        // Moves the parameters that fit optimises towards the fit to
+        // observations with up to num_newton_steps Newton steps from where they
+        // are, on the average score, through forward, including the barrier at
+        // the multiplier the last fit ended with. Parameters the score does
+        // not depend on are left where they are. Cheap next to fit when
+        // observations differ little from those of the last fit, as for
+        // consecutive expanding windows.
+        // Returns false, with the parameters left as they were, if the Hessian
+        // is not negative definite or a step does not improve the score, in
+        // which case the module should be refit.
+        bool update_fit(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            int64_t num_newton_steps = 1
+        );
+
+        // As fused_average_score, but for observations with a leading replication
+        // dimension and parameters stacked along a leading dimension of the same
+        // size, giving one average score per replication. See fit_replications.
+        virtual torch::Tensor fused_average_scores(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const ScoringRule& scoring_rule,
+            double barrier_multiplier
+        ) {
+            return torch::Tensor();
+        }
+
+        // Fits a clone of the module to each replication of observations, whose
+        // tensors share a leading replication dimension. If the module has a
+        // fused_average_scores kernel for the scoring rule, all replications are
+        // optimised at once, with parameters stacked along a leading dimension,
+        // and each replication is frozen once its score stops changing. Otherwise
+        // the replications are fit separately, spread over num_threads threads.
+        // Either way, each replication starts from this module's parameters.
+        // success, if given, is resized to the number of replications.
+        std::vector<std::shared_ptr<ProbabilisticModule>> fit_replications(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            std::shared_ptr<const ScoringRule> scoring_rule,
+            const FitPlan& plan,
+            std::vector<char> *success,
+            int64_t num_threads = 1
+        ) const;
+
+        // A clone of the module whose parameters each gain a leading batch
+        // dimension, with a row for each row of parameters.tensor, in which
+        // parameters.indices gives the columns of each parameter, as from
+        // SamplingDistribution::draw_parameters. Parameters not in
+        // parameters.indices keep this module's value in every row. forward,
+        // barrier and fused_average_scores of the clone then evaluate every
+        // row at once, for observations with the same leading dimension.
+        std::shared_ptr<ProbabilisticModule> clone_batch(const CollapsedTensor<std::string>& parameters) const;
+
+        // The forecasts of observations under each row of parameters, from one
+        // forward of clone_batch(parameters), with a leading batch dimension.
+        // Observations are broadcast along it, unless batched_observations, in
+        // which case they already have it, as for bootstrap replications.
+        std::unique_ptr<Distribution> forward_batch(
+            const CollapsedTensor<std::string>& parameters,
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            bool batched_observations = false
+        ) const;
+
         virtual torch::OrderedDict<std::string, torch::OrderedDict<std::string, std::vector<std::vector<torch::indexing::TensorIndex>>>> observations_by_parameter(
             const torch::OrderedDict<std::string, torch::Tensor>& observations,
             bool recursive = true,
@@ -83,6 +169,16 @@ class ProbabilisticModule : public virtual ShapelyModule {
             return barrier_multiplier_last_fit;
         }
 
+        // Where the scores of the forecasts of observations() are present, if the
+        // last fit found them through forward rather than a fused kernel, else null.
+        std::shared_ptr<const MissingnessIndex> scores_missingness(void) const {
+            if (!scoring_rule_last_fit) {
+                throw std::logic_error("ProbabilisticModule::scores_missingness called, but the module has not been fit before.");
+            }
+
+            return scores_missingness_last_fit;
+        }
+
         FitPlan fit_plan(void) const {
             if (is_null(fit_plan_last_fit)) {
                 throw std::logic_error("ProbabilisticModule::fit_plan called, but the module has not been fit before.");
@@ -101,6 +197,10 @@ class ProbabilisticModule : public virtual ShapelyModule {
         std::shared_ptr<ProbabilisticModule> clone_probabilistic_module(void) const;
 
     protected:
+        // The parameters that fit optimises, and that update_fit updates. By
+        // default, those that are not fixed and require a gradient.
+        virtual std::vector<torch::Tensor> parameters_to_optimise(void);
+
         bool fit(
             const torch::OrderedDict<std::string, torch::Tensor>& observations,
             std::shared_ptr<const ScoringRule> scoring_rule,
@@ -121,9 +221,17 @@ class ProbabilisticModule : public virtual ShapelyModule {
         torch::OrderedDict<std::string, torch::Tensor> observations_last_fit;
         std::shared_ptr<const ScoringRule> scoring_rule_last_fit;
         double barrier_multiplier_last_fit = std::numeric_limits<double>::quiet_NaN();
+        std::shared_ptr<const MissingnessIndex> scores_missingness_last_fit;
         FitPlan fit_plan_last_fit = null_fit_plan();
 };
 
+// observations with a leading batch dimension of size batch_size, along
+// which they are broadcast, for modules from ProbabilisticModule::clone_batch.
+torch::OrderedDict<std::string, torch::Tensor> broadcast_batch(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t batch_size
+);
+
 template<typename Derived>
 class ProbabilisticCloneable : public virtual ProbabilisticModule, public ShapelyCloneable<Derived> { };
 
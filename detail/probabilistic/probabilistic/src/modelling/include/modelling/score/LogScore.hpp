@@ -6,5 +6,7 @@
 
 std::unique_ptr<ScoringRule> ManufactureLogScore(void);
 
+bool is_log_score(const ScoringRule& scoring_rule);
+
 #endif
 
@@ -9,6 +9,7 @@ class ScoringRule;
 #include <memory>
 #include <string>
 #include <torch/torch.h>
+#include <modelling/missingness_index.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 
@@ -29,6 +30,12 @@ class ScoringRule {
 
         virtual torch::Tensor sum(const torch::OrderedDict<std::string, torch::Tensor>& scores) const;
 
+        // As sum(scores), with where the scores are present already known.
+        virtual torch::Tensor sum(
+            const torch::OrderedDict<std::string, torch::Tensor>& scores,
+            const MissingnessIndex& scores_missingness
+        ) const;
+
         virtual torch::Tensor sum(
             const Distribution& forecasts,
             const torch::OrderedDict<std::string, torch::Tensor>& observations
@@ -42,6 +49,17 @@ class ScoringRule {
 
         virtual torch::Tensor average(const torch::OrderedDict<std::string, torch::Tensor>& scores) const;
 
+        // As average(scores), with where the scores are present already known.
+        virtual torch::Tensor average(
+            const torch::OrderedDict<std::string, torch::Tensor>& scores,
+            const MissingnessIndex& scores_missingness
+        ) const;
+
+        // As average(scores), for scores with a leading batch dimension, such as
+        // those of the forecasts of ProbabilisticModule::forward_batch, giving
+        // one average for each batch.
+        virtual torch::Tensor averages(const torch::OrderedDict<std::string, torch::Tensor>& scores) const;
+
         virtual torch::Tensor average(
             const Distribution& forecasts,
             const torch::OrderedDict<std::string, torch::Tensor>& observations
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <sstream>
@@ -7,11 +10,15 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <torch/torch.h>
 #include <libtorch_support/Buffers.hpp>
+#include <libtorch_support/masked.hpp>
+#include <libtorch_support/parallel.hpp>
 #include <libtorch_support/Parameterisation.hpp>
 #include <modelling/distribution/Normal.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/model/AutoRegressive.hpp>
 #include <modelling/model/ARARCHTX.hpp>
+#include <modelling/model/ARARCHTX_normal_log_score.hpp>
+#include <modelling/score/LogScore.hpp>
 
 #include <log/trivial.hpp>
 
@@ -44,6 +51,106 @@ torch::Tensor var_transformation_inv(const torch::Tensor& vtx, double vtcrimp) {
     }
 }
 
+// num_paths paths of an ARARCHTX model without exogenous regressors, each
+// of burn_in_size + sample_size draws of which the last sample_size are
+// returned, as a [num_paths, sample_size] tensor. The recursions run over
+// time-major [time, path] buffers, so that the inner loops run over paths,
+// with unit stride, and chunks of paths may go to separate threads. The
+// standard normal innovations are drawn up front, on this thread, so paths
+// do not depend on num_threads.
+static torch::Tensor ARARCHTX_draw_paths(
+    int64_t num_paths,
+    int64_t sample_size,
+    int64_t burn_in_size,
+    double first_draw,
+    double mu,
+    const std::vector<double>& ar,
+    double sigma2,
+    const std::vector<double>& arch,
+    int64_t num_threads
+) {
+    auto total_size = burn_in_size + sample_size;
+    int64_t ar_ord = ar.size();
+    int64_t arch_ord = arch.size();
+    auto ord = ar_ord + arch_ord;
+
+    if (total_size <= ord) {
+        return torch::full({num_paths, sample_size}, first_draw, torch::kDouble);
+    }
+
+    // As at::normal over a [num_paths, total_size] tensor, so one path is as
+    // ARARCHTX::draw_observations always drew it.
+    auto z = at::normal(
+        torch::full({num_paths, total_size}, 0.0, torch::kDouble),
+        torch::full({num_paths, total_size}, 1.0, torch::kDouble)
+    ).t().contiguous();
+
+    auto mean = torch::empty({total_size, num_paths}, torch::kDouble);
+    auto out = torch::empty({total_size, num_paths}, torch::kDouble);
+    const auto *z_ptr = z.data_ptr<double>();
+    auto *mean_ptr = mean.data_ptr<double>();
+    auto *out_ptr = out.data_ptr<double>();
+
+    auto num_chunks = num_threads > 1 ? std::min(num_paths, 4*num_threads) : std::min<int64_t>(num_paths, 1);
+    auto chunk_size = num_chunks ? (num_paths + num_chunks - 1)/num_chunks : 0;
+
+    parallel_for(num_chunks, num_threads, 1, [&](int64_t chunk) {
+        auto begin = chunk*chunk_size;
+        auto end = std::min(begin + chunk_size, num_paths);
+        auto width = end - begin;
+        if (width <= 0) return;
+
+        std::vector<double> var(width);
+        auto row = [&](double *ptr, int64_t t) { return ptr + t*num_paths + begin; };
+
+        // Works for t >= ar_ord.
+        auto set_mean = [&](int64_t t) {
+            auto *mean_t = row(mean_ptr, t);
+            std::fill(mean_t, mean_t + width, mu);
+            for (int64_t j = 0; j != ar_ord; ++j) {
+                auto ar_j = ar[j];
+                const auto *out_lag = row(out_ptr, t - 1 - j);
+                for (int64_t c = 0; c != width; ++c) {
+                    mean_t[c] += ar_j*out_lag[c];
+                }
+            }
+        };
+
+        for (int64_t t = 0; t != ar_ord; ++t) {
+            std::fill(row(mean_ptr, t), row(mean_ptr, t) + width, first_draw);
+            std::fill(row(out_ptr, t), row(out_ptr, t) + width, first_draw);
+        }
+
+        for (int64_t t = ar_ord; t != ord; ++t) {
+            set_mean(t);
+            std::fill(row(out_ptr, t), row(out_ptr, t) + width, first_draw);
+        }
+
+        for (int64_t t = ord; t != total_size; ++t) {
+            set_mean(t);
+            // Works for t >= ord.
+            std::fill(var.begin(), var.end(), sigma2);
+            for (int64_t j = 0; j != arch_ord; ++j) {
+                auto arch_j = arch[j];
+                const auto *out_lag = row(out_ptr, t - 1 - j);
+                const auto *mean_lag = row(mean_ptr, t - 1 - j);
+                for (int64_t c = 0; c != width; ++c) {
+                    auto err = out_lag[c] - mean_lag[c];
+                    var[c] += arch_j*err*err;
+                }
+            }
+            const auto *mean_t = row(mean_ptr, t);
+            const auto *z_t = z_ptr + t*num_paths + begin;
+            auto *out_t = row(out_ptr, t);
+            for (int64_t c = 0; c != width; ++c) {
+                out_t[c] = std::sqrt(var[c])*z_t[c] + mean_t[c];
+            }
+        }
+    });
+
+    return out.index({torch::indexing::Slice(burn_in_size, total_size)}).t().contiguous();
+}
+
 template<class VarParameterisation>
 class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
     public:
@@ -67,6 +174,9 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
             if (exogenous_name.numel()) exogenous_name = this->register_buffer("exogenous_name", exogenous_name.clone());
         }
 
+        // Parameters stacked along a leading batch dimension, as by
+        // ProbabilisticModule::clone_batch, forecast observations that share
+        // it, each batch under its own parameters.
         std::unique_ptr<Distribution> forward(const torch::OrderedDict<std::string, torch::Tensor>& observations) override {
             if (regressand_name.numel() == 0) {
                 throw std::logic_error("observations_name.numel() == 0");
@@ -109,17 +219,14 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
                 regressand_means = regressand_means.expand_as(regressand);
             }
             if (mean_exogenous_coef->enabled()) {
-                regressand_means = missing::handle_na(
-                    [](const torch::Tensor& m, const torch::Tensor& ed, const torch::Tensor& ec) {
-                        return m + torch::matmul(ed, ec);
-                    },
-                    regressand_means,
-                    exo,
-                    mean_exogenous_coef->get()
-                );
+                regressand_means = missing::elementwise(
+                    std::plus<torch::Tensor>(),
+                    missing::MaskedTensor(regressand_means),
+                    missing::matvec(missing::MaskedTensor(exo), missing::MaskedTensor(mean_exogenous_coef->get()))
+                ).to_na();
             }
             if (ar->enabled()) {
-                regressand_means = missing::handle_na(
+                regressand_means = missing::handle_na_elementwise(
                     [](const torch::Tensor& m, const torch::Tensor& oar) {
                         return m + oar;
                     },
@@ -137,18 +244,15 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
                 regressand_std_devs = regressand_std_devs.expand_as(regressand);
             }
             if (var_exogenous_coef->enabled()) {
-                regressand_std_devs = missing::handle_na(
-                    [](const torch::Tensor& o, const torch::Tensor& ed, const torch::Tensor& ec) {
-                        return o + torch::matmul(ed, ec);
-                    },
-                    regressand_std_devs,
-                    exo,
-                    var_exogenous_coef->get()
-                );
+                regressand_std_devs = missing::elementwise(
+                    std::plus<torch::Tensor>(),
+                    missing::MaskedTensor(regressand_std_devs),
+                    missing::matvec(missing::MaskedTensor(exo), missing::MaskedTensor(var_exogenous_coef->get()))
+                ).to_na();
             }
 
             if (arch->enabled()) {
-                auto residuals2 = missing::handle_na(
+                auto residuals2 = missing::handle_na_elementwise(
                     [](const torch::Tensor& o, const torch::Tensor& m) {
                         return (o - m).square();
                     },
@@ -156,7 +260,7 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
                     regressand_means
                 );
 
-                regressand_std_devs = missing::handle_na(
+                regressand_std_devs = missing::handle_na_elementwise(
                     [](const torch::Tensor& osd, const torch::Tensor& oarch) {
                         return osd + oarch;
                     },
@@ -166,7 +270,7 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
             }
             auto vtcrimp = var_transformation_crimp.item<double>();
             auto vtcatch = var_transformation_catch.item<double>();
-            regressand_std_devs = missing::handle_na(
+            regressand_std_devs = missing::handle_na_elementwise(
                 [vtcrimp, vtcatch](const torch::Tensor& osd) {
                     return torch::sqrt(var_transformation(osd, vtcrimp, vtcatch));
                 },
@@ -179,17 +283,135 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
             );
         }
 
+        torch::Tensor fused_average_score(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const ScoringRule& scoring_rule,
+            double barrier_multiplier
+        ) override {
+            if (!is_log_score(scoring_rule) || mean_exogenous_coef->enabled() || var_exogenous_coef->enabled()) {
+                return torch::Tensor();
+            }
+
+            auto zero = torch::full({}, 0.0, torch::kDouble);
+            auto empty = torch::empty({0}, torch::kDouble);
+            auto mu_get = mu->enabled() ? mu->get() : zero;
+            auto ar_get = ar->enabled() ? ar->get() : empty;
+            auto sigma2_get = sigma2->enabled() ? sigma2->get() : zero;
+            auto arch_get = arch->enabled() ? arch->get() : empty;
+            if (mu_get.numel() != 1 || sigma2_get.numel() != 1 || ar_get.ndimension() > 1 || arch_get.ndimension() > 1) {
+                return torch::Tensor();
+            }
+
+            std::string regressand_name_str = static_cast<char *>(regressand_name.data_ptr());
+            int64_t sample_size;
+            auto score_sum = ARARCHTX_normal_log_score_sum(
+                observations[regressand_name_str],
+                mu_get,
+                ar_get,
+                sigma2_get,
+                arch_get,
+                var_transformation_crimp.item<double>(),
+                var_transformation_catch.item<double>(),
+                &sample_size
+            );
+
+            // The barrier is the same for every observation, see barrier below.
+            auto scaling = torch::full({1}, barrier_multiplier, torch::kDouble);
+            auto barrier_each = zero;
+            if (mu->enabled()) barrier_each = barrier_each + (scaling*mu->barrier()).sum();
+            if (ar->enabled()) barrier_each = barrier_each + ar->barrier(scaling).sum();
+            if (sigma2->enabled()) barrier_each = barrier_each + (scaling*sigma2->barrier()).sum();
+            if (arch->enabled()) barrier_each = barrier_each + arch->barrier(scaling).sum();
+
+            // As ScoringRule::average, whose sum begins at one.
+            return (score_sum + 1.0)/sample_size + barrier_each;
+        }
+
+        torch::Tensor fused_average_scores(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const ScoringRule& scoring_rule,
+            double barrier_multiplier
+        ) override {
+            if (!is_log_score(scoring_rule) || mean_exogenous_coef->enabled() || var_exogenous_coef->enabled()) {
+                return torch::Tensor();
+            }
+
+            std::string regressand_name_str = static_cast<char *>(regressand_name.data_ptr());
+            const auto& regressand = observations[regressand_name_str];
+            if (regressand.ndimension() != 2) {
+                return torch::Tensor();
+            }
+            auto num_replications = regressand.size(0);
+
+            auto zero = torch::full({}, 0.0, torch::kDouble);
+            auto empty = torch::empty({0}, torch::kDouble);
+            auto mu_get = mu->enabled() ? mu->get() : zero;
+            auto ar_get = ar->enabled() ? ar->get() : empty;
+            auto sigma2_get = sigma2->enabled() ? sigma2->get() : zero;
+            auto arch_get = arch->enabled() ? arch->get() : empty;
+            auto stacked = [num_replications](const torch::Tensor& p, bool vector) {
+                return vector ? p.ndimension() == 2 && p.size(0) == num_replications
+                              : p.numel() == num_replications;
+            };
+            if ((mu->enabled() && !stacked(mu_get, false)) || (ar->enabled() && !stacked(ar_get, true)) ||
+                (sigma2->enabled() && !stacked(sigma2_get, false)) || (arch->enabled() && !stacked(arch_get, true))) {
+                return torch::Tensor();
+            }
+
+            torch::Tensor sample_sizes;
+            auto score_sums = ARARCHTX_normal_log_score_sums(
+                regressand,
+                mu_get,
+                ar_get,
+                sigma2_get,
+                arch_get,
+                var_transformation_crimp.item<double>(),
+                var_transformation_catch.item<double>(),
+                &sample_sizes
+            );
+
+            // As in fused_average_score, but the barrier of each replication
+            // from its own row of the stacked parameters.
+            auto scaling = torch::full({1}, barrier_multiplier, torch::kDouble);
+            auto per_replication = [num_replications](const torch::Tensor& b, bool mean) {
+                if (b.numel() == 1) {
+                    return b.reshape({}).expand({num_replications});
+                }
+                auto b_rows = b.reshape({num_replications, -1});
+                return mean ? b_rows.mean(-1) : b_rows.sum(-1);
+            };
+            auto barrier_each = torch::zeros({num_replications}, torch::kDouble);
+            if (mu->enabled()) barrier_each = barrier_each + per_replication(scaling*mu->barrier(), false);
+            if (ar->enabled()) barrier_each = barrier_each + per_replication(ar->barrier_elements(scaling), true);
+            if (sigma2->enabled()) barrier_each = barrier_each + per_replication(scaling*sigma2->barrier(), false);
+            if (arch->enabled()) barrier_each = barrier_each + per_replication(arch->barrier_elements(scaling), true);
+
+            return (score_sums + 1.0)/sample_sizes + barrier_each;
+        }
+
         torch::OrderedDict<std::string, torch::Tensor> draw_observations(
             int64_t sample_size,
             int64_t burn_in_size,
             double first_draw
+        ) const override {
+            auto paths = draw_replicate_observations(1, sample_size, burn_in_size, first_draw, 1);
+            for (auto& item : paths) {
+                item.value() = item.value().select(0, 0);
+            }
+            return paths;
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> draw_replicate_observations(
+            int64_t num_paths,
+            int64_t sample_size,
+            int64_t burn_in_size,
+            double first_draw,
+            int64_t num_threads
         ) const override {
             if (mean_exogenous_coef->enabled() || var_exogenous_coef->enabled()) {
                 throw std::runtime_error("ARARCHTX::draw_observations not implemented for ARARCHTX models with exogenous coefficients.");
             }
 
-            auto total_size = burn_in_size + sample_size;
-
             auto zero = torch::full({1}, 0.0, torch::kDouble);
 
             torch::Tensor mu_get = mu->enabled() ? mu->get().detach() : zero;
@@ -197,94 +419,32 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
             torch::Tensor sigma2_get = sigma2->enabled() ? sigma2->get().detach() : zero;
             torch::Tensor arch_get = arch->enabled() ? arch->get().detach() : zero;
 
-            auto ar_sizes = ar_get.sizes();
-            auto arch_sizes = arch_get.sizes();
-
             {
                 const char* msg = "ARARCHTX::draw_observations not implemented for ARARCHTX models with a multi-dimensional index.";
 
-                auto mu_sizes = mu_get.sizes();
-                if (mu_sizes.size() > 1 || (mu_sizes.size() == 1 && mu_sizes.front() > 1)) {
-                    throw std::runtime_error(msg);
-                }
-
-                if (ar_sizes.size() > 1) {
-                    throw std::runtime_error(msg);
-                }
-
-                auto sigma2_sizes = sigma2_get.sizes();
-                if (sigma2_sizes.size() > 1 || (sigma2_sizes.size() == 1 && sigma2_sizes.front() > 1)) {
-                    throw std::runtime_error(msg);
-                }
-
-                if (arch_sizes.size() > 1) {
+                if (mu_get.numel() != 1 || ar_get.ndimension() > 1 || sigma2_get.numel() != 1 || arch_get.ndimension() > 1) {
                     throw std::runtime_error(msg);
                 }
             }
 
             std::string regressand_name_str = static_cast<char *>(regressand_name.data_ptr());
 
-            auto ar_ord = ar_sizes.front();
-            auto arch_ord = arch_sizes.front();
-            auto ord = ar_ord + arch_ord;
-
-            if (total_size <= ord) {
-                return {{regressand_name_str, torch::full({sample_size}, first_draw, torch::kDouble)}};
-            }
-
-            auto z = at::normal(
-                torch::full({total_size}, 0.0, torch::kDouble),
-                torch::full({total_size}, 1.0, torch::kDouble)
-            );
-
-            auto mean = torch::full({total_size}, std::numeric_limits<double>::quiet_NaN(), torch::kDouble);
-            auto out = torch::full({total_size}, std::numeric_limits<double>::quiet_NaN(), torch::kDouble);
-
-            auto mu_d = mu_get.item<double>();
-            auto ar_a = ar_get.accessor<double,1>();
-            auto sigma2_d = sigma2_get.item<double>();
-            auto arch_a = arch_get.accessor<double,1>();
-            auto z_a = z.accessor<double,1>();
-            auto mean_a = mean.accessor<double,1>();
-            auto out_a = out.accessor<double,1>();
-
-            auto get_mean_i = [&](auto i) {
-                // Works for i >= ar_ord.
-                auto mean_i = mu_d;
-                for (decltype(ar_ord) j = 0; j != ar_ord; ++j) {
-                    mean_i += ar_a[j]*out_a[i-1-j];
-                }
-                return mean_i;
+            auto to_vector = [](const torch::Tensor& x) {
+                auto x_c = x.to(torch::kDouble).contiguous();
+                return std::vector<double>(x_c.data_ptr<double>(), x_c.data_ptr<double>() + x_c.numel());
             };
 
-            auto get_var_i = [&](auto i) {
-                // Works for i >= ord (ord = ar_ord + arch_ord).
-                auto var_i = sigma2_d;
-                for (decltype(arch_ord) j = 0; j != arch_ord; ++j) {
-                    auto err = out_a[i-1-j] - mean_a[i-1-j];
-                    var_i += arch_a[j]*err*err;
-                }
-                return var_i;
-            };
-
-            for (decltype(ar_ord) i = 0; i != ar_ord; ++i) {
-                mean_a[i] = first_draw;
-                out_a[i] = first_draw;
-            }
-
-            for (decltype(ord) i = ar_ord; i != ord; ++i) {
-                mean_a[i] = get_mean_i(i);
-                out_a[i] = first_draw;
-            }
-
-            for (decltype(total_size) i = ord; i != total_size; ++i) {
-                auto mean_i = get_mean_i(i);
-                auto var_i = get_var_i(i);
-                mean_a[i] = mean_i;
-                out_a[i] = std::sqrt(var_i)*z_a[i] + mean_i;
-            }
-
-            return {{regressand_name_str, out.index({torch::indexing::Slice(burn_in_size, total_size)})}};
+            return {{regressand_name_str, ARARCHTX_draw_paths(
+                num_paths,
+                sample_size,
+                burn_in_size,
+                first_draw,
+                mu_get.item<double>(),
+                to_vector(ar_get),
+                sigma2_get.item<double>(),
+                to_vector(arch_get),
+                num_threads
+            )}};
         }
 
         torch::OrderedDict<std::string, torch::Tensor> barrier(
@@ -304,10 +464,10 @@ class ARARCHTX : public ProbabilisticCloneable<ARARCHTX<VarParameterisation>> {
             auto barrier_out = torch::full(regressand.sizes(), 0.0);
             if (mu->enabled()) barrier_out += scaling*expand_as_regressand(mu->barrier());
             if (mean_exogenous_coef->enabled()) barrier_out += scaling*expand_as_regressand(mean_exogenous_coef->barrier());
-            if (ar->enabled()) barrier_out += ar->barrier(scaling);
+            if (ar->enabled()) barrier_out += expand_as_regressand(ar->barrier(scaling));
             if (sigma2->enabled()) barrier_out += scaling*expand_as_regressand(sigma2->barrier());
             if (var_exogenous_coef->enabled()) barrier_out += scaling*expand_as_regressand(var_exogenous_coef->barrier());
-            if (arch->enabled()) barrier_out += arch->barrier(scaling);
+            if (arch->enabled()) barrier_out += expand_as_regressand(arch->barrier(scaling));
 
             return {{std::move(regressand_name_str), std::move(barrier_out)}};
         }
@@ -0,0 +1,300 @@
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <modelling/model/ARARCHTX_normal_log_score.hpp>
+
+// See
+// https://pytorch.org/tutorials/advanced/cpp_autograd.html#using-custom-autograd-function-in-c
+
+using namespace torch::autograd;
+
+constexpr double half_log_2_pi = 0.9189385332046727417803297364056176398613974736377834128171515404;
+
+// var_transformation in ARARCHTX.cpp, and its derivative, for doubles.
+class VarTransformation {
+    public:
+        VarTransformation(double vtcrimp_in, double vtcatch_in):
+            vtcrimp(vtcrimp_in),
+            vtcatch(vtcatch_in)
+        {
+            if (vtcrimp < 0.0) {
+                throw std::logic_error("vtcrimp < 0.0");
+            }
+        }
+
+        double value(double x) const {
+            if (vtcrimp > 0.0) {
+                auto x_div_crimp = x/vtcrimp;
+                auto softplus = x_div_crimp > 0.0 ? x_div_crimp + std::log1p(std::exp(-x_div_crimp)) : std::log1p(std::exp(x_div_crimp));
+                return vtcrimp*softplus + vtcatch/(x_div_crimp*x_div_crimp + 1.0);
+            }
+            return x > 0.0 ? x : 0.0;
+        }
+
+        double derivative(double x) const {
+            if (vtcrimp > 0.0) {
+                auto x_div_crimp = x/vtcrimp;
+                auto denominator = x_div_crimp*x_div_crimp + 1.0;
+                auto sigmoid = 1.0/(1.0 + std::exp(-x_div_crimp));
+                return sigmoid - 2.0*vtcatch*x_div_crimp/(vtcrimp*denominator*denominator);
+            }
+            // As the gradient of torch::clamp_min.
+            return x >= 0.0 ? 1.0 : 0.0;
+        }
+
+    private:
+        double vtcrimp;
+        double vtcatch;
+};
+
+// Per series pointer increments for a parameter, zero if it is shared by every series.
+static int64_t series_stride(const torch::Tensor& parameter, bool per_series) {
+    return per_series ? parameter.sizes().back() : 0;
+}
+
+class ARARCHTXNormalLogScoreSums : public Function<ARARCHTXNormalLogScoreSums> {
+    public:
+        static variable_list forward(
+            AutogradContext *ctx,
+            torch::Tensor mu,
+            torch::Tensor ar,
+            torch::Tensor sigma2,
+            torch::Tensor arch,
+            torch::Tensor regressand,
+            double vtcrimp,
+            double vtcatch
+        ) {
+            VarTransformation vt(vtcrimp, vtcatch);
+
+            auto y = regressand.detach().to(torch::kDouble).contiguous();
+            auto t_size = y.ndimension() ? y.sizes().back() : 1;
+            auto num_series = t_size ? y.numel()/t_size : 0;
+            const auto *y_ptr = y.data_ptr<double>();
+
+            // Scalars and vectors are shared by every series, otherwise
+            // the parameters carry one row per series.
+            bool mu_per_series = mu.numel() != 1;
+            bool sigma2_per_series = sigma2.numel() != 1;
+            bool ar_per_series = ar.ndimension() > 1;
+            bool arch_per_series = arch.ndimension() > 1;
+
+            auto mu_c = mu.detach().to(torch::kDouble).reshape({-1, 1}).contiguous();
+            auto sigma2_c = sigma2.detach().to(torch::kDouble).reshape({-1, 1}).contiguous();
+            auto ar_c = ar.detach().to(torch::kDouble).reshape({ar_per_series ? ar.size(0) : 1, ar.ndimension() ? ar.sizes().back() : 1}).contiguous();
+            auto arch_c = arch.detach().to(torch::kDouble).reshape({arch_per_series ? arch.size(0) : 1, arch.ndimension() ? arch.sizes().back() : 1}).contiguous();
+            const auto *mu_ptr = mu_c.data_ptr<double>();
+            const auto *sigma2_ptr = sigma2_c.data_ptr<double>();
+            const auto *ar_ptr = ar_c.data_ptr<double>();
+            const auto *arch_ptr = arch_c.data_ptr<double>();
+            auto ar_ord = ar_c.size(1);
+            auto arch_ord = arch_c.size(1);
+            auto mu_stride = series_stride(mu_c, mu_per_series);
+            auto sigma2_stride = series_stride(sigma2_c, sigma2_per_series);
+            auto ar_stride = series_stride(ar_c, ar_per_series);
+            auto arch_stride = series_stride(arch_c, arch_per_series);
+
+            auto options = torch::TensorOptions().dtype(torch::kDouble);
+            auto score_sums = torch::zeros({num_series}, options);
+            auto sample_sizes = torch::zeros({num_series}, torch::kLong);
+            auto grad_mu = torch::zeros({num_series}, options);
+            auto grad_ar = torch::zeros({num_series, ar_ord}, options);
+            auto grad_sigma2 = torch::zeros({num_series}, options);
+            auto grad_arch = torch::zeros({num_series, arch_ord}, options);
+            auto *score_sums_ptr = score_sums.data_ptr<double>();
+            auto *sample_sizes_ptr = sample_sizes.data_ptr<int64_t>();
+            auto *grad_mu_ptr = grad_mu.data_ptr<double>();
+            auto *grad_ar_ptr = grad_ar.data_ptr<double>();
+            auto *grad_sigma2_ptr = grad_sigma2.data_ptr<double>();
+            auto *grad_arch_ptr = grad_arch.data_ptr<double>();
+
+            // Residuals, whether they are present, and the gradient of the
+            // score sum with respect to them, for the current series.
+            std::vector<double> e(t_size);
+            std::vector<char> e_present(t_size);
+            std::vector<double> grad_e(t_size);
+
+            for (decltype(num_series) s = 0; s != num_series; ++s) {
+                const auto *ys = y_ptr + s*t_size;
+                auto mu_s = mu_ptr[s*mu_stride];
+                auto sigma2_s = sigma2_ptr[s*sigma2_stride];
+                const auto *ar_s = ar_ptr + s*ar_stride;
+                const auto *arch_s = arch_ptr + s*arch_stride;
+                auto *grad_ar_s = grad_ar_ptr + s*ar_ord;
+                auto *grad_arch_s = grad_arch_ptr + s*arch_ord;
+
+                double score_sum = 0.0;
+                int64_t sample_size = 0;
+                double grad_mu_s = 0.0;
+                double grad_sigma2_s = 0.0;
+
+                for (decltype(t_size) t = 0; t != t_size; ++t) {
+                    bool present = t >= ar_ord && missing::is_present(ys[t]);
+                    auto mean = mu_s;
+                    for (decltype(ar_ord) j = 0; present && j != ar_ord; ++j) {
+                        present = missing::is_present(ys[t-1-j]);
+                        mean += ar_s[j]*ys[t-1-j];
+                    }
+                    e_present[t] = present;
+                    e[t] = present ? ys[t] - mean : 0.0;
+                    grad_e[t] = 0.0;
+                }
+
+                for (decltype(t_size) t = 0; t != t_size; ++t) {
+                    if (!e_present[t] || t < arch_ord) continue;
+
+                    bool present = true;
+                    auto var = sigma2_s;
+                    for (decltype(arch_ord) j = 0; present && j != arch_ord; ++j) {
+                        present = e_present[t-1-j];
+                        var += arch_s[j]*e[t-1-j]*e[t-1-j];
+                    }
+                    if (!present) continue;
+
+                    auto w = vt.value(var);
+                    auto e2_div_w = e[t]*e[t]/w;
+                    auto score = -half_log_2_pi - 0.5*std::log(w) - 0.5*e2_div_w;
+                    if (std::isnan(score)) continue; // As missing::handle_na.
+
+                    score_sum += score;
+                    ++sample_size;
+
+                    // d score/d e_t, and d score/d var via w = vt(var).
+                    grad_e[t] -= e[t]/w;
+                    auto grad_var = 0.5*(e2_div_w - 1.0)/w*vt.derivative(var);
+                    grad_sigma2_s += grad_var;
+                    for (decltype(arch_ord) j = 0; j != arch_ord; ++j) {
+                        grad_arch_s[j] += grad_var*e[t-1-j]*e[t-1-j];
+                        grad_e[t-1-j] += 2.0*grad_var*arch_s[j]*e[t-1-j];
+                    }
+                }
+
+                // e_t = y_t - mu - sum_j ar_j y_{t-1-j}.
+                for (decltype(t_size) t = 0; t != t_size; ++t) {
+                    if (!e_present[t]) continue;
+                    grad_mu_s -= grad_e[t];
+                    for (decltype(ar_ord) j = 0; j != ar_ord; ++j) {
+                        grad_ar_s[j] -= grad_e[t]*ys[t-1-j];
+                    }
+                }
+
+                score_sums_ptr[s] = score_sum;
+                sample_sizes_ptr[s] = sample_size;
+                grad_mu_ptr[s] = grad_mu_s;
+                grad_sigma2_ptr[s] = grad_sigma2_s;
+            }
+
+            ctx->save_for_backward({grad_mu, grad_ar, grad_sigma2, grad_arch});
+            ctx->saved_data["mu_sizes"] = mu.sizes().vec();
+            ctx->saved_data["ar_sizes"] = ar.sizes().vec();
+            ctx->saved_data["sigma2_sizes"] = sigma2.sizes().vec();
+            ctx->saved_data["arch_sizes"] = arch.sizes().vec();
+            ctx->saved_data["mu_per_series"] = mu_per_series;
+            ctx->saved_data["ar_per_series"] = ar_per_series;
+            ctx->saved_data["sigma2_per_series"] = sigma2_per_series;
+            ctx->saved_data["arch_per_series"] = arch_per_series;
+
+            ctx->mark_non_differentiable({sample_sizes});
+
+            return {std::move(score_sums), std::move(sample_sizes)};
+        }
+
+        static variable_list backward(AutogradContext *ctx, variable_list grad_outputs) {
+            auto saved = ctx->get_saved_variables();
+            const auto& grad_output = grad_outputs[0];
+
+            // The saved gradients have one row per series, which parameters
+            // shared by every series sum over.
+            auto chain = [&](const torch::Tensor& grad_each, const std::string& name) {
+                auto grad = grad_each.ndimension() > 1 ? grad_output.unsqueeze(-1)*grad_each : grad_output*grad_each;
+                if (!ctx->saved_data[name + "_per_series"].toBool()) {
+                    grad = grad.sum(0);
+                }
+                return grad.reshape(ctx->saved_data[name + "_sizes"].toIntVector());
+            };
+
+            return {
+                chain(saved[0], "mu"),
+                chain(saved[1], "ar"),
+                chain(saved[2], "sigma2"),
+                chain(saved[3], "arch"),
+                torch::Tensor(),
+                torch::Tensor(),
+                torch::Tensor()
+            };
+        }
+};
+
+torch::Tensor ARARCHTX_normal_log_score_sums(
+    const torch::Tensor& regressand,
+    torch::Tensor mu,
+    torch::Tensor ar,
+    torch::Tensor sigma2,
+    torch::Tensor arch,
+    double var_transformation_crimp,
+    double var_transformation_catch,
+    torch::Tensor *sample_sizes
+) {
+    auto t_size = regressand.ndimension() ? regressand.sizes().back() : 1;
+    auto num_series = t_size ? regressand.numel()/t_size : 0;
+    auto per_series_rows = [num_series](const torch::Tensor& parameter, bool matrix) {
+        return matrix ? parameter.ndimension() == 2 && parameter.size(0) == num_series
+                      : parameter.numel() == 1 || parameter.numel() == num_series;
+    };
+    if (!per_series_rows(mu, false) || !per_series_rows(sigma2, false) ||
+        (ar.ndimension() > 1 && !per_series_rows(ar, true)) || (arch.ndimension() > 1 && !per_series_rows(arch, true))) {
+        throw std::logic_error("ARARCHTX_normal_log_score_sums: mu and sigma2 must be scalars or have one element per series, and ar and arch vectors or have one row per series.");
+    }
+
+    auto out = ARARCHTXNormalLogScoreSums::apply(
+        std::move(mu),
+        std::move(ar),
+        std::move(sigma2),
+        std::move(arch),
+        regressand,
+        var_transformation_crimp,
+        var_transformation_catch
+    );
+
+    if (sample_sizes) {
+        *sample_sizes = std::move(out[1]);
+    }
+
+    return out[0];
+}
+
+torch::Tensor ARARCHTX_normal_log_score_sum(
+    const torch::Tensor& regressand,
+    torch::Tensor mu,
+    torch::Tensor ar,
+    torch::Tensor sigma2,
+    torch::Tensor arch,
+    double var_transformation_crimp,
+    double var_transformation_catch,
+    int64_t *sample_size
+) {
+    if (mu.numel() != 1 || sigma2.numel() != 1 || ar.ndimension() > 1 || arch.ndimension() > 1) {
+        throw std::logic_error("ARARCHTX_normal_log_score_sum: mu and sigma2 must be scalars, and ar and arch vectors.");
+    }
+
+    torch::Tensor sample_sizes;
+    auto score_sums = ARARCHTX_normal_log_score_sums(
+        regressand,
+        std::move(mu),
+        std::move(ar),
+        std::move(sigma2),
+        std::move(arch),
+        var_transformation_crimp,
+        var_transformation_catch,
+        &sample_sizes
+    );
+
+    if (sample_size) {
+        *sample_size = sample_sizes.sum().item<int64_t>();
+    }
+
+    return score_sums.sum();
+}
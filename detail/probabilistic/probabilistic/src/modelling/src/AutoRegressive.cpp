@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/Parameterisation.hpp>
 #include <modelling/model/ShapelyModule.hpp>
@@ -32,11 +33,8 @@ torch::Tensor AutoRegressive_forward(
         );
     }
 
-    return missing::handle_na(
-        torch::matmul,
-        ar_covariates,
-        coefficients_get
-    );
+    // Coefficients stacked along leading dimensions give each batch of x its own.
+    return missing::matvec(missing::MaskedTensor(ar_covariates), missing::MaskedTensor(coefficients_get)).to_na();
 }
 
 torch::OrderedDict<std::string, std::vector<std::vector<torch::indexing::TensorIndex>>> AutoRegressive_observations_by_parameter(
@@ -40,19 +40,23 @@ class CensoredLogScore : public ScoringRule {
             const Distribution& forecasts,
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            auto log_score = forecasts.log_density(observations);
-            
-            auto log_probability_off_focus = [&]() {
-                if (complement) {
-                    // Focus on complement of interval, so we need log probability of interval.
-                    return forecasts.log_interval_probability(open_lower_bound, closed_upper_bound);
-                }
-                    
-                // Focus on interval, so we need the log probability of interval's complement.
-                return forecasts.log_interval_complement_probability(open_lower_bound, closed_upper_bound);
-            }();
-
-            decltype(log_score) censored_log_score;
+            // Both quantities in one pass over the forecasts.
+            DistributionEvaluationRequest request;
+            request.log_density = true;
+            // Focus on complement of interval, so we need log probability of interval,
+            // or focus on interval, so we need the log probability of interval's complement.
+            request.log_interval_probability = complement;
+            request.log_interval_complement_probability = !complement;
+            request.open_lower_bound = open_lower_bound;
+            request.closed_upper_bound = closed_upper_bound;
+            auto evaluation = forecasts.evaluate(observations, request);
+
+            const auto& log_score = evaluation.log_density;
+            const auto& log_probability_off_focus = complement ?
+                evaluation.log_interval_probability :
+                evaluation.log_interval_complement_probability;
+
+            torch::OrderedDict<std::string, torch::Tensor> censored_log_score;
             censored_log_score.reserve(log_score.size());
             for (const auto& item : log_score) {
                 const auto& name = item.key();
@@ -116,8 +120,12 @@ class ProbabilityCensoredLogScore : public ScoringRule {
             const Distribution& forecasts,
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            auto log_score = forecasts.log_density(observations);
-            auto cdfs = forecasts.cdf(observations);
+            DistributionEvaluationRequest request;
+            request.log_density = true;
+            request.cdf = true;
+            auto evaluation = forecasts.evaluate(observations, request);
+            const auto& log_score = evaluation.log_density;
+            const auto& cdfs = evaluation.cdf;
 
             auto log_probability_off_focus = [&]() {
                 if (complement) {
@@ -129,7 +137,7 @@ class ProbabilityCensoredLogScore : public ScoringRule {
                 return std::log1p(open_lower_probability - closed_upper_probability);
             }();
 
-            decltype(log_score) censored_log_score;
+            torch::OrderedDict<std::string, torch::Tensor> censored_log_score;
             censored_log_score.reserve(log_score.size());
             for (const auto& item : log_score) {
                 const auto& name = item.key();
@@ -454,6 +454,46 @@ torch::OrderedDict<std::string, torch::Tensor> Distribution::log_interval_comple
     );
 }
 
+DistributionEvaluation Distribution::evaluate(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    const DistributionEvaluationRequest& request
+) const {
+    DistributionEvaluation out;
+    if (request.log_density) {
+        out.log_density = log_density(observations);
+    }
+    if (request.cdf) {
+        out.cdf = cdf(observations);
+    }
+    if (request.log_cdf) {
+        out.log_cdf = log_cdf(observations);
+    }
+    if (request.log_ccdf) {
+        out.log_ccdf = log_ccdf(observations);
+    }
+    if (request.log_interval_probability) {
+        out.log_interval_probability = log_interval_probability(request.open_lower_bound, request.closed_upper_bound);
+    }
+    if (request.log_interval_complement_probability) {
+        out.log_interval_complement_probability = log_interval_complement_probability(request.open_lower_bound, request.closed_upper_bound);
+    }
+    return out;
+}
+
+torch::OrderedDict<std::string, torch::Tensor> Distribution::draw_at(
+    const torch::OrderedDict<std::string, torch::Tensor>& mask
+) const {
+    auto draws = draw();
+
+    torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(mask.size());
+    for (const auto& item : mask) {
+        const auto& series = item.key();
+        out.insert(series, draws[series].index({item.value()}));
+    }
+
+    return out;
+}
+
 SEXP to_R_list(
     const char *R_distributional_dist,
     const torch::Tensor& parameters,
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 #include <libtorch_support/indexing.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/distribution/Mixture.hpp>
+#include <modelling/distribution/Normal.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/model/Ensemble.hpp>
 
@@ -36,10 +38,20 @@ class Ensemble : public ProbabilisticCloneable<Ensemble> {
         }
 
         std::unique_ptr<Distribution> forward(const torch::OrderedDict<std::string, torch::Tensor>& observations) override {
+            if (frozen_components && frozen_components->is_cached(observations)) {
+                const auto& cached = frozen_components->get_components();
+                if (std::all_of(cached.begin(), cached.end(), [](const auto& d) { return is_normal(*d); })) {
+                    return ManufactureMixtureOfNormals(frozen_components, weights->get());
+                }
+                return ManufactureMixture(frozen_components, weights->get());
+            }
             std::vector<std::shared_ptr<Distribution>> component_distributions; component_distributions.reserve(components.size());
             for (auto& item : components) {
                 component_distributions.emplace_back(item.value()->forward(observations));
             }
+            if (std::all_of(component_distributions.begin(), component_distributions.end(), [](const auto& d) { return is_normal(*d); })) {
+                return ManufactureMixtureOfNormals(std::move(component_distributions), weights->get());
+            }
             return ManufactureMixture(component_distributions, weights->get());
         }
 
@@ -61,10 +73,15 @@ class Ensemble : public ProbabilisticCloneable<Ensemble> {
                     }
                 }
             }
-            auto weights_barrier = scaling*weights->barrier().mean();
+            // For each row of any stacked weights, broadcast along the rest.
+            auto weights_barrier = scaling*weights->barrier().mean(-1);
             for (auto& item : barrier_out) {
                 auto& v = item.value();
-                v += weights_barrier;
+                auto weights_barrier_v = weights_barrier;
+                while (weights_barrier_v.ndimension() < v.ndimension()) {
+                    weights_barrier_v = weights_barrier_v.unsqueeze(-1);
+                }
+                v += weights_barrier_v;
             }
             return barrier_out;
         }
@@ -75,13 +92,43 @@ class Ensemble : public ProbabilisticCloneable<Ensemble> {
             const FitPlan& plan,
             FitDiagnostics *diagnostics
         ) override {
-            return ProbabilisticModule::fit(
-                observations,
-                std::move(scoring_rule),
-                plan,
-                get_parameters_to_optimise(),
-                diagnostics
-            );
+            if (optimise_components.item<bool>()) {
+                return ProbabilisticModule::fit(
+                    observations,
+                    std::move(scoring_rule),
+                    plan,
+                    parameters_to_optimise(),
+                    diagnostics
+                );
+            }
+
+            // The components are frozen, so forecast with them once, and let
+            // forward mix the cached component values for the rest of the fit.
+            frozen_components = [&]() {
+                torch::NoGradGuard no_grad;
+                std::vector<std::shared_ptr<Distribution>> component_distributions; component_distributions.reserve(components.size());
+                for (auto& item : components) {
+                    component_distributions.emplace_back(item.value()->forward(observations));
+                }
+                return std::make_shared<MixtureComponentCache>(std::move(component_distributions), observations);
+            }();
+
+            bool ret;
+            try {
+                ret = ProbabilisticModule::fit(
+                    observations,
+                    std::move(scoring_rule),
+                    plan,
+                    parameters_to_optimise(),
+                    diagnostics
+                );
+            } catch (...) {
+                frozen_components.reset();
+                throw;
+            }
+            frozen_components.reset();
+
+            return ret;
         }
 
         torch::OrderedDict<std::string, torch::OrderedDict<std::string, std::vector<std::vector<torch::indexing::TensorIndex>>>> observations_by_parameter(
@@ -291,15 +338,15 @@ class Ensemble : public ProbabilisticCloneable<Ensemble> {
             return out;
         }
 
-        std::vector<torch::Tensor> get_parameters_to_optimise(void) {
-            auto ow = optimise_weights.item<bool>();
-            auto oc = optimise_components.item<bool>();
-
-            if (!ow && !oc) {
-                throw std::logic_error("In the Ensemble ProbabilisticModule, we must optimise at least one of the weights and components.");
+        std::vector<torch::Tensor> parameters_to_optimise(void) override {
+            auto named_parameters_to_optimise = get_named_parameters_to_optimise();
+            std::vector<torch::Tensor> out; out.reserve(named_parameters_to_optimise.size());
+            for (const auto& item : named_parameters_to_optimise) {
+                if (item.value().requires_grad() && item.value().numel()) {
+                    out.emplace_back(item.value());
+                }
             }
-
-            return parameters(oc);
+            return out;
         }
 
         void estimating_equations_values_recursive_update(
@@ -346,6 +393,9 @@ class Ensemble : public ProbabilisticCloneable<Ensemble> {
         std::shared_ptr<Simplex> weights;
         torch::OrderedDict<std::string, std::shared_ptr<ProbabilisticModule>> components;
 
+        // Only set during a fit that leaves the components unchanged.
+        std::shared_ptr<MixtureComponentCache> frozen_components;
+
         torch::Tensor optimise_weights;
         torch::Tensor fixed_weights;
         torch::Tensor optimise_components;
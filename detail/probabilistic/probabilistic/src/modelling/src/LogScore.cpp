@@ -27,3 +27,6 @@ std::unique_ptr<ScoringRule> ManufactureLogScore(void) {
     return std::make_unique<LogScore>();
 }
 
+bool is_log_score(const ScoringRule& scoring_rule) {
+    return dynamic_cast<const LogScore*>(&scoring_rule);
+}
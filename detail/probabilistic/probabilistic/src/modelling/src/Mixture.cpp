@@ -1,21 +1,103 @@
 #include <algorithm>
+#include <functional>
+#include <initializer_list>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <numeric>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <utility>
 #include <R_protect_guard.hpp>
 #include <R_support/function.hpp>
 #include <data_translation/libtorch_tensor_to_R_list.hpp>
 #include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/indexing.hpp>
+#include <libtorch_support/standard_normal_log_cdf.hpp>
 #include <modelling/distribution/Distribution.hpp>
+#include <modelling/distribution/Normal.hpp>
 #include <modelling/distribution/Mixture.hpp>
 
+constexpr double log_2_pi = 1.8378770664093454835606594728112352797227949472755668256343030809;
+constexpr double inv_sqrt_2 = 0.7071067811865475244008443621048490392848359376884740365883398689;
+
+bool MixtureComponentCache::is_cached(const torch::OrderedDict<std::string, torch::Tensor>& observations_in) const {
+    if (observations_in.size() != observations.size()) {
+        return false;
+    }
+    for (const auto& item : observations) {
+        const auto *observations_in_value = observations_in.find(item.key());
+        if (!observations_in_value || !observations_in_value->is_same(item.value())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const torch::OrderedDict<std::string, torch::Tensor>& MixtureComponentCache::stacked(
+    const std::string& op_name,
+    const std::function<torch::OrderedDict<std::string, torch::Tensor>(void)>& stack,
+    double arg0,
+    double arg1
+) {
+    auto key = std::make_tuple(op_name, arg0, arg1);
+    auto iter = stacked_values.find(key);
+    if (iter == stacked_values.end()) {
+        iter = stacked_values.emplace(std::move(key), stack()).first;
+    }
+    return iter->second;
+}
+
+// Enough for bisection alone to narrow the bracket to rounding error.
+constexpr int64_t mixture_quantile_iterations = 50;
+
+// Vose's alias method, with a table for each row of weights [..., K]: the
+// probability of keeping each column, and the column taken otherwise.
+static std::pair<torch::Tensor, torch::Tensor> alias_table(const torch::Tensor& weights) {
+    auto num_components = weights.size(-1);
+    auto rows = weights.detach().to(torch::kDouble).reshape({-1, num_components}).contiguous();
+    auto num_rows = rows.size(0);
+
+    auto probability = torch::ones({num_rows, num_components}, torch::kDouble);
+    auto alias = torch::arange(num_components, torch::kLong).repeat({num_rows, 1});
+    auto rows_a = rows.accessor<double, 2>();
+    auto probability_a = probability.accessor<double, 2>();
+    auto alias_a = alias.accessor<int64_t, 2>();
+
+    std::vector<double> scaled(num_components);
+    std::vector<int64_t> small, large;
+    small.reserve(num_components);
+    large.reserve(num_components);
+    for (int64_t r = 0; r != num_rows; ++r) {
+        double total = 0.0;
+        for (int64_t c = 0; c != num_components; ++c) {
+            total += rows_a[r][c];
+        }
+        for (int64_t c = 0; c != num_components; ++c) {
+            scaled[c] = rows_a[r][c]*num_components/total;
+            (scaled[c] < 1.0 ? small : large).emplace_back(c);
+        }
+        while (!small.empty() && !large.empty()) {
+            auto s = small.back(); small.pop_back();
+            auto l = large.back(); large.pop_back();
+            probability_a[r][s] = scaled[s];
+            alias_a[r][s] = l;
+            scaled[l] -= 1.0 - scaled[s];
+            (scaled[l] < 1.0 ? small : large).emplace_back(l);
+        }
+        // Whatever remains has probability one, up to rounding.
+        small.clear();
+        large.clear();
+    }
+
+    return std::make_pair(std::move(probability), std::move(alias));
+}
+
 class Mixture : public Distribution {
     public:
         Mixture(
@@ -26,121 +108,283 @@ class Mixture : public Distribution {
             weights(weights_in)
         { }
 
+        Mixture(
+            std::shared_ptr<MixtureComponentCache> cache_in,
+            torch::Tensor weights_in
+        ):
+            components(cache_in->get_components()),
+            weights(weights_in),
+            cache(std::move(cache_in))
+        { }
+
         torch::OrderedDict<std::string, torch::Tensor> density(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return mix([&observations](const Distribution& d) { return d.density(observations); });
+            return mix(stack("density", observations, [&observations](const Distribution& d) { return d.density(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> density(
             double observations
         ) const override {
-            return mix([&observations](const Distribution& d) { return d.density(observations); });
+            return mix(stack("density(double)", observations, 0.0, [&observations](const Distribution& d) { return d.density(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_density(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return log_mix([&observations](const Distribution& d) { return d.log_density(observations); });
+            return log_mix(stack("log_density", observations, [&observations](const Distribution& d) { return d.log_density(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_density(
             double observations
         ) const override {
-            return log_mix([&observations](const Distribution& d) { return d.log_density(observations); });
+            return log_mix(stack("log_density(double)", observations, 0.0, [&observations](const Distribution& d) { return d.log_density(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> cdf(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return mix([&observations](const Distribution& d) { return d.cdf(observations); });
+            return mix(stack("cdf", observations, [&observations](const Distribution& d) { return d.cdf(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_cdf(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return log_mix([&observations](const Distribution& d) { return d.log_cdf(observations); });
+            return log_mix(stack("log_cdf", observations, [&observations](const Distribution& d) { return d.log_cdf(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> ccdf(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return mix([&observations](const Distribution& d) { return d.ccdf(observations); });
+            return mix(stack("ccdf", observations, [&observations](const Distribution& d) { return d.ccdf(observations); }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_ccdf(
             const torch::OrderedDict<std::string, torch::Tensor>& observations
         ) const override {
-            return log_mix([&observations](const Distribution& d) { return d.log_ccdf(observations); });
+            return log_mix(stack("log_ccdf", observations, [&observations](const Distribution& d) { return d.log_ccdf(observations); }));
+        }
+
+        // Each component evaluates the quantities in one pass of its own,
+        // which are then mixed. Cached components keep to the cache instead.
+        DistributionEvaluation evaluate(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const DistributionEvaluationRequest& request
+        ) const override {
+            if (cache && cache->is_cached(observations)) {
+                return Distribution::evaluate(observations, request);
+            }
+
+            std::vector<DistributionEvaluation> component_evaluations; component_evaluations.reserve(components.size());
+            for (const auto& c : components) {
+                component_evaluations.emplace_back(c->evaluate(observations, request));
+            }
+            auto stacked = [&component_evaluations](torch::OrderedDict<std::string, torch::Tensor> DistributionEvaluation::*quantity) {
+                std::vector<torch::OrderedDict<std::string, torch::Tensor>> component_values; component_values.reserve(component_evaluations.size());
+                for (auto& e : component_evaluations) {
+                    component_values.emplace_back(std::move(e.*quantity));
+                }
+                return concatenate(component_values);
+            };
+
+            DistributionEvaluation out;
+            if (request.log_density) {
+                out.log_density = log_mix(stacked(&DistributionEvaluation::log_density));
+            }
+            if (request.cdf) {
+                out.cdf = mix(stacked(&DistributionEvaluation::cdf));
+            }
+            if (request.log_cdf) {
+                out.log_cdf = log_mix(stacked(&DistributionEvaluation::log_cdf));
+            }
+            if (request.log_ccdf) {
+                out.log_ccdf = log_mix(stacked(&DistributionEvaluation::log_ccdf));
+            }
+            if (request.log_interval_probability) {
+                out.log_interval_probability = log_mix(stacked(&DistributionEvaluation::log_interval_probability));
+            }
+            if (request.log_interval_complement_probability) {
+                out.log_interval_complement_probability = log_mix(stacked(&DistributionEvaluation::log_interval_complement_probability));
+            }
+            return out;
+        }
+
+        // Solves cdf(x) = p for every element of every series at once. The
+        // quantile lies between the least and greatest component quantiles,
+        // and Newton steps that leave the bracket are replaced by bisection,
+        // for a fixed number of iterations, so nothing waits on the values.
+        // A last Newton step is taken with the graph kept, so gradients with
+        // respect to the weights and components are those of the quantile,
+        // -(dcdf/dtheta)/density. The cdf and density are those of the
+        // mixture, so that a subclass with fused kernels iterates with them.
+        torch::OrderedDict<std::string, torch::Tensor> quantile(
+            const torch::OrderedDict<std::string, torch::Tensor>& probabilities
+        ) const override {
+            auto stacked_quantiles = stack([&probabilities](const Distribution& d) { return d.quantile(probabilities); });
+
+            torch::OrderedDict<std::string, torch::Tensor> x, lower, upper;
+            {
+                torch::NoGradGuard no_grad;
+                for (const auto& item : stacked_quantiles) {
+                    auto q = item.value().detach();
+                    lower.insert(item.key(), std::get<0>(q.min(-1)));
+                    upper.insert(item.key(), std::get<0>(q.max(-1)));
+                }
+                x = mix(stacked_quantiles);
+                for (int64_t iteration = 0; iteration != mixture_quantile_iterations; ++iteration) {
+                    auto cdf_x = cdf(x);
+                    auto density_x = density(x);
+                    for (auto& item : x) {
+                        const auto& key = item.key();
+                        auto& x_i = item.value();
+                        auto& lower_i = lower[key];
+                        auto& upper_i = upper[key];
+                        auto below = cdf_x[key].lt(probabilities[key]);
+                        lower_i = torch::where(below, x_i, lower_i);
+                        upper_i = torch::where(below, upper_i, x_i);
+                        auto newton = x_i - (cdf_x[key] - probabilities[key])/density_x[key];
+                        auto in_bracket = newton.gt(lower_i).logical_and(newton.lt(upper_i));
+                        x_i = torch::where(in_bracket, newton, 0.5*(lower_i + upper_i));
+                    }
+                }
+            }
+
+            auto cdf_x = cdf(x);
+            auto density_x = density(x);
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(x.size());
+            for (const auto& item : x) {
+                const auto& key = item.key();
+                const auto& x_i = item.value();
+                const auto& probabilities_i = probabilities[key];
+                auto density_i = density_x[key].detach();
+                auto quantile_i = torch::where(density_i.gt(0.0), x_i - (cdf_x[key] - probabilities_i)/density_i, x_i);
+                // Probabilities of 0 or 1 have every component quantile infinite.
+                // Finite coincident component quantiles keep the step above, so
+                // that gradients with respect to the components flow.
+                quantile_i = torch::where(lower[key].eq(upper[key]).logical_and(lower[key].isinf()), lower[key], quantile_i);
+                quantile_i = torch::where(missing::is_present(probabilities_i).logical_and(missing::is_present(x_i)), quantile_i, quantile_i.new_full({}, missing::na));
+                out.insert(key, std::move(quantile_i));
+            }
+            return out;
         }
 
         torch::OrderedDict<std::string, torch::Tensor> interval_probability(
             const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
             const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
         ) const override {
-            return mix([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+            return mix(stack([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
                 return d.interval_probability(open_lower_bound, closed_upper_bound);
-            });
+            }));
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> interval_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return mix(stack("interval_probability(double)", open_lower_bound, closed_upper_bound, [&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+                return d.interval_probability(open_lower_bound, closed_upper_bound);
+            }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> interval_complement_probability(
             const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
             const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
         ) const override {
-            return mix([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+            return mix(stack([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+                return d.interval_complement_probability(open_lower_bound, closed_upper_bound);
+            }));
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> interval_complement_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return mix(stack("interval_complement_probability(double)", open_lower_bound, closed_upper_bound, [&open_lower_bound, &closed_upper_bound](const Distribution& d) {
                 return d.interval_complement_probability(open_lower_bound, closed_upper_bound);
-            });
+            }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_interval_probability(
             const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
             const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
         ) const override {
-            return log_mix([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+            return log_mix(stack([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+                return d.log_interval_probability(open_lower_bound, closed_upper_bound);
+            }));
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return log_mix(stack("log_interval_probability(double)", open_lower_bound, closed_upper_bound, [&open_lower_bound, &closed_upper_bound](const Distribution& d) {
                 return d.log_interval_probability(open_lower_bound, closed_upper_bound);
-            });
+            }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> log_interval_complement_probability(
             const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
             const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
         ) const override {
-            return log_mix([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+            return log_mix(stack([&open_lower_bound, &closed_upper_bound](const Distribution& d) {
                 return d.log_interval_complement_probability(open_lower_bound, closed_upper_bound);
-            });
+            }));
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_complement_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return log_mix(stack("log_interval_complement_probability(double)", open_lower_bound, closed_upper_bound, [&open_lower_bound, &closed_upper_bound](const Distribution& d) {
+                return d.log_interval_complement_probability(open_lower_bound, closed_upper_bound);
+            }));
         }
 
         torch::OrderedDict<std::string, torch::Tensor> draw(void) const override {
             auto structure = get_structure();
 
-            std::vector<torch::OrderedDict<std::string, torch::Tensor>> component_draws;
-            component_draws.reserve(components.size());
-            for (const auto& c : components) {
-                component_draws.emplace_back(c->draw());
+            torch::OrderedDict<std::string, torch::Tensor> mask; mask.reserve(structure.size());
+            for (const auto& item : structure) {
+                mask.insert(item.key(), torch::ones(item.value(), torch::kBool));
             }
 
-            torch::OrderedDict<std::string, torch::Tensor> output; output.reserve(structure.size());
-            for (const auto& item : structure) {
-                auto series_i = item.key();
-                const auto& structure_i = item.value();
+            auto output = draw_at(mask);
+            for (auto& item : output) {
+                item.value() = item.value().view(structure[item.key()]);
+            }
 
-                auto weights_expanded = weights.detach().clone();
-                for (int64_t i = 0; i != structure_i.size(); ++i) {
-                    weights_expanded.unsqueeze_(0);
-                }
-                auto expanded_size = structure_i;
-                expanded_size.emplace_back(weights.sizes().front());
-                weights_expanded = weights_expanded.expand(expanded_size);
+            return output;
+        }
 
-                auto multinomial_draw = torch::multinomial(weights_expanded, 1, true).squeeze();
+        // Each element draws its component from the alias table, and each
+        // component then draws only the elements that chose it, so that no
+        // more than the output is drawn or held at once.
+        torch::OrderedDict<std::string, torch::Tensor> draw_at(
+            const torch::OrderedDict<std::string, torch::Tensor>& mask
+        ) const override {
+            auto num_components = static_cast<int64_t>(components.size());
 
-                auto output_i = torch::full(structure_i, std::numeric_limits<double>::quiet_NaN(), torch::kDouble);
-                for (int64_t j = 0; j != components.size(); ++j) {
-                    auto multinomial_draw_eq_j = multinomial_draw.eq(j);
-                    output_i.index_put_({multinomial_draw_eq_j}, component_draws.at(j)[series_i].index({multinomial_draw_eq_j}));
-                }
+            torch::OrderedDict<std::string, torch::Tensor> labels; labels.reserve(mask.size());
+            torch::OrderedDict<std::string, torch::Tensor> output; output.reserve(mask.size());
+            for (const auto& item : mask) {
+                auto labels_i = draw_labels(item.value());
+                output.insert(item.key(), torch::empty({labels_i.numel()}, torch::kDouble));
+                labels.insert(item.key(), std::move(labels_i));
+            }
 
-                output.insert(std::move(series_i), std::move(output_i));
+            torch::OrderedDict<std::string, torch::Tensor> mask_j; mask_j.reserve(mask.size());
+            for (int64_t j = 0; j != num_components; ++j) {
+                for (const auto& item : mask) {
+                    const auto& mask_i = item.value();
+                    auto mask_i_j = mask_i.clone();
+                    mask_i_j.index_put_({mask_i}, labels[item.key()].eq(j));
+                    mask_j.insert(item.key(), std::move(mask_i_j));
+                }
+                auto draws_j = components.at(j)->draw_at(mask_j);
+                for (auto& item : output) {
+                    item.value().index_put_({labels[item.key()].eq(j)}, draws_j[item.key()]);
+                }
+                mask_j.clear();
             }
 
             return output;
@@ -183,107 +427,660 @@ class Mixture : public Distribution {
             return call_R_function("probabilistic:::cpp_Mixture_to_dist_mixture", args, protect_guard);
         }
 
-    private:
+    protected:
         std::vector<std::shared_ptr<Distribution>> components;
         torch::Tensor weights;
+        std::shared_ptr<MixtureComponentCache> cache;
 
-        template<class T>
-        torch::OrderedDict<std::string, torch::Tensor> mix(T&& op) const {
-            auto num_components = components.size();
+        // Vose's alias table for each row of the weights, built at the first
+        // draw: an element of row r choosing column c uniformly keeps c with
+        // probability alias_probability[r][c], and otherwise takes
+        // alias_index[r][c].
+        mutable torch::Tensor alias_probability;
+        mutable torch::Tensor alias_index;
 
-            std::vector<torch::OrderedDict<std::string, torch::Tensor>> component_op_values; component_op_values.reserve(num_components);
+        // The component of each element where mask_i is true, flattened.
+        // Any leading batch dimensions of the weights lead mask_i, as in mix.
+        torch::Tensor draw_labels(const torch::Tensor& mask_i) const {
+            if (!alias_probability.defined()) {
+                std::tie(alias_probability, alias_index) = alias_table(weights);
+            }
+
+            auto num_components = weights.size(-1);
+            auto num_draws = static_cast<torch::Tensor>(mask_i.sum()).item<int64_t>();
+
+            auto row = torch::zeros({num_draws}, torch::kLong);
+            auto row_ndim = weights.ndimension() - 1;
+            if (row_ndim > 0) {
+                auto row_sizes = weights.sizes().slice(0, row_ndim).vec();
+                auto num_rows = alias_probability.size(0);
+                while (static_cast<int64_t>(row_sizes.size()) < mask_i.ndimension()) {
+                    row_sizes.emplace_back(1);
+                }
+                row = torch::arange(num_rows, torch::kLong).view(row_sizes).expand(mask_i.sizes()).index({mask_i});
+            }
+
+            auto column = torch::randint(num_components, {num_draws}, torch::kLong);
+            auto cell = row*num_components + column;
+            auto keep = torch::rand({num_draws}, torch::kDouble).lt(alias_probability.take(cell));
+            return torch::where(keep, column, alias_index.take(cell));
+        }
+
+        // Evaluates op on each component, and concatenates the values
+        // for each series along a new, last, component dimension.
+        template<class T>
+        torch::OrderedDict<std::string, torch::Tensor> stack(T&& op) const {
+            std::vector<torch::OrderedDict<std::string, torch::Tensor>> component_op_values; component_op_values.reserve(components.size());
             for (const auto& c : components) {
                 component_op_values.emplace_back(op(*c));
             }
+            return concatenate(component_op_values);
+        }
 
+        // Concatenates the values of each component, for each series they
+        // share, along a new, last, component dimension.
+        static torch::OrderedDict<std::string, torch::Tensor> concatenate(
+            const std::vector<torch::OrderedDict<std::string, torch::Tensor>>& component_op_values
+        ) {
             auto shared_series = get_common_keys(component_op_values);
 
-            torch::OrderedDict<std::string, torch::Tensor> mixture_op_value; mixture_op_value.reserve(shared_series.size());
+            torch::OrderedDict<std::string, torch::Tensor> stacked_op_value; stacked_op_value.reserve(shared_series.size());
             {
-                std::vector<torch::Tensor> tensors; tensors.reserve(num_components);
+                std::vector<torch::Tensor> tensors; tensors.reserve(component_op_values.size());
                 for (auto series : shared_series) {
                     for (const auto& op_value : component_op_values) {
                         auto op_value_series = op_value[series];
-                        auto ndimension = op_value_series.ndimension();
-                        tensors.emplace_back(op_value_series.unsqueeze(ndimension).unsqueeze(ndimension+1));
+                        tensors.emplace_back(op_value_series.unsqueeze(op_value_series.ndimension()));
                     }
                     auto tensors_concatinated = torch::cat(tensors, tensors.front().ndimension()-1);
-                    auto mixture_op_value_series_unsqueezed = missing::handle_na(
-                        [](const torch::Tensor& tc, const torch::Tensor& w) {
-                            return torch::matmul(tc, w);
-                        },
-                        tensors_concatinated,
-                        weights
-                    );
-                    mixture_op_value.insert(
-                        std::move(series),
-                        mixture_op_value_series_unsqueezed.squeeze(mixture_op_value_series_unsqueezed.ndimension()-1)
-                    );
+                    stacked_op_value.insert(std::move(series), std::move(tensors_concatinated));
                     tensors.clear();
                 }
             }
 
-            return mixture_op_value;
+            return stacked_op_value;
         }
 
+        // As above, but read from the cache, if any, when the observations are those cached.
         template<class T>
-        torch::OrderedDict<std::string, torch::Tensor> log_mix(T&& log_op) const {
-            auto num_components = components.size();
-            auto log_weights = missing::handle_na([](const auto& w) { return w.log(); }, weights);
+        torch::OrderedDict<std::string, torch::Tensor> stack(
+            const char *op_name,
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            T&& op
+        ) const {
+            if (cache && cache->is_cached(observations)) {
+                return cache->stacked(op_name, [&]() { return stack(op); });
+            }
+            return stack(op);
+        }
 
-            std::vector<torch::OrderedDict<std::string, torch::Tensor>> component_log_op_values; component_log_op_values.reserve(num_components);
-            for (const auto& c : components) {
-                component_log_op_values.emplace_back(log_op(*c));
+        // As above, for ops whose arguments are scalar, so that the cached
+        // components determine the value.
+        template<class T>
+        torch::OrderedDict<std::string, torch::Tensor> stack(
+            const char *op_name,
+            double arg0,
+            double arg1,
+            T&& op
+        ) const {
+            if (cache) {
+                return cache->stacked(op_name, [&]() { return stack(op); }, arg0, arg1);
             }
+            return stack(op);
+        }
 
-            auto shared_series = get_common_keys(component_log_op_values);
+        // Weights stacked along leading dimensions, with a row for each batch
+        // of parameters, mix each batch of the stacked values by its own row.
+        missing::MaskedTensor mix(const missing::MaskedTensor& stacked_op_value) const {
+            return missing::matvec(stacked_op_value, missing::MaskedTensor(weights));
+        }
 
-            torch::OrderedDict<std::string, torch::Tensor> log_mixture_op_value; log_mixture_op_value.reserve(shared_series.size());
-            {
-                std::vector<torch::Tensor> tensors; tensors.reserve(num_components);
-                for (auto series : shared_series) {
-                    for (const auto& log_op_value : component_log_op_values) {
-                        auto log_op_value_series = log_op_value[series];
-                        auto ndimension = log_op_value_series.ndimension();
-                        tensors.emplace_back(log_op_value_series.unsqueeze(log_op_value_series.ndimension()));
+        torch::OrderedDict<std::string, torch::Tensor> mix(torch::OrderedDict<std::string, torch::Tensor> stacked_op_value) const {
+            for (auto& item : stacked_op_value) {
+                item.value() = mix(missing::MaskedTensor(item.value())).to_na();
+            }
+            return stacked_op_value;
+        }
+
+        missing::MaskedTensor log_mix(const missing::MaskedTensor& stacked_log_op_value) const {
+            auto log_weights = missing::elementwise(
+                [](const torch::Tensor& w) { return w.log(); },
+                missing::MaskedTensor(broadcast_weights(stacked_log_op_value.values().ndimension()))
+            );
+            return missing::reduce(
+                [](const torch::Tensor& x, int64_t dim) { return x.logsumexp({dim}); },
+                missing::elementwise(std::plus<torch::Tensor>(), stacked_log_op_value, log_weights),
+                -1
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_mix(torch::OrderedDict<std::string, torch::Tensor> stacked_log_op_value) const {
+            for (auto& item : stacked_log_op_value) {
+                item.value() = log_mix(missing::MaskedTensor(item.value())).to_na();
+            }
+            return stacked_log_op_value;
+        }
+
+        // The weights, with any leading batch dimensions kept leading when
+        // broadcast against a stacked value of ndimension dimensions.
+        torch::Tensor broadcast_weights(int64_t ndimension) const {
+            auto weights_out = weights;
+            if (weights_out.ndimension() > 1) {
+                while (weights_out.ndimension() < ndimension) {
+                    weights_out = weights_out.unsqueeze(-2);
+                }
+            }
+            return weights_out;
+        }
+};
+
+// A Mixture whose components are all Normal. Their means and standard
+// deviations are stacked along a last, component, dimension, so that each
+// evaluation is one broadcast kernel over every component followed by a
+// (log) weighted sum, rather than a call per component and a concatenation.
+// The quantile, draw and to_R_list are those of Mixture, the quantile
+// iterating with the kernels here, and draw gathering from the stacked
+// parameters. At the observations of a MixtureComponentCache, the values
+// are those of Mixture, which reads them from the cache.
+class MixtureOfNormals : public Mixture {
+    public:
+        MixtureOfNormals(
+            std::vector<std::shared_ptr<Distribution>> components_in,
+            torch::Tensor weights_in
+        ):
+            Mixture(std::move(components_in), std::move(weights_in)),
+            means(stack_normal_parameter(components, 0)),
+            std_devs(stack_normal_parameter(components, 1))
+        { }
+
+        // The means and standard deviations of cached components are stacked
+        // once, into the cache, for every mixture of them.
+        MixtureOfNormals(
+            const std::shared_ptr<MixtureComponentCache>& cache_in,
+            torch::Tensor weights_in
+        ):
+            Mixture(cache_in, std::move(weights_in)),
+            means(cache_in->stacked("normal means", [this]() { return stack_normal_parameter(components, 0); })),
+            std_devs(cache_in->stacked("normal std_devs", [this]() { return stack_normal_parameter(components, 1); }))
+        { }
+
+        torch::OrderedDict<std::string, torch::Tensor> density(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::density(observations);
+            }
+            return mix_normals(
+                [](const torch::Tensor& s, const torch::Tensor& z) {
+                    return (-0.5*(log_2_pi + z.square())).exp()/s;
+                },
+                observations
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> density(
+            double observations
+        ) const override {
+            return Distribution::density(observations);
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_density(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::log_density(observations);
+            }
+            return log_mix_normals(
+                [](const torch::Tensor& s, const torch::Tensor& z) {
+                    return -s.log() - 0.5*(log_2_pi + z.square());
+                },
+                observations
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_density(
+            double observations
+        ) const override {
+            return Distribution::log_density(observations);
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> cdf(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::cdf(observations);
+            }
+            return mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z) { return 0.5*torch::erfc(-inv_sqrt_2*z); },
+                observations
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_cdf(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::log_cdf(observations);
+            }
+            return log_mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z) { return standard_normal_log_cdf(z); },
+                observations
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> ccdf(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::ccdf(observations);
+            }
+            return mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z) { return 0.5*torch::erfc(inv_sqrt_2*z); },
+                observations
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_ccdf(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::log_ccdf(observations);
+            }
+            return log_mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z) { return standard_normal_log_cdf(-z); },
+                observations
+            );
+        }
+
+        // Each component probability is taken from whichever tail keeps the
+        // difference of cdfs away from cancellation, as in Distribution.
+        torch::OrderedDict<std::string, torch::Tensor> interval_probability(
+            const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
+            const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
+        ) const override {
+            return mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z_lb, const torch::Tensor& z_ub) {
+                    return torch::where(
+                        (z_lb + z_ub).le(0.0),
+                        0.5*(torch::erfc(-inv_sqrt_2*z_ub) - torch::erfc(-inv_sqrt_2*z_lb)),
+                        0.5*(torch::erfc(inv_sqrt_2*z_lb) - torch::erfc(inv_sqrt_2*z_ub))
+                    ).clamp_min(0.0);
+                },
+                open_lower_bound,
+                closed_upper_bound
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> interval_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return Distribution::interval_probability(open_lower_bound, closed_upper_bound);
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> interval_complement_probability(
+            const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
+            const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
+        ) const override {
+            return mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z_lb, const torch::Tensor& z_ub) {
+                    return (0.5*(torch::erfc(-inv_sqrt_2*z_lb) + torch::erfc(inv_sqrt_2*z_ub))).clamp_max(1.0);
+                },
+                open_lower_bound,
+                closed_upper_bound
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> interval_complement_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return Distribution::interval_complement_probability(open_lower_bound, closed_upper_bound);
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_probability(
+            const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
+            const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
+        ) const override {
+            return log_mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z_lb, const torch::Tensor& z_ub) {
+                    return standard_normal_log_interval_probability(z_lb, z_ub);
+                },
+                open_lower_bound,
+                closed_upper_bound
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return Distribution::log_interval_probability(open_lower_bound, closed_upper_bound);
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_complement_probability(
+            const torch::OrderedDict<std::string, torch::Tensor>& open_lower_bound,
+            const torch::OrderedDict<std::string, torch::Tensor>& closed_upper_bound
+        ) const override {
+            return log_mix_normals(
+                [](const torch::Tensor&, const torch::Tensor& z_lb, const torch::Tensor& z_ub) {
+                    return standard_normal_log_interval_complement_probability(z_lb, z_ub);
+                },
+                open_lower_bound,
+                closed_upper_bound
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> log_interval_complement_probability(
+            double open_lower_bound,
+            double closed_upper_bound
+        ) const override {
+            return Distribution::log_interval_complement_probability(open_lower_bound, closed_upper_bound);
+        }
+
+        // Each series is trimmed and studentised once, for every component
+        // and every quantity asked for.
+        DistributionEvaluation evaluate(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const DistributionEvaluationRequest& request
+        ) const override {
+            if (is_cached(observations)) {
+                return Mixture::evaluate(observations, request);
+            }
+
+            DistributionEvaluation out;
+            for (const auto& item : means) {
+                const auto& series = item.key();
+                const auto *observations_i = observations.find(series);
+                if (!observations_i) { continue; }
+
+                auto c = common(series, {*observations_i});
+                auto z = c.studentise(*observations_i);
+                if (request.log_density) {
+                    out.log_density.insert(series, log_mix(missing::elementwise(
+                        [](const torch::Tensor& s, const torch::Tensor& z) { return -s.log() - 0.5*(log_2_pi + z.square()); },
+                        c.std_dev,
+                        z
+                    )).to_na());
+                }
+                if (request.cdf) {
+                    out.cdf.insert(series, mix(missing::elementwise(
+                        [](const torch::Tensor& z) { return 0.5*torch::erfc(-inv_sqrt_2*z); },
+                        z
+                    )).to_na());
+                }
+                if (request.log_cdf) {
+                    out.log_cdf.insert(series, log_mix(missing::elementwise(
+                        [](const torch::Tensor& z) { return standard_normal_log_cdf(z); },
+                        z
+                    )).to_na());
+                }
+                if (request.log_ccdf) {
+                    out.log_ccdf.insert(series, log_mix(missing::elementwise(
+                        [](const torch::Tensor& z) { return standard_normal_log_cdf(-z); },
+                        z
+                    )).to_na());
+                }
+                if (request.log_interval_probability || request.log_interval_complement_probability) {
+                    auto z_lb = c.studentise(request.open_lower_bound);
+                    auto z_ub = c.studentise(request.closed_upper_bound);
+                    if (request.log_interval_probability) {
+                        out.log_interval_probability.insert(series, log_mix(missing::elementwise(
+                            standard_normal_log_interval_probability,
+                            z_lb,
+                            z_ub
+                        )).to_na());
+                    }
+                    if (request.log_interval_complement_probability) {
+                        out.log_interval_complement_probability.insert(series, log_mix(missing::elementwise(
+                            standard_normal_log_interval_complement_probability,
+                            z_lb,
+                            z_ub
+                        )).to_na());
                     }
-                    auto tensors_concatinated = torch::cat(tensors, tensors.front().ndimension()-1);
-                    log_mixture_op_value.insert(
-                        std::move(series),
-                        missing::handle_na(
-                            [](const torch::Tensor& tc, const torch::Tensor& lw) {
-                                return (lw + tc).logsumexp({tc.ndimension()-1});
-                            },
-                            tensors_concatinated,
-                            log_weights
-                        )
-                    );
-                    tensors.clear();
                 }
             }
+            return out;
+        }
 
-            return log_mixture_op_value;
+        // Draws a component for each element from the alias table, then
+        // gathers its mean and standard deviation for a single normal draw.
+        torch::OrderedDict<std::string, torch::Tensor> draw_at(
+            const torch::OrderedDict<std::string, torch::Tensor>& mask
+        ) const override {
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(mask.size());
+            for (const auto& item : mask) {
+                const auto& series = item.key();
+                const auto& mask_i = item.value();
+                auto component = draw_labels(mask_i).unsqueeze(-1);
+
+                auto mean_drawn = means[series].index({mask_i}).gather(-1, component).squeeze(-1);
+                auto std_dev_drawn = std_devs[series].index({mask_i}).gather(-1, component).squeeze(-1);
+                auto absent = missing::isna(mean_drawn).logical_or(missing::isna(std_dev_drawn));
+                out.insert(series, at::normal(mean_drawn.masked_fill(absent, 0.0), std_dev_drawn.masked_fill(absent, 1.0)).masked_fill(absent, missing::na));
+            }
+            return out;
+        }
+
+        torch::OrderedDict<std::string, std::vector<int64_t>> get_structure(void) const override {
+            torch::OrderedDict<std::string, std::vector<int64_t>> out; out.reserve(means.size());
+            for (const auto& item : means) {
+                auto sizes = item.value().sizes().vec();
+                sizes.pop_back();
+                out.insert(item.key(), std::move(sizes));
+            }
+            return out;
+        }
+
+    private:
+        torch::OrderedDict<std::string, torch::Tensor> means;
+        torch::OrderedDict<std::string, torch::Tensor> std_devs;
+
+        // The component values at the cached observations are stacked once,
+        // into the cache, by Mixture, so that mixing them again is a weighted
+        // sum only. Interval bounds are not the cached observations, so the
+        // interval probabilities keep to the kernels here.
+        bool is_cached(const torch::OrderedDict<std::string, torch::Tensor>& observations) const {
+            return cache && cache->is_cached(observations);
+        }
+
+        // The parameter at index j of the last dimension of each Normal
+        // component, stacked along a last, component, dimension, for the
+        // series the components share.
+        static torch::OrderedDict<std::string, torch::Tensor> stack_normal_parameter(
+            const std::vector<std::shared_ptr<Distribution>>& components,
+            int64_t j
+        ) {
+            std::vector<torch::OrderedDict<std::string, torch::Tensor>> parameters; parameters.reserve(components.size());
+            for (const auto& c : components) {
+                parameters.emplace_back(c->get());
+            }
+
+            auto shared_series = get_common_keys(parameters);
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(shared_series.size());
+            std::vector<torch::Tensor> parameter_i; parameter_i.reserve(components.size());
+            for (auto series : shared_series) {
+                for (const auto& parameters_c : parameters) {
+                    parameter_i.emplace_back(parameters_c[series].select(-1, j));
+                }
+                out.insert(std::move(series), torch::stack(parameter_i, -1));
+                parameter_i.clear();
+            }
+            return out;
+        }
+
+        static bool has_series(const std::string&) {
+            return true;
+        }
+
+        template<class... T>
+        static bool has_series(
+            const std::string& series,
+            const torch::OrderedDict<std::string, torch::Tensor>& x,
+            const T&... xs
+        ) {
+            return x.find(series) && has_series(series, xs...);
+        }
+
+        // The parameters of a series, trimmed to the sizes they share with
+        // its arguments, as for Normal, with the components stacked last.
+        struct Common {
+            std::vector<torch::indexing::TensorIndex> indices;
+            missing::MaskedTensor mean;
+            missing::MaskedTensor std_dev;
+
+            // The argument studentised by every component.
+            missing::MaskedTensor studentise(const torch::Tensor& x) const {
+                return missing::elementwise(
+                    [](const torch::Tensor& o, const torch::Tensor& m, const torch::Tensor& s) { return (o - m)/s; },
+                    missing::MaskedTensor(x.index(indices).unsqueeze(-1)),
+                    mean,
+                    std_dev
+                );
+            }
+
+            missing::MaskedTensor studentise(double x) const {
+                return missing::elementwise(
+                    [x](const torch::Tensor& m, const torch::Tensor& s) { return (x - m)/s; },
+                    mean,
+                    std_dev
+                );
+            }
+        };
+
+        Common common(const std::string& series, std::initializer_list<torch::Tensor> x) const {
+            const auto& mean_i = means[series];
+            const auto& std_dev_i = std_devs[series];
+
+            auto ndim = mean_i.ndimension() - 1;
+            auto common_sizes = mean_i.sizes().vec();
+            common_sizes.pop_back();
+            for (const auto& x_i : x) {
+                if (x_i.ndimension() != ndim) {
+                    std::ostringstream ss;
+                    ss << "x.ndimension() == " << x_i.ndimension() << " != " << ndim << " == mean.ndimension() - 1";
+                    throw std::logic_error(ss.str());
+                }
+                for (int64_t j = 0; j != ndim; ++j) {
+                    common_sizes.at(j) = std::min(common_sizes.at(j), x_i.size(j));
+                }
+            }
+
+            std::vector<torch::indexing::TensorIndex> indices; indices.reserve(ndim);
+            for (auto size : common_sizes) {
+                indices.emplace_back(torch::indexing::Slice(0, size));
+            }
+            missing::MaskedTensor mean_common(mean_i.index(indices));
+            missing::MaskedTensor std_dev_common(std_dev_i.index(indices));
+            return Common{std::move(indices), std::move(mean_common), std::move(std_dev_common)};
+        }
+
+        // Evaluates op(std_dev, z...) for each component at once, where each
+        // z is an argument studentised by every component.
+        template<class OP, class... T>
+        missing::MaskedTensor component_values(
+            const std::string& series,
+            OP&& op,
+            const T&... x
+        ) const {
+            auto c = common(series, {x[series]...});
+            return missing::elementwise(std::forward<OP>(op), c.std_dev, c.studentise(x[series])...);
+        }
+
+        template<class OP, class... T>
+        torch::OrderedDict<std::string, torch::Tensor> mix_normals(OP&& op, const T&... x) const {
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(means.size());
+            for (const auto& item : means) {
+                const auto& series = item.key();
+                if (!has_series(series, x...)) { continue; }
+                out.insert(series, mix(component_values(series, op, x...)).to_na());
+            }
+            return out;
+        }
+
+        template<class OP, class... T>
+        torch::OrderedDict<std::string, torch::Tensor> log_mix_normals(OP&& op, const T&... x) const {
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(means.size());
+            for (const auto& item : means) {
+                const auto& series = item.key();
+                if (!has_series(series, x...)) { continue; }
+                out.insert(series, log_mix(component_values(series, op, x...)).to_na());
+            }
+            return out;
         }
 };
 
-std::unique_ptr<Distribution> ManufactureMixture(
-    std::vector<std::shared_ptr<Distribution>> components,
-    torch::Tensor weights
-) {
-    if (weights.sizes().size() != 1) {
-        throw std::logic_error("weights.sizes().size() != 1");
+// Weights may be stacked along leading dimensions, see Mixture::mix.
+void check_mixture_weights(const torch::Tensor& weights, int64_t num_components) {
+    if (weights.sizes().size() < 1) {
+        throw std::logic_error("weights.sizes().size() < 1");
     }
 
-    if (weights.numel() != components.size()) {
-        throw std::logic_error("weights.numel() != components.size()");
+    if (weights.sizes().back() != num_components) {
+        throw std::logic_error("weights.sizes().back() != components.size()");
     }
 
     if (static_cast<torch::Tensor>(weights.le(0.0).any()).item<bool>()) {
         throw std::logic_error("weights.leq(0.0).any().item<bool>()");
     }
+}
 
-    weights = weights/weights.sum();
+std::unique_ptr<Distribution> ManufactureMixture(
+    std::vector<std::shared_ptr<Distribution>> components,
+    torch::Tensor weights
+) {
+    check_mixture_weights(weights, components.size());
+
+    weights = weights/weights.sum(-1, true);
 
     return std::make_unique<Mixture>(std::move(components), std::move(weights));
 }
 
+std::unique_ptr<Distribution> ManufactureMixture(
+    std::shared_ptr<MixtureComponentCache> cache,
+    torch::Tensor weights
+) {
+    check_mixture_weights(weights, cache->get_components().size());
+
+    weights = weights/weights.sum(-1, true);
+
+    return std::make_unique<Mixture>(std::move(cache), std::move(weights));
+}
+
+std::unique_ptr<Distribution> ManufactureMixtureOfNormals(
+    std::vector<std::shared_ptr<Distribution>> components,
+    torch::Tensor weights
+) {
+    check_mixture_weights(weights, components.size());
+
+    for (const auto& c : components) {
+        if (!is_normal(*c)) {
+            throw std::logic_error("ManufactureMixtureOfNormals: every component must be Normal.");
+        }
+    }
+
+    weights = weights/weights.sum(-1, true);
+
+    return std::make_unique<MixtureOfNormals>(std::move(components), std::move(weights));
+}
+
+std::unique_ptr<Distribution> ManufactureMixtureOfNormals(
+    std::shared_ptr<MixtureComponentCache> cache,
+    torch::Tensor weights
+) {
+    check_mixture_weights(weights, cache->get_components().size());
+
+    for (const auto& c : cache->get_components()) {
+        if (!is_normal(*c)) {
+            throw std::logic_error("ManufactureMixtureOfNormals: every component must be Normal.");
+        }
+    }
+
+    weights = weights/weights.sum(-1, true);
+
+    return std::make_unique<MixtureOfNormals>(cache, std::move(weights));
+}
+
+bool is_mixture_of_normals(const Distribution& distribution) {
+    return dynamic_cast<const MixtureOfNormals*>(&distribution) != nullptr;
+}
@@ -0,0 +1,64 @@
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <torch/torch.h>
+#include <libtorch_support/time_series.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/inference/bootstrap.hpp>
+#include <modelling/inference/MovingBlockBootstrap.hpp>
+
+#include <log/trivial.hpp>
+
+torch::Tensor moving_block_times(
+    int64_t num_replications,
+    int64_t sample_size,
+    int64_t block_size,
+    int64_t gap_size
+) {
+    // Each series is gathered once, for all resamples, by take_times, which
+    // fills the gaps with missing::na.
+    auto num_blocks = (sample_size + block_size - 1)/block_size;
+    auto times = torch::randint(sample_size - block_size + 1, {num_replications, num_blocks, 1}, torch::kLong)
+        + torch::arange(block_size, torch::kLong);
+    if (gap_size > 0) {
+        times = torch::cat({times, torch::full({num_replications, num_blocks, gap_size}, -1, torch::kLong)}, -1);
+    }
+    return times.reshape({num_replications, -1}).narrow(-1, 0, sample_size + (num_blocks - 1)*gap_size);
+}
+
+std::shared_ptr<SamplingDistribution> ManufactureMovingBlockBootstrap(
+    std::shared_ptr<ProbabilisticModule> fit,
+    int64_t num_replications,
+    int64_t block_size,
+    int64_t gap_size,
+    int64_t num_threads
+) {
+    auto& model = *fit;
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "Begin MovingBlockBootstrap estimation, with " << num_replications << " replications"
+                                      " of blocks of size " << block_size << ","
+                                      " of the sampling distribution for the parameter estimates of model \"" << model.name() << "\".";
+
+    const auto& observations = model.observations();
+    if (observations.is_empty()) {
+        throw std::logic_error("ManufactureMovingBlockBootstrap: the model was fit without observations.");
+    }
+    auto sample_size = observations[0].value().size(-1);
+    if (block_size < 1 || block_size > sample_size) {
+        std::ostringstream ss;
+        ss << "ManufactureMovingBlockBootstrap: block_size must be between 1 and the sample size, " << sample_size << ", but is " << block_size << ".";
+        throw std::invalid_argument(ss.str());
+    }
+    if (gap_size < 0) {
+        throw std::invalid_argument("ManufactureMovingBlockBootstrap: gap_size must be non-negative.");
+    }
+
+    auto times = moving_block_times(num_replications, sample_size, block_size, gap_size);
+    auto ret = bootstrap_refits(std::move(fit), take_times(observations, times), num_threads);
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "End MovingBlockBootstrap estimation.";
+
+    return ret;
+}
@@ -13,6 +13,7 @@
 #include <R_rng_guard.hpp>
 #include <R_support/function.hpp>
 #include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/indexing.hpp>
 #include <libtorch_support/standard_normal_log_cdf.hpp>
@@ -213,29 +214,15 @@ class Normal : public Distribution {
         ) const {
             return property_at_obs_dict(
                 [](const auto& obs, const auto& m, const auto& s) {
-                    auto obs_minus_mean_squared = missing::handle_na(
-                        [](const auto& lhs, const auto& rhs) {
-                            return (lhs - rhs).square();
+                    return missing::handle_na_elementwise(
+                        [](const torch::Tensor& o, const torch::Tensor& mean, const torch::Tensor& std) {
+                            auto studentised_obs_squared = (o - mean).square()/(std*std);
+                            return -std.log() - 0.5*(log_2_pi + studentised_obs_squared);
                         },
                         obs,
-                        m
-                    );
-
-                    auto studentised_obs_squared = missing::handle_na(
-                        [](const auto& lhs, const auto& rhs) {
-                            return lhs/(rhs*rhs);
-                        },
-                        obs_minus_mean_squared,
+                        m,
                         s
                     );
-
-                    return missing::handle_na(
-                        [](const auto& std, const auto& std_obs_sq) {
-                            return -std.log() - 0.5*(log_2_pi + std_obs_sq);
-                        },
-                        s,
-                        studentised_obs_squared
-                    );
                 },
                 observations
             );
@@ -313,20 +300,14 @@ class Normal : public Distribution {
                 const auto& obs_i = item.value();
                 auto common = get_common(obs_i, mean_i, std_dev_i);
 
-                auto studentised_observations = missing::handle_na(
+                out.insert(obs_i_name, missing::handle_na_elementwise(
                     [](const torch::Tensor& obs, const torch::Tensor& m, const torch::Tensor& s) {
-                        return (obs - m)/s;
+                        auto z = (obs - m)/s;
+                        return 0.5*torch::erfc(-inv_sqrt_2*z);
                     },
                     common.observations,
                     common.mean,
                     common.std_dev
-                );
-
-                out.insert(obs_i_name, missing::handle_na(
-                    [](const torch::Tensor& z) {
-                        return 0.5*torch::erfc(-inv_sqrt_2*z);
-                    },
-                    studentised_observations
                 ));
             }
             return out;
@@ -346,28 +327,15 @@ class Normal : public Distribution {
                 const auto& obs_i = item.value();
                 auto common = get_common(obs_i, mean_i, std_dev_i);
 
-                auto studentised_observations = missing::handle_na(
+                out.insert(obs_i_name, missing::handle_na_elementwise(
                     [](const torch::Tensor& obs, const torch::Tensor& m, const torch::Tensor& s) {
-                        return (obs - m)/s;
+                        auto z = (obs - m)/s;
+                        return standard_normal_log_cdf(z);
                     },
                     common.observations,
                     common.mean,
                     common.std_dev
-                );
-
-                try {
-                out.insert(obs_i_name, missing::handle_na(
-                    [](const torch::Tensor& z) {
-                        return standard_normal_log_cdf(z);
-                    },
-                    studentised_observations
                 ));
-                } catch(...) {
-                    const auto& z = studentised_observations;
-                    std::cout << z << " = z" << std::endl;
-                    std::cout << standard_normal_log_cdf(z) << " = standard_normal_log_cdf(z)" << std::endl;
-                    throw;
-                }
             }
             return out;
         }
@@ -386,20 +354,14 @@ class Normal : public Distribution {
                 const auto& obs_i = item.value();
                 auto common = get_common(obs_i, mean_i, std_dev_i);
 
-                auto studentised_observations = missing::handle_na(
+                out.insert(obs_i_name, missing::handle_na_elementwise(
                     [](const torch::Tensor& obs, const torch::Tensor& m, const torch::Tensor& s) {
-                        return (obs - m)/s;
+                        auto z = (obs - m)/s;
+                        return 0.5*torch::erfc(inv_sqrt_2*z);
                     },
                     common.observations,
                     common.mean,
                     common.std_dev
-                );
-
-                out.insert(obs_i_name, missing::handle_na(
-                    [](const torch::Tensor& z) {
-                        return 0.5*torch::erfc(inv_sqrt_2*z);
-                    },
-                    studentised_observations
                 ));
             }
             return out;
@@ -419,21 +381,89 @@ class Normal : public Distribution {
                 const auto& obs_i = item.value();
                 auto common = get_common(obs_i, mean_i, std_dev_i);
 
-                auto studentised_observations = missing::handle_na(
+                out.insert(obs_i_name, missing::handle_na_elementwise(
                     [](const torch::Tensor& obs, const torch::Tensor& m, const torch::Tensor& s) {
-                        return (obs - m)/s;
+                        auto z = (obs - m)/s;
+                        return standard_normal_log_cdf(-z);
                     },
                     common.observations,
                     common.mean,
                     common.std_dev
+                ));
+            }
+            return out;
+        }
+
+        // The observations are studentised, and their missingness found, once
+        // for all the quantities asked for. The interval probabilities are
+        // found at the parameters common with the observations.
+        DistributionEvaluation evaluate(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations,
+            const DistributionEvaluationRequest& request
+        ) const override {
+            auto lb = request.open_lower_bound;
+            auto ub = request.closed_upper_bound;
+
+            DistributionEvaluation out;
+            for (const auto& item : observations) {
+                const auto& obs_i_name = item.key();
+                const auto *mean_i_ptr = mean.find(obs_i_name);
+                if (!mean_i_ptr) { continue; }
+                const auto& std_dev_i = std_dev[obs_i_name];
+                auto common = get_common(item.value(), *mean_i_ptr, std_dev_i);
+
+                missing::MaskedTensor m(common.mean);
+                missing::MaskedTensor s(common.std_dev);
+                auto z = missing::elementwise(
+                    [](const torch::Tensor& obs, const torch::Tensor& m, const torch::Tensor& s) { return (obs - m)/s; },
+                    missing::MaskedTensor(common.observations),
+                    m,
+                    s
                 );
 
-                out.insert(obs_i_name, missing::handle_na(
-                    [](const torch::Tensor& z) {
-                        return standard_normal_log_cdf(-z);
-                    },
-                    studentised_observations
-                ));
+                if (request.log_density) {
+                    out.log_density.insert(obs_i_name, missing::elementwise(
+                        [](const torch::Tensor& z, const torch::Tensor& s) { return -s.log() - 0.5*(log_2_pi + z.square()); },
+                        z,
+                        s
+                    ).to_na());
+                }
+                if (request.cdf) {
+                    out.cdf.insert(obs_i_name, missing::elementwise(
+                        [](const torch::Tensor& z) { return 0.5*torch::erfc(-inv_sqrt_2*z); },
+                        z
+                    ).to_na());
+                }
+                if (request.log_cdf) {
+                    out.log_cdf.insert(obs_i_name, missing::elementwise(
+                        [](const torch::Tensor& z) { return standard_normal_log_cdf(z); },
+                        z
+                    ).to_na());
+                }
+                if (request.log_ccdf) {
+                    out.log_ccdf.insert(obs_i_name, missing::elementwise(
+                        [](const torch::Tensor& z) { return standard_normal_log_cdf(-z); },
+                        z
+                    ).to_na());
+                }
+                if (request.log_interval_probability || request.log_interval_complement_probability) {
+                    auto z_lb = missing::elementwise([lb](const torch::Tensor& m, const torch::Tensor& s) { return (lb - m)/s; }, m, s);
+                    auto z_ub = missing::elementwise([ub](const torch::Tensor& m, const torch::Tensor& s) { return (ub - m)/s; }, m, s);
+                    if (request.log_interval_probability) {
+                        out.log_interval_probability.insert(obs_i_name, missing::elementwise(
+                            standard_normal_log_interval_probability,
+                            z_lb,
+                            z_ub
+                        ).to_na());
+                    }
+                    if (request.log_interval_complement_probability) {
+                        out.log_interval_complement_probability.insert(obs_i_name, missing::elementwise(
+                            standard_normal_log_interval_complement_probability,
+                            z_lb,
+                            z_ub
+                        ).to_na());
+                    }
+                }
             }
             return out;
         }
@@ -452,7 +482,7 @@ class Normal : public Distribution {
                 const auto& probs_i = item.value();
                 auto common = get_common(probs_i, mean_i, std_dev_i);
 
-                out.insert(probs_i_name, missing::handle_na(
+                out.insert(probs_i_name, missing::handle_na_elementwise(
                     [](const torch::Tensor& probs, const torch::Tensor& m, const torch::Tensor& s) {
                         return m + sqrt_2*s*torch::erfinv(2*probs-1);
                     },
@@ -475,6 +505,18 @@ class Normal : public Distribution {
             return out;
         }
 
+        torch::OrderedDict<std::string, torch::Tensor> draw_at(
+            const torch::OrderedDict<std::string, torch::Tensor>& mask
+        ) const override {
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(mask.size());
+            for (const auto& item : mask) {
+                const auto& name = item.key();
+                const auto& mask_i = item.value();
+                out.insert(name, at::normal(mean[name].index({mask_i}), std_dev[name].index({mask_i})));
+            }
+            return out;
+        }
+
         torch::OrderedDict<std::string, torch::Tensor> get(void) const override {
             torch::OrderedDict<std::string, torch::Tensor> ret;
             auto mean_size = mean.size();
@@ -528,3 +570,7 @@ std::unique_ptr<Distribution> ManufactureNormal(const torch::OrderedDict<std::st
     return std::make_unique<Normal>(tensors);
 }
 
+
+bool is_normal(const Distribution& distribution) {
+    return dynamic_cast<const Normal*>(&distribution) != nullptr;
+}
@@ -1,5 +1,6 @@
 #include <memory>
 #include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -23,24 +24,42 @@ class NormalVector : public Distribution {
             indices(std::move(indices_in))
         { }
 
+        // One row for each draw, for each index.
         torch::OrderedDict<std::string, torch::Tensor> generate(
             int64_t sample_size,
             int64_t burn_in_size,
             double first_draw
-        ) const {
+        ) const override {
             // Since we can draw from the multivariate normal (almost) directly,
             // we can disregard burn_in_size and first_draw.
-            // We need to change this to respect the sample_size argument.
-            auto Z = torch::normal(0.0, 1.0, mu.sizes(), c10::nullopt, torch::kDouble);
-            auto X = torch::matmul(A, Z) + mu;
-            torch::OrderedDict<std::string, torch::Tensor> out;
+            return generate_from_standard_normal(
+                torch::normal(0.0, 1.0, {sample_size, mu.size(0)}, c10::nullopt, torch::kDouble)
+            );
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> generate_from_standard_normal(
+            const torch::Tensor& standard_normal_draws
+        ) const override {
+            if (standard_normal_draws.ndimension() != 2 || standard_normal_draws.size(1) != mu.size(0)) {
+                std::ostringstream ss;
+                ss << "NormalVector: expected standard normal draws with " << mu.size(0)
+                   << " columns, but got draws of sizes " << standard_normal_draws.sizes() << '.';
+                throw std::logic_error(ss.str());
+            }
+            // X = mu + A Z, for all the draws at once, as rows.
+            auto X = torch::addmm(mu, standard_normal_draws, A.t());
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(indices.size());
             for (const auto& item : indices) {
-                out.insert(item.key(), X.index(item.value()));
+                out.insert(item.key(), X.index({torch::indexing::Slice(), item.value()}));
             }
 
             return out;
         }
 
+        int64_t standard_normal_dimension(void) const override {
+            return A.size(1);
+        }
+
     private:
         torch::Tensor mu;
         torch::Tensor A;
@@ -0,0 +1,64 @@
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <torch/torch.h>
+#include <modelling/inference/ParameterDraws.hpp>
+
+ParameterDraws::ParameterDraws(
+    const ProbabilisticModule& fit,
+    CollapsedTensor<std::string> draws_in
+):
+    draws(std::move(draws_in)),
+    working_module(fit.clone_probabilistic_module())
+{
+    auto parameters = working_module->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
+    working_parameters.reserve(draws.indices.size());
+    for (const auto& item : draws.indices) {
+        const auto *parameter = parameters.find(item.key());
+        if (!parameter) {
+            std::ostringstream ss;
+            ss << "ParameterDraws: the fit has no parameter \"" << item.key() << "\".";
+            throw std::logic_error(ss.str());
+        }
+        working_parameters.emplace_back(*parameter, item.value());
+    }
+}
+
+ProbabilisticModule& ParameterDraws::module(int64_t draw) {
+    if (draw != working_draw) {
+        torch::NoGradGuard no_grad;
+        auto row = draws.tensor[draw];
+        for (auto& item : working_parameters) {
+            auto& parameter = item.first;
+            parameter.copy_(row.index({item.second}).reshape(parameter.sizes()));
+        }
+        working_draw = draw;
+    }
+    return *working_module;
+}
+
+torch::Tensor ParameterDraws::average_scores(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    const ScoringRule& scoring_rule,
+    double barrier_multiplier
+) {
+    torch::NoGradGuard no_grad;
+
+    // A module whose parameters each gain a leading dimension, with a row per
+    // draw, and observations broadcast along it.
+    auto batch_module = working_module->clone_batch(draws);
+    auto batch_observations = broadcast_batch(observations, size());
+    auto scores = batch_module->fused_average_scores(batch_observations, scoring_rule, barrier_multiplier);
+    if (scores.defined()) {
+        return scores;
+    }
+
+    auto forecasts = batch_module->forward(batch_observations);
+    return scoring_rule.averages(scoring_rule.score(
+        *forecasts,
+        batch_observations,
+        batch_module->barrier(batch_observations, barrier_multiplier)
+    ));
+}
@@ -0,0 +1,43 @@
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <torch/torch.h>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/inference/bootstrap.hpp>
+#include <modelling/inference/ParametricBootstrap.hpp>
+
+#include <log/trivial.hpp>
+
+std::shared_ptr<SamplingDistribution> ManufactureParametricBootstrap(
+    std::shared_ptr<ProbabilisticModule> fit,
+    int64_t num_replications,
+    int64_t burn_in_size,
+    double first_draw,
+    int64_t num_threads
+) {
+    auto& model = *fit;
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "Begin ParametricBootstrap estimation, with " << num_replications << " replications,"
+                                      " of the sampling distribution for the parameter estimates of model \"" << model.name() << "\".";
+
+    const auto& observations = model.observations();
+    if (observations.is_empty()) {
+        throw std::logic_error("ManufactureParametricBootstrap: the model was fit without observations.");
+    }
+    auto sample_size = observations[0].value().size(-1);
+
+    auto replicate_observations = model.draw_replicate_observations(
+        num_replications,
+        sample_size,
+        burn_in_size,
+        first_draw,
+        num_threads
+    );
+
+    auto ret = bootstrap_refits(std::move(fit), replicate_observations, num_threads);
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "End ParametricBootstrap estimation.";
+
+    return ret;
+}
@@ -1,11 +1,18 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 #include <torch/torch.h>
 #include <libtorch_support/derivatives.hpp>
+#include <libtorch_support/parallel.hpp>
+#include <modelling/missingness_index.hpp>
 #include <modelling/sample_size.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/score/ScoringRule.hpp>
@@ -14,6 +21,35 @@
 
 #include <log/trivial.hpp>
 
+torch::OrderedDict<std::string, torch::Tensor> ProbabilisticModule::draw_replicate_observations(
+    int64_t num_paths,
+    int64_t sample_size,
+    int64_t burn_in_size,
+    double first_draw,
+    int64_t num_threads
+) const {
+    std::vector<torch::OrderedDict<std::string, torch::Tensor>> paths;
+    paths.reserve(num_paths);
+    for (int64_t i = 0; i != num_paths; ++i) {
+        paths.emplace_back(draw_observations(sample_size, burn_in_size, first_draw));
+    }
+
+    torch::OrderedDict<std::string, torch::Tensor> out;
+    if (paths.empty()) {
+        return out;
+    }
+    out.reserve(paths.front().size());
+    for (const auto& key : paths.front().keys()) {
+        std::vector<torch::Tensor> path_values;
+        path_values.reserve(num_paths);
+        for (const auto& path : paths) {
+            path_values.emplace_back(path[key]);
+        }
+        out.insert(key, torch::stack(path_values));
+    }
+    return out;
+}
+
 torch::OrderedDict<std::string, torch::Tensor> ProbabilisticModule::grad(bool recurse) const {
     auto params = named_parameters(recurse);
     for (auto& p : params) {
@@ -38,11 +74,22 @@ bool ProbabilisticModule::fit(
         observations,
         std::move(scoring_rule),
         plan,
-        parameters(),
+        parameters_to_optimise(),
         diagnostics
     );
 }
 
+std::vector<torch::Tensor> ProbabilisticModule::parameters_to_optimise(void) {
+    auto candidates = parameters(/*recurse=*/true, /*include_fixed=*/false);
+    std::vector<torch::Tensor> out; out.reserve(candidates.size());
+    for (auto& p : candidates) {
+        if (p.requires_grad() && p.numel()) {
+            out.emplace_back(std::move(p));
+        }
+    }
+    return out;
+}
+
 torch::OrderedDict<std::string, torch::OrderedDict<std::string, std::vector<std::vector<torch::indexing::TensorIndex>>>> ProbabilisticModule::observations_by_parameter(
     const torch::OrderedDict<std::string, torch::Tensor>& observations,
     bool recursive,
@@ -84,6 +131,10 @@ torch::OrderedDict<std::string, torch::OrderedDict<std::string, torch::Tensor>>
 std::shared_ptr<ProbabilisticModule> ProbabilisticModule::draw_stochastic_process(const Distribution& parameter_estimate_distribution) const {
     auto model_clone = clone_probabilistic_module();
     auto p = parameter_estimate_distribution.generate(1, 0, 0.0);
+    for (auto& item : p) {
+        auto& p_i = item.value();
+        p_i = p_i[0];
+    }
     model_clone->set_parameters(p);
     return model_clone;
 }
@@ -93,6 +144,8 @@ std::shared_ptr<ProbabilisticModule> ProbabilisticModule::clone_probabilistic_mo
     cloned->observations_last_fit = observations_last_fit;
     cloned->scoring_rule_last_fit = scoring_rule_last_fit;
     cloned->barrier_multiplier_last_fit = barrier_multiplier_last_fit;
+    cloned->fit_plan_last_fit = fit_plan_last_fit;
+    cloned->scores_missingness_last_fit = scores_missingness_last_fit;
     return cloned;
 }
 
@@ -103,15 +156,23 @@ bool ProbabilisticModule::fit(
     std::vector<torch::Tensor> parameters_to_optimise,
     FitDiagnostics *diagnostics
 ) {
-    // Calculating the sample_size is expensive because of missing values.
-    // Find the sample_size on the first run of the score_closure, then
-    // reuse it for the remainder of the optimisation.
-    int64_t sample_size = -1;
+    // Finding where the scores are missing is expensive. Find it on the first
+    // run of the score_closure, then reuse it for the remainder of the
+    // optimisation, since the observations do not change.
+    std::shared_ptr<const MissingnessIndex> scores_missingness;
+    bool try_fused = true;
     auto ret = fit(
         observations,
         plan,
         std::move(parameters_to_optimise),
-        [this, &observations, &scoring_rule, &sample_size] (double barrier_multiplier) {
+        [this, &observations, &scoring_rule, &scores_missingness, &try_fused] (double barrier_multiplier) {
+            if (try_fused) {
+                auto fused = fused_average_score(observations, *scoring_rule, barrier_multiplier);
+                if (fused.defined()) {
+                    return fused;
+                }
+                try_fused = false;
+            }
             auto forecasts = [&]() {
                 try {
                     return forward(observations);
@@ -120,27 +181,21 @@ bool ProbabilisticModule::fit(
                     throw;
                 }
             }();
-            if (sample_size >= 0) {
-                return scoring_rule->average(
-                    *forecasts,
-                    observations,
-                    barrier(observations, barrier_multiplier),
-                    sample_size
-                );
-            } else {
-                auto scores = scoring_rule->score(
-                    *forecasts,
-                    observations,
-                    barrier(observations, barrier_multiplier)
-                );
-                sample_size = get_sample_size(scores);
-                return scoring_rule->average(scores);
+            auto scores = scoring_rule->score(
+                *forecasts,
+                observations,
+                barrier(observations, barrier_multiplier)
+            );
+            if (!scores_missingness) {
+                scores_missingness = std::make_shared<const MissingnessIndex>(scores);
             }
+            return scoring_rule->average(scores, *scores_missingness);
         },
         scoring_rule->name(),
         diagnostics
     );
     scoring_rule_last_fit = std::move(scoring_rule);
+    scores_missingness_last_fit = std::move(scores_missingness);
 
     return ret;
 }
@@ -230,9 +285,310 @@ bool ProbabilisticModule::fit(
     if (diagnostics) diagnostics->seconds = seconds_since_start;
 
     observations_last_fit = observations;
+    scores_missingness_last_fit = nullptr;
     barrier_multiplier_last_fit = barrier_multiplier;
     fit_plan_last_fit = plan;
 
     return success;
 }
 
+
+bool ProbabilisticModule::update_fit(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t num_newton_steps
+) {
+    if (!scoring_rule_last_fit) {
+        throw std::logic_error("ProbabilisticModule::update_fit called, but the module has not been fit before.");
+    }
+    const auto& scoring_rule = *scoring_rule_last_fit;
+    auto barrier_multiplier = barrier_multiplier_last_fit;
+    auto average_score = [&]() {
+        return scoring_rule.average(*forward(observations), observations, barrier(observations, barrier_multiplier));
+    };
+
+    auto parameters_to_update = parameters_to_optimise();
+    std::vector<torch::Tensor> parameters_before; parameters_before.reserve(parameters_to_update.size());
+    for (const auto& p : parameters_to_update) {
+        parameters_before.emplace_back(p.detach().clone());
+    }
+    auto restore = [&]() {
+        torch::NoGradGuard no_grad;
+        for (decltype(parameters_to_update.size()) i = 0; i != parameters_to_update.size(); ++i) {
+            parameters_to_update.at(i).set_data(parameters_before.at(i));
+        }
+        return false;
+    };
+
+    for (int64_t step = 0; step != num_newton_steps; ++step) {
+        auto score = average_score();
+        std::vector<torch::Tensor> gradients;
+        auto hess_blocks = hessian(score, parameters_to_update, &gradients, /*allow_unused=*/true, /*na_hess=*/0.0);
+
+        std::vector<torch::Tensor> hess_rows; hess_rows.reserve(hess_blocks.size());
+        for (decltype(hess_blocks.size()) i = 0; i != hess_blocks.size(); ++i) {
+            std::vector<torch::Tensor> hess_row; hess_row.reserve(hess_blocks.size());
+            for (decltype(hess_blocks.size()) j = 0; j != hess_blocks.size(); ++j) {
+                hess_row.emplace_back(hess_blocks[i][j].reshape({parameters_to_update.at(i).numel(), parameters_to_update.at(j).numel()}));
+            }
+            hess_rows.emplace_back(torch::cat(hess_row, 1));
+            gradients.at(i) = gradients.at(i).reshape({-1, 1});
+        }
+        auto hess = torch::cat(hess_rows, 0).to(torch::kDouble);
+        auto gradient = torch::cat(gradients, 0).to(torch::kDouble);
+        if (!static_cast<torch::Tensor>(hess.isfinite().all().logical_and(gradient.isfinite().all())).item<bool>()) {
+            return restore();
+        }
+
+        // The score is maximised, so -hess must be positive definite, once the
+        // coordinates the score does not depend on, which would make it
+        // singular, are left out. Those coordinates do not move.
+        auto used = hess.ne(0.0).any(1).logical_or(gradient.ne(0.0).any(1)).nonzero().select(1, 0);
+        auto newton_step = torch::zeros_like(gradient);
+        try {
+            auto used_hess = hess.index({used}).index({torch::indexing::Slice(), used});
+            newton_step.index_put_({used}, torch::cholesky_solve(gradient.index({used}), torch::cholesky(-used_hess)));
+        } catch (const std::exception&) {
+            return restore();
+        }
+
+        torch::NoGradGuard no_grad;
+        int64_t begin = 0;
+        for (auto& p : parameters_to_update) {
+            auto end = begin + p.numel();
+            p.set_data(p.detach() + newton_step.index({torch::indexing::Slice(begin, end)}).reshape(p.sizes()).to(p.dtype()));
+            begin = end;
+        }
+        // Near the optimum a step may lose a little to rounding.
+        auto score_before_step = score.item<double>();
+        auto slack = fit_plan_last_fit.tolerance_change + 1e-10*std::max(1.0, std::abs(score_before_step));
+        if (!(average_score().item<double>() >= score_before_step - slack)) {
+            return restore();
+        }
+    }
+
+    observations_last_fit = observations;
+    scores_missingness_last_fit = nullptr;
+
+    return true;
+}
+
+static torch::OrderedDict<std::string, torch::Tensor> select_replication(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t replication
+) {
+    torch::OrderedDict<std::string, torch::Tensor> out;
+    out.reserve(observations.size());
+    for (const auto& item : observations) {
+        out.insert(item.key(), item.value().select(0, replication));
+    }
+    return out;
+}
+
+std::shared_ptr<ProbabilisticModule> ProbabilisticModule::clone_batch(const CollapsedTensor<std::string>& parameters) const {
+    auto batch_size = parameters.tensor.size(0);
+    auto batch_module = clone_probabilistic_module();
+    auto batch_parameters = batch_module->named_parameters(/*recurse=*/true, /*include_fixed=*/true);
+    torch::NoGradGuard no_grad;
+    for (auto& item : batch_parameters) {
+        auto& p = item.value();
+        const auto *index = parameters.indices.find(item.key());
+        if (index) {
+            std::vector<int64_t> batch_sizes{batch_size};
+            batch_sizes.insert(batch_sizes.end(), p.sizes().begin(), p.sizes().end());
+            p.set_data(parameters.tensor.index({torch::indexing::Slice(), *index}).reshape(batch_sizes).to(p.dtype()).clone());
+        } else {
+            std::vector<int64_t> repeats(p.dim() + 1, 1);
+            repeats.front() = batch_size;
+            p.set_data(p.detach().unsqueeze(0).repeat(repeats));
+        }
+    }
+    return batch_module;
+}
+
+std::unique_ptr<Distribution> ProbabilisticModule::forward_batch(
+    const CollapsedTensor<std::string>& parameters,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    bool batched_observations
+) const {
+    auto batch_module = clone_batch(parameters);
+    if (batched_observations) {
+        return batch_module->forward(observations);
+    }
+    return batch_module->forward(broadcast_batch(observations, parameters.tensor.size(0)));
+}
+
+torch::OrderedDict<std::string, torch::Tensor> broadcast_batch(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t batch_size
+) {
+    torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(observations.size());
+    for (const auto& item : observations) {
+        const auto& x = item.value();
+        std::vector<int64_t> batch_sizes{batch_size};
+        batch_sizes.insert(batch_sizes.end(), x.sizes().begin(), x.sizes().end());
+        out.insert(item.key(), x.unsqueeze(0).expand(batch_sizes));
+    }
+    return out;
+}
+
+std::vector<std::shared_ptr<ProbabilisticModule>> ProbabilisticModule::fit_replications(
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    std::shared_ptr<const ScoringRule> scoring_rule,
+    const FitPlan& plan,
+    std::vector<char> *success,
+    int64_t num_threads
+) const {
+    if (observations.is_empty()) {
+        throw std::logic_error("ProbabilisticModule::fit_replications called without observations.");
+    }
+    const auto& first_observations = observations[0].value();
+    auto num_replications = first_observations.ndimension() ? first_observations.size(0) : 0;
+    for (const auto& item : observations) {
+        if (!item.value().ndimension() || item.value().size(0) != num_replications) {
+            std::ostringstream ss;
+            ss << "ProbabilisticModule::fit_replications: observations \"" << item.key() << "\" do not share the leading replication dimension, of size " << num_replications << ".";
+            throw std::logic_error(ss.str());
+        }
+    }
+
+    std::vector<std::shared_ptr<ProbabilisticModule>> fit_models;
+    fit_models.reserve(num_replications);
+    std::vector<char> success_each(num_replications, false);
+
+    // One clone of the module whose parameters each gain a leading dimension,
+    // with a row per replication, all starting from this module's parameters.
+    // Every parameter is stacked, so that kernels see them all alike, but only
+    // those that fit optimises are optimised.
+    auto stacked_module = clone_probabilistic_module();
+    auto stacked_parameters = stacked_module->parameters();
+    {
+        torch::NoGradGuard no_grad;
+        for (auto& p : stacked_parameters) {
+            std::vector<int64_t> repeats(p.dim() + 1, 1);
+            repeats.front() = num_replications;
+            p.set_data(p.detach().unsqueeze(0).repeat(repeats));
+        }
+    }
+    auto stacked_parameters_to_optimise = stacked_module->parameters_to_optimise();
+
+    auto model_name = name();
+    auto score_name = scoring_rule->name();
+    auto barrier_multiplier = plan.barrier_begin;
+    auto scores_after_step = [&]() {
+        torch::NoGradGuard no_grad;
+        return stacked_module->fused_average_scores(observations, *scoring_rule, barrier_multiplier);
+    };
+
+    if (!scores_after_step().defined()) {
+        PROBABILISTIC_LOG_TRIVIAL_INFO << "Model \"" << model_name << "\" has no kernel for stacked parameters with score \"" << score_name << "\","
+                                          " so fitting " << num_replications << " replications separately, on " << std::max<int64_t>(num_threads, 1) << " threads.";
+        // Clone on this thread, so that the workers share nothing but the observations.
+        for (int64_t r = 0; r != num_replications; ++r) {
+            fit_models.emplace_back(clone_probabilistic_module());
+        }
+        parallel_for(num_replications, num_threads, 0, [&](int64_t r) {
+            success_each.at(r) = fit_models.at(r)->fit(select_replication(observations, r), scoring_rule, plan, nullptr);
+        });
+        if (success) *success = std::move(success_each);
+        return fit_models;
+    }
+
+    // Replications are independent, so the gradient of the sum of their scores
+    // is, row by row, the gradient of each score. Rows of replications whose
+    // scores have converged, changing by no more than tolerance_change, or by
+    // rounding, over an iteration, are masked out of the sum. The rows share
+    // one line search, so no row stops moving exactly until they all do. Rebuilding the optimiser when
+    // the mask changes drops curvature pairs that would still move those rows.
+    auto active = torch::ones({num_replications}, torch::kBool);
+    std::unique_ptr<torch::optim::LBFGS> optimiser;
+    auto reset_optimiser = [&]() {
+        torch::optim::LBFGSOptions lbfgs_options(plan.learning_rate);
+        lbfgs_options.line_search_fn("strong_wolfe");
+        lbfgs_options.tolerance_grad(plan.tolerance_grad);
+        lbfgs_options.tolerance_change(plan.tolerance_change);
+        optimiser = std::make_unique<torch::optim::LBFGS>(stacked_parameters_to_optimise, std::move(lbfgs_options));
+    };
+    reset_optimiser();
+    torch::optim::Optimizer::LossClosure loss_closure = [&]() {
+        optimiser->zero_grad();
+        auto scores = stacked_module->fused_average_scores(observations, *scoring_rule, barrier_multiplier);
+        auto loss = -scores.masked_fill(active.logical_not(), 0.0).sum();
+        loss.backward();
+        return loss;
+    };
+
+    PROBABILISTIC_LOG_TRIVIAL_INFO << "Begin optimisation of " << num_replications << " replications of model \"" << model_name << "\".";
+    auto t_start = std::chrono::high_resolution_clock::now();
+    int64_t seconds_since_start = 0;
+    int64_t num_prints = 0;
+    try {
+        optimiser->step(loss_closure);
+        optimiser->step(loss_closure);
+        auto scores = scores_after_step();
+        int64_t optimiser_iterations_completed = 2;
+        while (true) {
+            auto scores_prev = scores;
+            barrier_multiplier = std::max(plan.barrier_decay*barrier_multiplier, plan.barrier_end);
+            optimiser->step(loss_closure);
+            scores = scores_after_step();
+            optimiser_iterations_completed += 1;
+            auto t_end = std::chrono::high_resolution_clock::now();
+            seconds_since_start = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+
+            auto tolerance = plan.tolerance_change + 4.0*std::numeric_limits<double>::epsilon()*scores_prev.abs().clamp_min(1.0);
+            auto converged = active.logical_and((scores - scores_prev).abs().le(tolerance));
+            if (converged.any().item<bool>()) {
+                active = active.logical_and(converged.logical_not());
+                reset_optimiser();
+            }
+            auto num_active = active.sum().item<int64_t>();
+            if (num_active == 0) {
+                PROBABILISTIC_LOG_TRIVIAL_INFO << "Optimisation of " << num_replications << " replications of model \"" << model_name << "\""
+                                                  " converged with mean score \"" << score_name << "\" of " << scores.mean().item<double>() << ","
+                                                  " including a barrier with multiplier " << barrier_multiplier << ","
+                                                  " after " << optimiser_iterations_completed << " iterations"
+                                                  " and " << seconds_since_start << " seconds.";
+                break;
+            }
+            if (seconds_since_start >= plan.timeout_in_seconds || optimiser_iterations_completed >= plan.maximum_optimiser_iterations) {
+                PROBABILISTIC_LOG_TRIVIAL_WARNING << "Optimisation of " << num_active << " of " << num_replications << " replications of model \"" << model_name << "\""
+                                                     " timed out, with a barrier with multiplier " << barrier_multiplier << ","
+                                                     " after " << optimiser_iterations_completed << " iterations"
+                                                     " and " << seconds_since_start << " seconds.";
+                break;
+            }
+            if (seconds_since_start >= 10*num_prints) {
+                PROBABILISTIC_LOG_TRIVIAL_INFO << num_active << " of " << num_replications << " replications are still being optimised"
+                                                  " after " << optimiser_iterations_completed << " iterations"
+                                                  " and " << seconds_since_start << " seconds.";
+                ++num_prints;
+            }
+        }
+    } catch (const std::exception& e) {
+        PROBABILISTIC_LOG_TRIVIAL_WARNING << "Optimisation of " << num_replications << " replications of model \"" << model_name << "\""
+                                             " failed with C++ exception \"" << e.what() << "\".";
+    } catch (...) {
+        PROBABILISTIC_LOG_TRIVIAL_WARNING << "Optimisation of " << num_replications << " replications of model \"" << model_name << "\""
+                                             " failed with unknown C++ exception.";
+    }
+
+    // Replications that converged before any failure were frozen, so keep them.
+    torch::NoGradGuard no_grad;
+    auto active_accessor = active.accessor<bool, 1>();
+    for (int64_t r = 0; r != num_replications; ++r) {
+        auto model_r = clone_probabilistic_module();
+        auto parameters_r = model_r->parameters();
+        for (size_t i = 0; i != parameters_r.size(); ++i) {
+            parameters_r.at(i).set_data(stacked_parameters.at(i).detach().select(0, r).clone());
+        }
+        model_r->observations_last_fit = select_replication(observations, r);
+        model_r->scoring_rule_last_fit = scoring_rule;
+        model_r->barrier_multiplier_last_fit = barrier_multiplier;
+        model_r->fit_plan_last_fit = plan;
+        success_each.at(r) = !active_accessor[r];
+        fit_models.emplace_back(std::move(model_r));
+    }
+    if (success) *success = std::move(success_each);
+
+    return fit_models;
+}
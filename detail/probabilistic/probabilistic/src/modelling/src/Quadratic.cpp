@@ -1,12 +1,35 @@
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 #include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/distribution/Quadratic.hpp>
 
+constexpr double inv_sqrt_2 = 0.7071067811865475244008443621048490392848359376884740365883398689;
+constexpr double inv_sqrt_2_pi = 0.3989422804014326779399460599343818684758586311649346576659258296;
+
+// The coefficients are collapsed into a vector and a matrix over the
+// parameters, so that the draws are evaluated together, as rows of a matrix,
+// with two matrix products.
+//
+// If dist is Gaussian, given as a transformation of standard normal draws,
+// X = m + L Z, the quadratic form is, in the eigenbasis W = P'Z of
+// L'QL = P diag(lambda) P', with Q the symmetric part of the quadratic
+// coefficients,
+//     Y = k + sum_j (v_j W_j + lambda_j W_j^2),
+// whose cumulant generating function
+//     K(s) = s k + sum_j (-log(1 - 2 s lambda_j)/2 + s^2 v_j^2/(2 (1 - 2 s lambda_j)))
+// gives the cumulants in closed form, and the cdf and quantiles through the
+// Lugannani-Rice saddlepoint approximation, each in O(p) once the O(p^3)
+// eigendecomposition is done. The sums of powers of lambda are the traces of
+// the powers of Q Sigma, with Sigma = L L'.
 class Quadratic : public Distribution {
     public:
         Quadratic(
@@ -21,41 +44,352 @@ class Quadratic : public Distribution {
             intercept(intercept_in),
             linear_coefficients(std::move(linear_coefficients_in)),
             quadratic_coefficients(std::move(quadratic_coefficients_in))
-        { }
+        {
+            collapse_coefficients();
+        }
 
         torch::OrderedDict<std::string, torch::Tensor> generate(
             int64_t sample_size,
             int64_t burn_in_size,
             double first_draw
         ) const override {
-            auto out_tensor = torch::full({sample_size}, intercept, torch::kDouble);
-            auto out_tensor_a = out_tensor.accessor<double, 1>();
-            for (int64_t i = 0; i != sample_size; ++i) {
-                auto dist_draw_i = dist->generate(1, 0, 0.0); // We need to change this once we fix NormalVector to use the sample_size.
-                for (const auto& item_j : linear_coefficients) {
-                    out_tensor_a[i] += torch::dot(dist_draw_i[item_j.key()], item_j.value()).item<double>();
+            if (!sample_size || coefficient_keys.empty()) {
+                return {{name, torch::full({sample_size}, intercept, torch::kDouble)}};
+            }
+            auto draws = draw_matrix(sample_size);
+            auto out_tensor = (
+                torch::matmul(draws, linear_coefficients_collapsed) +
+                (torch::matmul(draws, quadratic_coefficients_collapsed)*draws).sum(1)
+            ) + intercept;
+            return {{name, std::move(out_tensor)}};
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> cumulants(int64_t num_cumulants) const override {
+            const auto& sp = get_spectrum();
+            auto out = torch::zeros({num_cumulants}, torch::kDouble);
+            auto out_a = out.accessor<double, 1>();
+            // kappa_r = (r-1)! 2^(r-1) sum lambda^r + r! 2^(r-3) sum v^2 lambda^(r-2), for r >= 2.
+            double factorial_r_minus_1 = 1.0;
+            for (int64_t r = 1; r <= num_cumulants; ++r) {
+                if (r > 1) factorial_r_minus_1 *= r - 1;
+                double sum_lambda_r = 0.0;
+                double sum_v2_lambda_r_minus_2 = 0.0;
+                for (size_t j = 0; j != sp.lambda.size(); ++j) {
+                    sum_lambda_r += std::pow(sp.lambda[j], r);
+                    if (r > 1) sum_v2_lambda_r_minus_2 += sp.v2[j]*std::pow(sp.lambda[j], r - 2);
                 }
-                for (const auto& item_j : quadratic_coefficients) {
-                    const auto& key_j = item_j.key();
-                    const auto& dist_draw_ij = dist_draw_i[key_j];
-                    const auto& quadratic_coefficients_j = item_j.value();
-                    for (const auto& item_k : quadratic_coefficients_j) {
-                        const auto& key_k = item_k.key();
-                        const auto& dist_draw_ik = dist_draw_i[key_k];
-                        const auto& quadratic_coefficients_jk = item_k.value();
-                        out_tensor_a[i] += torch::dot(dist_draw_ij, torch::matmul(quadratic_coefficients_jk, dist_draw_ik)).item<double>();
-                    }
+                if (r == 1) {
+                    out_a[0] = sp.k + sum_lambda_r;
+                } else {
+                    out_a[r-1] = factorial_r_minus_1*std::ldexp(sum_lambda_r, r - 1)
+                               + r*factorial_r_minus_1*std::ldexp(sum_v2_lambda_r_minus_2, r - 3);
                 }
             }
-            return {{name, std::move(out_tensor)}};
+            return {{name, std::move(out)}};
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> cdf(
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            return {{name, map_elements(observations[name], [this](double y) { return cdf_at(y); })}};
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> cdf(double observations) const override {
+            return {{name, torch::full({}, cdf_at(observations), torch::kDouble)}};
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> quantile(
+            const torch::OrderedDict<std::string, torch::Tensor>& probabilities
+        ) const override {
+            return {{name, map_elements(probabilities[name], [this](double p) { return quantile_at(p); })}};
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> quantile(double probability) const override {
+            return {{name, torch::full({}, quantile_at(probability), torch::kDouble)}};
         }
 
     private:
+        struct Spectrum {
+            double k;
+            std::vector<double> lambda;
+            std::vector<double> v2;
+            // The saddlepoint equation has solutions in (s_min, s_max).
+            double s_min;
+            double s_max;
+        };
+
         std::string name;
         std::shared_ptr<Distribution> dist;
         double intercept;
         torch::OrderedDict<std::string, torch::Tensor> linear_coefficients;
         torch::OrderedDict<std::string, torch::OrderedDict<std::string, torch::Tensor>> quadratic_coefficients;
+
+        std::vector<std::string> coefficient_keys;
+        torch::Tensor linear_coefficients_collapsed;
+        torch::Tensor quadratic_coefficients_collapsed;
+
+        // Found on first use, since only the closed-form methods need dist to be Gaussian.
+        mutable std::shared_ptr<const Spectrum> spectrum;
+
+        const Spectrum& get_spectrum(void) const {
+            if (spectrum) {
+                return *spectrum;
+            }
+            auto out = std::make_shared<Spectrum>();
+            if (coefficient_keys.empty()) {
+                out->k = intercept;
+                out->s_min = -std::numeric_limits<double>::infinity();
+                out->s_max = std::numeric_limits<double>::infinity();
+                spectrum = std::move(out);
+                return *spectrum;
+            }
+
+            // dist is affine in the standard normal draws, so the image of zero
+            // gives m and the images of the unit vectors give m + L.
+            int64_t d;
+            try {
+                d = dist->standard_normal_dimension();
+            } catch (const std::runtime_error&) {
+                std::ostringstream ss;
+                ss << "Quadratic \"" << name << "\": the cumulants, cdf and quantiles need dist to be Gaussian, "
+                   << "given as a transformation of standard normal draws, as a central limit theorem sampling "
+                   << "distribution is. For other distributions, such as those of the bootstraps, use generate.";
+                throw std::runtime_error(ss.str());
+            }
+            auto basis = torch::cat({torch::zeros({1, d}, torch::kDouble), torch::eye(d, torch::kDouble)}, 0);
+            auto images = collapse_draws(dist->generate_from_standard_normal(basis), d + 1);
+            auto m = images[0];
+            auto L = (images.narrow(0, 1, d) - m).t();
+
+            const auto& b = linear_coefficients_collapsed;
+            auto Q = 0.5*(quadratic_coefficients_collapsed + quadratic_coefficients_collapsed.t());
+            auto eig = torch::matmul(L.t(), torch::matmul(Q, L)).symeig(true);
+            const auto& lambda = std::get<0>(eig);
+            const auto& P = std::get<1>(eig);
+            auto v = torch::matmul(P.t(), torch::matmul(L.t(), b + 2.0*torch::matmul(Q, m)));
+
+            out->k = intercept + b.dot(m).item<double>() + m.dot(torch::matmul(Q, m)).item<double>();
+            auto lambda_c = lambda.contiguous();
+            auto v2_c = v.square().contiguous();
+            out->lambda.assign(lambda_c.data_ptr<double>(), lambda_c.data_ptr<double>() + d);
+            out->v2.assign(v2_c.data_ptr<double>(), v2_c.data_ptr<double>() + d);
+            out->s_min = -std::numeric_limits<double>::infinity();
+            out->s_max = std::numeric_limits<double>::infinity();
+            for (auto l : out->lambda) {
+                if (l > 0.0) out->s_max = std::min(out->s_max, 0.5/l);
+                if (l < 0.0) out->s_min = std::max(out->s_min, 0.5/l);
+            }
+            spectrum = std::move(out);
+            return *spectrum;
+        }
+
+        // The cumulant generating function and its first two derivatives.
+        double K(double s) const {
+            const auto& sp = get_spectrum();
+            double out = s*sp.k;
+            for (size_t j = 0; j != sp.lambda.size(); ++j) {
+                auto a = 1.0 - 2.0*s*sp.lambda[j];
+                out += -0.5*std::log(a) + 0.5*s*s*sp.v2[j]/a;
+            }
+            return out;
+        }
+
+        double K1(double s) const {
+            const auto& sp = get_spectrum();
+            double out = sp.k;
+            for (size_t j = 0; j != sp.lambda.size(); ++j) {
+                auto l = sp.lambda[j];
+                auto a = 1.0 - 2.0*s*l;
+                out += l/a + s*sp.v2[j]*(1.0 - s*l)/(a*a);
+            }
+            return out;
+        }
+
+        double K2(double s) const {
+            const auto& sp = get_spectrum();
+            double out = 0.0;
+            for (size_t j = 0; j != sp.lambda.size(); ++j) {
+                auto l = sp.lambda[j];
+                auto a = 1.0 - 2.0*s*l;
+                out += 2.0*l*l/(a*a) + sp.v2[j]/(a*a*a);
+            }
+            return out;
+        }
+
+        // The s in (s_min, s_max) at which the increasing g(s) reaches target,
+        // by bisection, or +-infinity if g stays on one side of target.
+        template<class G>
+        double solve_increasing(G&& g, double target) const {
+            const auto& sp = get_spectrum();
+            auto g0 = g(0.0);
+            if (g0 == target) {
+                return 0.0;
+            }
+            bool up = g0 < target;
+            double inner = 0.0;
+            double outer = up ? sp.s_max : sp.s_min;
+            if (std::isinf(outer)) {
+                // Double away from zero until the target is passed.
+                double step = up ? 1.0 : -1.0;
+                while (true) {
+                    if (std::abs(step) > 1e300) {
+                        return up ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+                    }
+                    auto g_step = g(step);
+                    if (up ? g_step >= target : g_step <= target) {
+                        outer = step;
+                        break;
+                    }
+                    inner = step;
+                    step *= 2.0;
+                }
+            }
+            for (int i = 0; i != 200; ++i) {
+                auto mid = 0.5*(inner + outer);
+                if (mid == inner || mid == outer) {
+                    break;
+                }
+                auto g_mid = g(mid);
+                if (up ? g_mid < target : g_mid > target) {
+                    inner = mid;
+                } else {
+                    outer = mid;
+                }
+            }
+            return 0.5*(inner + outer);
+        }
+
+        // The Lugannani-Rice approximation to the cdf at K1(s).
+        double cdf_at_saddlepoint(double s) const {
+            auto kappa2 = K2(0.0);
+            if (std::isinf(s)) {
+                return s > 0.0 ? 1.0 : 0.0;
+            }
+            if (std::abs(s)*std::sqrt(kappa2) < 1e-5) {
+                // Near the mean, as the limit of the approximation there.
+                auto kappa3 = cumulants(3)[name][2].item<double>();
+                return 0.5 + inv_sqrt_2_pi*kappa3/(6.0*std::pow(kappa2, 1.5));
+            }
+            auto y = K1(s);
+            auto w = std::copysign(std::sqrt(std::max(2.0*(s*y - K(s)), 0.0)), s);
+            auto u = s*std::sqrt(K2(s));
+            auto Phi_w = 0.5*std::erfc(-inv_sqrt_2*w);
+            auto phi_w = inv_sqrt_2_pi*std::exp(-0.5*w*w);
+            return std::min(std::max(Phi_w + phi_w*(1.0/w - 1.0/u), 0.0), 1.0);
+        }
+
+        double cdf_at(double y) const {
+            if (missing::isna(y)) {
+                return missing::na;
+            }
+            if (K2(0.0) == 0.0) {
+                // A point mass.
+                return y >= K1(0.0) ? 1.0 : 0.0;
+            }
+            return cdf_at_saddlepoint(solve_increasing([this](double s) { return K1(s); }, y));
+        }
+
+        double quantile_at(double p) const {
+            if (missing::isna(p)) {
+                return missing::na;
+            }
+            if (p < 0.0 || p > 1.0) {
+                std::ostringstream ss;
+                ss << "Quadratic::quantile: the probability " << p << " is not in [0, 1].";
+                throw std::logic_error(ss.str());
+            }
+            if (K2(0.0) == 0.0) {
+                return K1(0.0);
+            }
+            // The approximate cdf is increasing in the saddlepoint, so solve for it.
+            auto s = solve_increasing([this](double s) { return cdf_at_saddlepoint(s); }, p);
+            if (std::isinf(s)) {
+                return s;
+            }
+            return K1(s);
+        }
+
+        template<class OP>
+        static torch::Tensor map_elements(const torch::Tensor& x, OP&& op) {
+            auto x_c = x.to(torch::kDouble).contiguous();
+            auto out = torch::empty_like(x_c);
+            const auto *x_ptr = x_c.data_ptr<double>();
+            auto *out_ptr = out.data_ptr<double>();
+            for (int64_t i = 0; i != x_c.numel(); ++i) {
+                out_ptr[i] = op(x_ptr[i]);
+            }
+            return out;
+        }
+
+        void collapse_coefficients(void) {
+            torch::OrderedDict<std::string, std::pair<int64_t, int64_t>> slices;
+            int64_t size = 0;
+            auto add_key = [&](const std::string& key, int64_t key_size) {
+                const auto *slice = slices.find(key);
+                if (!slice) {
+                    slices.insert(key, std::make_pair(size, key_size));
+                    coefficient_keys.emplace_back(key);
+                    size += key_size;
+                } else if (slice->second != key_size) {
+                    std::ostringstream ss;
+                    ss << "Quadratic: the coefficients for \"" << key << "\" have sizes " << slice->second
+                       << " and " << key_size << '.';
+                    throw std::logic_error(ss.str());
+                }
+            };
+            for (const auto& item : linear_coefficients) {
+                add_key(item.key(), item.value().numel());
+            }
+            for (const auto& item_j : quadratic_coefficients) {
+                for (const auto& item_k : item_j.value()) {
+                    const auto& quadratic_coefficients_jk = item_k.value();
+                    add_key(item_j.key(), quadratic_coefficients_jk.size(0));
+                    add_key(item_k.key(), quadratic_coefficients_jk.size(1));
+                }
+            }
+
+            linear_coefficients_collapsed = torch::zeros({size}, torch::kDouble);
+            for (const auto& item : linear_coefficients) {
+                const auto& slice = slices[item.key()];
+                linear_coefficients_collapsed.narrow(0, slice.first, slice.second).copy_(item.value().reshape({-1}));
+            }
+            quadratic_coefficients_collapsed = torch::zeros({size, size}, torch::kDouble);
+            for (const auto& item_j : quadratic_coefficients) {
+                const auto& slice_j = slices[item_j.key()];
+                for (const auto& item_k : item_j.value()) {
+                    const auto& slice_k = slices[item_k.key()];
+                    quadratic_coefficients_collapsed.narrow(0, slice_j.first, slice_j.second)
+                                                    .narrow(1, slice_k.first, slice_k.second)
+                                                    .add_(item_k.value());
+                }
+            }
+        }
+
+        // The draws of dist, one row per draw, in the order of coefficient_keys.
+        torch::Tensor draw_matrix(int64_t sample_size) const {
+            return collapse_draws(dist->generate(sample_size, 0, 0.0), sample_size);
+        }
+
+        // draws, as a matrix with one row per draw, in the order of
+        // coefficient_keys. A key drawn with a single column, as for an
+        // integer index, may come without its column dimension.
+        torch::Tensor collapse_draws(
+            const torch::OrderedDict<std::string, torch::Tensor>& draws,
+            int64_t sample_size
+        ) const {
+            std::vector<torch::Tensor> columns; columns.reserve(coefficient_keys.size());
+            for (const auto& key : coefficient_keys) {
+                const auto& column = draws[key];
+                columns.emplace_back(column.reshape({column.size(0), -1}).toType(torch::kDouble));
+            }
+            auto out = torch::cat(columns, 1);
+            if (out.size(0) != sample_size) {
+                std::ostringstream ss;
+                ss << "Quadratic: expected " << sample_size << " draws, but got " << out.size(0) << '.';
+                throw std::logic_error(ss.str());
+            }
+            return out;
+        }
 };
 
 std::unique_ptr<Distribution> ManufactureQuadratic(
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include <torch/torch.h>
 #include <libtorch_support/derivatives.hpp>
 #include <libtorch_support/indexing.hpp>
@@ -50,6 +51,21 @@ std::shared_ptr<ProbabilisticModule> SamplingDistribution::draw_stochastic_proce
     return get_fit()->draw_stochastic_process(*get_parameter_distribution());
 }
 
+CollapsedTensor<std::string> SamplingDistribution::draw_parameters(int64_t num_draws) const {
+    auto draws = get_parameter_distribution()->generate(num_draws, 0, 0.0);
+    torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices; indices.reserve(draws.size());
+    std::vector<torch::Tensor> columns; columns.reserve(draws.size());
+    int64_t begin = 0;
+    for (const auto& item : draws) {
+        auto column = item.value().reshape({num_draws, -1});
+        auto end = begin + column.size(1);
+        indices.insert(item.key(), torch::indexing::Slice(begin, end));
+        columns.emplace_back(std::move(column));
+        begin = end;
+    }
+    return {torch::cat(columns, 1), std::move(indices)};
+}
+
 std::unique_ptr<Distribution> SamplingDistribution::get_centered_function_estimate_distribution(
     std::string function_name,
     torch::OrderedDict<std::string, torch::Tensor> jac,
@@ -70,8 +86,8 @@ std::unique_ptr<Distribution> SamplingDistribution::get_centered_function_estima
     auto fit = get_fit();
     auto f_fit = f(*fit); throw_if_multi_valued(f_fit);
     auto params = fit->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
-    auto jac = jacobian(f_fit, params, JacobianMode::Auto, /*create_graph=*/true);
-    auto hess = jacobian(jac, params);
+    torch::OrderedDict<std::string, torch::Tensor> jac;
+    auto hess = hessian(f_fit, params, &jac);
     return get_centered_function_estimate_distribution(
         std::move(function_name),
         std::move(jac),
@@ -116,9 +132,8 @@ std::unique_ptr<Distribution> SamplingDistribution::get_function_distribution(
     auto fit = get_fit();
     auto f_fit = f(*fit); throw_if_multi_valued(f_fit);
     auto params = fit->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
-    auto jac = jacobian(f_fit, params, JacobianMode::Auto, /*create_graph=*/true);
-    auto hess = jacobian(jac, params);
-    for (auto& item : jac) { auto& j = item.value(); j = j.detach(); }
+    torch::OrderedDict<std::string, torch::Tensor> jac;
+    auto hess = hessian(f_fit, params, &jac);
     return get_function_distribution(
         std::move(function_name),
         std::move(f_fit),
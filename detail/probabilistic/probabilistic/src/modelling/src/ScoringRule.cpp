@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <string>
 #include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
 #include <libtorch_support/missing.hpp>
 #include <libtorch_support/time_series.hpp>
 #include <modelling/sample_size.hpp>
@@ -33,7 +34,7 @@ torch::OrderedDict<std::string, torch::Tensor> ScoringRule::score(
         const auto& key = item.key();
         score_with_barrier.insert(
             key,
-            missing::handle_na(
+            missing::handle_na_elementwise(
                 [](const torch::Tensor& score_no_barrier_i, const torch::Tensor& barrier_i) {
                     return score_no_barrier_i + barrier_i;
                 },
@@ -65,6 +66,13 @@ torch::Tensor ScoringRule::sum(const torch::OrderedDict<std::string, torch::Tens
     return ::sum(scores);
 }
 
+torch::Tensor ScoringRule::sum(
+    const torch::OrderedDict<std::string, torch::Tensor>& scores,
+    const MissingnessIndex& scores_missingness
+) const {
+    return scores_missingness.sum(scores) + 1.0;
+}
+
 torch::Tensor ScoringRule::sum(
     const Distribution& forecasts,
     const torch::OrderedDict<std::string, torch::Tensor>& observations
@@ -95,10 +103,34 @@ torch::Tensor average(const torch::OrderedDict<std::string, torch::Tensor>& scor
 
 torch::Tensor ScoringRule::average(const torch::OrderedDict<std::string, torch::Tensor>& scores) const {
     auto scores_not_na = get_scores_not_na(scores);
-    auto sample_size = get_sample_size(scores_not_na);
+    auto sample_size = get_sample_size_snn(scores_not_na);
     return ::average(scores, scores_not_na, sample_size);
 }
 
+torch::Tensor ScoringRule::average(
+    const torch::OrderedDict<std::string, torch::Tensor>& scores,
+    const MissingnessIndex& scores_missingness
+) const {
+    return sum(scores, scores_missingness)/scores_missingness.sample_size();
+}
+
+torch::Tensor ScoringRule::averages(const torch::OrderedDict<std::string, torch::Tensor>& scores) const {
+    if (scores.is_empty()) {
+        throw std::logic_error("ScoringRule::averages called without scores.");
+    }
+    auto batch_size = scores[0].value().size(0);
+    // As average, whose sum begins at one.
+    auto sums = torch::full({batch_size}, 1.0, torch::kDouble);
+    auto sample_sizes = torch::zeros({batch_size}, torch::kDouble);
+    for (const auto& item : scores) {
+        auto scores_not_na = missing::isna(item.value()).logical_not().reshape({batch_size, -1});
+        auto scores_flat = item.value().reshape({batch_size, -1});
+        sums += scores_flat.masked_fill(scores_not_na.logical_not(), 0.0).sum(-1, false, torch::kDouble);
+        sample_sizes += scores_not_na.sum(-1, false, torch::kDouble);
+    }
+    return sums/sample_sizes;
+}
+
 torch::Tensor ScoringRule::average(
     const Distribution& forecasts,
     const torch::OrderedDict<std::string, torch::Tensor>& observations
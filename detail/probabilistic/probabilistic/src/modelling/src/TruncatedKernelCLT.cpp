@@ -89,7 +89,8 @@ std::shared_ptr<SamplingDistribution> ManufactureTruncatedKernelCLT(
     
     auto total_score = scoring_rule.sum(scores);
 
-    auto full_sample_size = get_sample_size(scores);
+    auto scores_missingness = model.scores_missingness();
+    auto full_sample_size = scores_missingness ? scores_missingness->sample_size() : get_sample_size(scores);
 
     auto parameters = model.named_parameters(/*recurse=*/true, /*include_fixed=*/false);
 
@@ -142,9 +143,10 @@ std::shared_ptr<SamplingDistribution> ManufactureTruncatedKernelCLT(
         // 0.0
     );
 
-    auto total_score_jacobian = jacobian(total_score, parameters, JacobianMode::Auto, /*create_graph=*/true);
+    torch::OrderedDict<std::string, torch::Tensor> total_score_jacobian;
+    auto total_score_hessian = hessian(total_score, parameters, &total_score_jacobian);
     auto average_score_jacobian = total_score_jacobian/full_sample_size;
-    auto average_score_hessian = jacobian(average_score_jacobian, parameters);
+    auto average_score_hessian = total_score_hessian/full_sample_size;
     torch::OrderedDict<std::string, torch::OrderedDict<std::string, torch::Tensor>> estimating_equations_jacobian = jacobian(
         estimating_equations_sums/sample_size_by_parameter,
         parameters,
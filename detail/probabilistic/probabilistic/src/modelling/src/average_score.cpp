@@ -0,0 +1,76 @@
+#include <functional>
+#include <memory>
+#include <string>
+#include <libtorch_support/time_series.hpp>
+#include <modelling/functional/average_score.hpp>
+#include <modelling/functional/window_average.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/score/ScoringRule.hpp>
+
+// The score one step past the in-sample times, as a functional for the
+// window averages.
+static std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> one_step_ahead_score(
+    std::shared_ptr<const ScoringRule> scoring_rule
+) {
+    return [=](
+        const Distribution& forecast_distributions,
+        const torch::OrderedDict<std::string, torch::Tensor>& observations,
+        const SampleSplitter& splitter
+    ) {
+        auto scores = scoring_rule->score(forecast_distributions, observations);
+        auto hsa_scores = splitter.h_steps_ahead(scores, 1);
+        return scoring_rule->average(hsa_scores);
+    };
+}
+
+torch::Tensor average_score_expanding_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    std::shared_ptr<const ScoringRule> scoring_rule,
+    int64_t min_in_sample_times,
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    return expanding_window_average(
+        one_step_ahead_score(scoring_rule ? std::move(scoring_rule) : fit->scoring_rule()),
+        fit,
+        observations,
+        min_in_sample_times,
+        time_dimension,
+        /* max_horizon = */ 1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+}
+
+torch::Tensor average_score_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    std::shared_ptr<const ScoringRule> scoring_rule,
+    int64_t window_size,
+    torch::Tensor *per_origin,
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    return rolling_window_average(
+        one_step_ahead_score(scoring_rule ? std::move(scoring_rule) : fit->scoring_rule()),
+        fit,
+        observations,
+        window_size,
+        per_origin,
+        time_dimension,
+        /* max_horizon = */ 1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+}
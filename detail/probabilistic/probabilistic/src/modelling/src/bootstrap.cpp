@@ -0,0 +1,137 @@
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <torch/torch.h>
+#include <libtorch_support/indexing.hpp>
+#include <modelling/distribution/Distribution.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/inference/bootstrap.hpp>
+
+#include <log/trivial.hpp>
+
+// The empirical distribution of the rows of a matrix, with the columns of
+// each parameter given by indices. Draws are rows drawn uniformly, with
+// replacement.
+class EmpiricalVector : public Distribution {
+    public:
+        EmpiricalVector(
+            torch::Tensor rows_in,
+            torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices_in
+        ):
+            rows(std::move(rows_in)),
+            indices(std::move(indices_in))
+        { }
+
+        // One row for each draw, for each index.
+        torch::OrderedDict<std::string, torch::Tensor> generate(
+            int64_t sample_size,
+            int64_t burn_in_size,
+            double first_draw
+        ) const override {
+            auto drawn = rows.index({torch::randint(rows.size(0), {sample_size}, torch::kLong)});
+            torch::OrderedDict<std::string, torch::Tensor> out; out.reserve(indices.size());
+            for (const auto& item : indices) {
+                out.insert(item.key(), drawn.index({torch::indexing::Slice(), item.value()}));
+            }
+            return out;
+        }
+
+    private:
+        torch::Tensor rows;
+        torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices;
+};
+
+class Bootstrap : public SamplingDistribution {
+    public:
+        Bootstrap(
+            std::shared_ptr<ProbabilisticModule> fit_in,
+            std::shared_ptr<Distribution> centered_parameter_estimate_distribution_in,
+            std::shared_ptr<Distribution> parameter_distribution_in
+        ):
+            fit(std::move(fit_in)),
+            centered_parameter_estimate_distribution(std::move(centered_parameter_estimate_distribution_in)),
+            parameter_distribution(std::move(parameter_distribution_in))
+        { }
+
+        std::shared_ptr<ProbabilisticModule> get_fit(void) const override {
+            return fit->clone_probabilistic_module();
+        }
+
+        const ProbabilisticModule& get_fit_ref(void) const override {
+            return *fit;
+        }
+
+        std::shared_ptr<Distribution> get_centered_parameter_estimate_distribution(void) const override {
+            return centered_parameter_estimate_distribution;
+        }
+
+        std::shared_ptr<Distribution> get_parameter_distribution(void) const override {
+            return parameter_distribution;
+        }
+
+        std::shared_ptr<ProbabilisticModule> draw_stochastic_process(void) const override {
+            return fit->draw_stochastic_process(*parameter_distribution);
+        }
+
+    private:
+        std::shared_ptr<ProbabilisticModule> fit;
+        std::shared_ptr<Distribution> centered_parameter_estimate_distribution;
+        std::shared_ptr<Distribution> parameter_distribution;
+};
+
+std::shared_ptr<SamplingDistribution> bootstrap_refits(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& replicate_observations,
+    int64_t num_threads
+) {
+    auto& model = *fit;
+    auto num_replications = replicate_observations[0].value().size(0);
+
+    // Warm starts, from the point estimate and the barrier it was found at.
+    auto plan = model.fit_plan();
+    plan.barrier_begin = model.barrier_multiplier();
+    std::vector<char> success;
+    auto refits = model.fit_replications(replicate_observations, model.scoring_rule(), plan, &success, num_threads);
+
+    torch::NoGradGuard no_grad;
+
+    auto parameters_collapsed = collapse_vector(model.named_parameters(/*recurse=*/true, /*include_fixed=*/false));
+
+    std::vector<torch::Tensor> rows; rows.reserve(refits.size());
+    for (size_t r = 0; r != refits.size(); ++r) {
+        if (!success.at(r)) {
+            continue;
+        }
+        rows.emplace_back(collapse_vector(refits.at(r)->named_parameters(/*recurse=*/true, /*include_fixed=*/false)).tensor);
+    }
+    if (rows.empty()) {
+        std::ostringstream ss;
+        ss << "bootstrap_refits: none of the " << num_replications << " refits of model \"" << model.name() << "\" converged.";
+        throw std::runtime_error(ss.str());
+    }
+    if (static_cast<int64_t>(rows.size()) != num_replications) {
+        PROBABILISTIC_LOG_TRIVIAL_WARNING << num_replications - static_cast<int64_t>(rows.size()) << " of " << num_replications
+                                          << " refits did not converge, and are left out of the sampling distribution.";
+    }
+    auto parameter_draws = torch::stack(rows);
+
+    auto parameter_distribution = std::make_shared<EmpiricalVector>(
+        parameter_draws,
+        parameters_collapsed.indices
+    );
+
+    auto centered_parameter_estimate_distribution = std::make_shared<EmpiricalVector>(
+        parameter_draws - parameters_collapsed.tensor,
+        parameters_collapsed.indices
+    );
+
+    return std::make_shared<Bootstrap>(
+        std::move(fit),
+        std::move(centered_parameter_estimate_distribution),
+        std::move(parameter_distribution)
+    );
+}
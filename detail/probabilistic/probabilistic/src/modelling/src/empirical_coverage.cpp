@@ -1,3 +1,4 @@
+#include <functional>
 #include <memory>
 #include <string>
 #include <libtorch_support/moments.hpp>
@@ -49,6 +50,25 @@ torch::Tensor empirical_coverage(
     return avg;
 }
 
+// The coverage one step past the in-sample times, as a functional for the
+// window averages.
+static std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> one_step_ahead_coverage(
+    double open_lower_probability,
+    double closed_upper_probability,
+    bool complement
+) {
+    return [=](
+        const Distribution& forecast_distributions,
+        const torch::OrderedDict<std::string, torch::Tensor>& observations,
+        const SampleSplitter& splitter
+    ) {
+        auto covered = get_covered(forecast_distributions, observations, open_lower_probability, closed_upper_probability, complement);
+        auto hsa_covered = splitter.h_steps_ahead(covered, 1);
+        auto avg = average(hsa_covered);
+        return avg;
+    };
+}
+
 torch::Tensor empirical_coverage_expanding_window(
     std::shared_ptr<ProbabilisticModule> fit,
     const torch::OrderedDict<std::string, torch::Tensor>& observations,
@@ -56,25 +76,23 @@ torch::Tensor empirical_coverage_expanding_window(
     double closed_upper_probability,
     bool complement,
     int64_t min_in_sample_times,
-    int64_t time_dimension
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
 ) {
     return expanding_window_average(
-         [&](
-             const Distribution& forecast_distributions,
-             const torch::OrderedDict<std::string, torch::Tensor>& observations,
-             const SampleSplitter& splitter
-         ) {
-            auto obs_one_step_ahead = splitter.h_steps_ahead(observations, 1);
-            auto cdf_one_step_ahead = splitter.h_steps_ahead(forecast_distributions.cdf(observations), 1);
-            auto covered = get_covered(forecast_distributions, observations, open_lower_probability, closed_upper_probability, complement);
-            auto hsa_covered = splitter.h_steps_ahead(covered, 1);
-            auto avg = average(hsa_covered);
-            return avg;
-        },
+        one_step_ahead_coverage(open_lower_probability, closed_upper_probability, complement),
         fit,
         observations,
         min_in_sample_times,
-        time_dimension
+        time_dimension,
+        /* max_horizon = */ 1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
     );
 }
 
@@ -84,7 +102,11 @@ torch::Tensor empirical_coverage_expanding_window(
     double closed_upper_probability,
     bool complement,
     int64_t min_in_sample_times,
-    int64_t time_dimension
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
 ) {
     return empirical_coverage_expanding_window(
         fit,
@@ -93,7 +115,69 @@ torch::Tensor empirical_coverage_expanding_window(
         closed_upper_probability,
         complement,
         min_in_sample_times,
-        time_dimension
+        time_dimension,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+}
+
+
+torch::Tensor empirical_coverage_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    double open_lower_probability,
+    double closed_upper_probability,
+    bool complement,
+    int64_t window_size,
+    torch::Tensor *per_origin,
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    return rolling_window_average(
+        one_step_ahead_coverage(open_lower_probability, closed_upper_probability, complement),
+        fit,
+        observations,
+        window_size,
+        per_origin,
+        time_dimension,
+        /* max_horizon = */ 1,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
     );
 }
 
+torch::Tensor empirical_coverage_rolling_window(
+    std::shared_ptr<ProbabilisticModule> fit,
+    double open_lower_probability,
+    double closed_upper_probability,
+    bool complement,
+    int64_t window_size,
+    torch::Tensor *per_origin,
+    int64_t time_dimension,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    return empirical_coverage_rolling_window(
+        fit,
+        fit->observations(),
+        open_lower_probability,
+        closed_upper_probability,
+        complement,
+        window_size,
+        per_origin,
+        time_dimension,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+}
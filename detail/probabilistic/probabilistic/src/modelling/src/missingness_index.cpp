@@ -0,0 +1,27 @@
+#include <string>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <modelling/missingness_index.hpp>
+
+MissingnessIndex::MissingnessIndex(const torch::OrderedDict<std::string, torch::Tensor>& values) {
+    present_masks.reserve(values.size());
+    present_flat_indices.reserve(values.size());
+    series_sizes.reserve(values.size());
+    for (const auto& item : values) {
+        const auto& key = item.key();
+        auto present_i = missing::is_present(item.value().detach());
+        auto series_sizes_i = present_i.ndimension() ? present_i.sum(-1, false, torch::kLong) : present_i.to(torch::kLong);
+        present_flat_indices.insert(key, present_i.reshape(-1).nonzero().squeeze(-1));
+        total_size += series_sizes_i.sum().item<int64_t>();
+        series_sizes.insert(key, std::move(series_sizes_i));
+        present_masks.insert(key, std::move(present_i));
+    }
+}
+
+torch::Tensor MissingnessIndex::sum(const torch::OrderedDict<std::string, torch::Tensor>& values) const {
+    torch::Tensor sum_values = torch::full({}, 0.0, torch::kDouble);
+    for (const auto& item : present_flat_indices) {
+        sum_values = sum_values + values[item.key()].reshape(-1).index_select(0, item.value()).sum();
+    }
+    return sum_values;
+}
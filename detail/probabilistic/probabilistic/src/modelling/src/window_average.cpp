@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <libtorch_support/moments.hpp>
+#include <libtorch_support/parallel.hpp>
 #include <libtorch_support/time_series.hpp>
 #include <modelling/distribution/Distribution.hpp>
 #include <modelling/functional/window_average.hpp>
@@ -62,40 +63,139 @@ torch::Tensor out_of_sample_average(
     );
 }
 
+// The results of functional at each origin T from min_in_sample_times, with
+// model refit at each to the window_size times before T, or to all times
+// before T if window_size <= 0. The functional sees the window, and the times
+// after it that it reads, with times counted from the start of the window.
+// Empty if there are no origins.
+static std::vector<torch::Tensor> window_results(
+    const std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)>& functional,
+    const ProbabilisticModule& model,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t min_in_sample_times,
+    int64_t window_size,
+    int64_t time_dimension,
+    int64_t max_horizon,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    auto num_origins = min_out_of_sample_times(observations, min_in_sample_times, time_dimension);
+    if (num_origins <= 0) {
+        return {};
+    }
+
+    auto scoring_rule = model.scoring_rule();
+    auto fit_plan = model.fit_plan();
+
+    // Origins are split into chains of chain_length consecutive origins,
+    // counted from the first, or into one chain if chain_length <= 0. Each
+    // chain starts from the parameters of model, and each origin after the
+    // first in a chain starts from the fit at the origin before it. That fit
+    // is refit in full every refit_every origins of the chain, and otherwise
+    // updated only by Newton steps unless they fail. Chains share nothing, so
+    // contiguous runs of them are spread over the threads, and the results do
+    // not depend on num_threads.
+    auto chain_size = chain_length > 0 ? std::min(chain_length, num_origins) : num_origins;
+    auto refit_size = std::max<int64_t>(1, refit_every);
+    auto num_chains = (num_origins + chain_size - 1)/chain_size;
+    auto num_runs = std::max<int64_t>(1, std::min(num_threads, num_chains));
+    std::vector<std::shared_ptr<ProbabilisticModule>> run_models; run_models.reserve(num_runs);
+    for (int64_t run = 0; run != num_runs; ++run) {
+        run_models.emplace_back(model.clone_probabilistic_module());
+    }
+    torch::OrderedDict<std::string, torch::Tensor> start_parameters;
+    {
+        torch::NoGradGuard no_grad;
+        for (const auto& item : model.named_parameters(/*recurse=*/true, /*include_fixed=*/true)) {
+            start_parameters.insert(item.key(), item.value().detach().clone());
+        }
+    }
+
+    std::vector<torch::Tensor> results(num_origins);
+    parallel_for(num_runs, num_runs, 0, [&](int64_t run) {
+        auto& run_model = *run_models.at(run);
+        auto begin = run*num_chains/num_runs*chain_size;
+        auto end = std::min(num_origins, (run + 1)*num_chains/num_runs*chain_size);
+        for (auto i = begin; i != end; ++i) {
+            auto T = min_in_sample_times + i;
+            auto window_begin = window_size > 0 ? T - window_size : 0;
+            // Forecasts depend only on the observations before them, so those
+            // past the last time the functional reads need not be forecast.
+            // Slices along time are views, so windows are not copied.
+            auto observations_read = max_horizon < 0
+                ? observations
+                : SampleSplitter(T + max_horizon + 1, time_dimension).in_sample(observations);
+            if (window_begin > 0) {
+                observations_read = SampleSplitter(window_begin, time_dimension).out_of_sample(observations_read);
+            }
+            SampleSplitter splitter(T - window_begin, time_dimension);
+            auto in_sample_observations = splitter.in_sample(observations_read);
+            auto chain_position = i % chain_size;
+            if (!chain_position) {
+                // Cloned, since the optimiser updates the parameters in place.
+                torch::NoGradGuard no_grad;
+                torch::OrderedDict<std::string, torch::Tensor> chain_parameters; chain_parameters.reserve(start_parameters.size());
+                for (const auto& item : start_parameters) {
+                    chain_parameters.insert(item.key(), item.value().clone());
+                }
+                run_model.set_parameters(chain_parameters);
+            }
+            bool refit = chain_position % refit_size == 0 || !run_model.update_fit(in_sample_observations, num_newton_steps);
+            if (refit) {
+                run_model.fit(
+                    in_sample_observations,
+                    scoring_rule,
+                    fit_plan,
+                    /* diagnostics = */ nullptr
+                );
+            }
+            results.at(i) = functional(*run_model.forward(observations_read), observations_read, splitter);
+        }
+    });
+
+    return results;
+}
+
+// The results of window_results as one flat tensor, since their shapes may
+// differ from origin to origin.
+static torch::Tensor flatten_results(const std::vector<torch::Tensor>& results) {
+    std::vector<torch::Tensor> flat; flat.reserve(results.size());
+    for (const auto& r : results) {
+        flat.emplace_back(r.reshape({-1}));
+    }
+    return torch::cat(flat);
+}
+
 torch::Tensor expanding_window_average(
     std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
     std::shared_ptr<ProbabilisticModule> model,
     const torch::OrderedDict<std::string, torch::Tensor>& observations,
     int64_t min_in_sample_times,
-    int64_t time_dimension
+    int64_t time_dimension,
+    int64_t max_horizon,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
 ) {
-    model = model->clone_probabilistic_module();
-
-    auto scoring_rule = model->scoring_rule();
-    auto fit_plan = model->fit_plan();
-    auto fit_lambda = [&](ProbabilisticModule& model, const torch::OrderedDict<std::string, torch::Tensor>& obs) {
-        return model.fit(
-            obs,
-            scoring_rule,
-            fit_plan,
-            /* diagnostics = */ nullptr
-        );
-    };
-
     auto out = torch::empty({}, torch::kDouble);
-    if (min_out_of_sample_times(observations, min_in_sample_times, time_dimension) > 0) {
-        SampleSplitter splitter(min_in_sample_times, time_dimension);
-        fit_lambda(*model, splitter.in_sample(observations));
-        out = functional(*model->forward(observations), observations, splitter);
-        if (!out.ndimension()) { out = out.expand({1}); }
-        for (auto T = min_in_sample_times+1; min_out_of_sample_times(observations, T, time_dimension) > 0; ++T) {
-            SampleSplitter splitter(T, time_dimension);
-            fit_lambda(*model, splitter.in_sample(observations));
-            auto functional_result = functional(*model->forward(observations), observations, splitter);
-            if (!functional_result.ndimension()) { functional_result = functional_result.expand({1}); }
-            out = torch::cat({out, functional_result});
-        }
-        out = average(out);
+    auto results = window_results(
+        functional,
+        *model,
+        observations,
+        min_in_sample_times,
+        /* window_size = */ 0,
+        time_dimension,
+        max_horizon,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+    if (!results.empty()) {
+        out = average(flatten_results(results));
     }
 
     return out;
@@ -105,14 +205,91 @@ torch::Tensor expanding_window_average(
     std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
     std::shared_ptr<ProbabilisticModule> model,
     int64_t min_in_sample_times,
-    int64_t time_dimension
+    int64_t time_dimension,
+    int64_t max_horizon,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
 ) {
     return expanding_window_average(
         std::move(functional),
         model,
         model->observations(),
         min_in_sample_times,
-        time_dimension
+        time_dimension,
+        max_horizon,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
     );
 }
 
+
+torch::Tensor rolling_window_average(
+    std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
+    std::shared_ptr<ProbabilisticModule> model,
+    const torch::OrderedDict<std::string, torch::Tensor>& observations,
+    int64_t window_size,
+    torch::Tensor *per_origin,
+    int64_t time_dimension,
+    int64_t max_horizon,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    if (window_size < 1) {
+        throw std::invalid_argument("rolling_window_average: window_size must be positive.");
+    }
+    auto out = torch::empty({}, torch::kDouble);
+    auto results = window_results(
+        functional,
+        *model,
+        observations,
+        /* min_in_sample_times = */ window_size,
+        window_size,
+        time_dimension,
+        max_horizon,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+    if (!results.empty()) {
+        out = average(flatten_results(results));
+    }
+    if (per_origin) {
+        *per_origin = results.empty() ? torch::empty({0}, torch::kDouble) : torch::stack(results);
+    }
+
+    return out;
+}
+
+torch::Tensor rolling_window_average(
+    std::function<torch::Tensor(const Distribution&, const torch::OrderedDict<std::string, torch::Tensor>&, const SampleSplitter&)> functional,
+    std::shared_ptr<ProbabilisticModule> model,
+    int64_t window_size,
+    torch::Tensor *per_origin,
+    int64_t time_dimension,
+    int64_t max_horizon,
+    int64_t num_threads,
+    int64_t refit_every,
+    int64_t num_newton_steps,
+    int64_t chain_length
+) {
+    return rolling_window_average(
+        std::move(functional),
+        model,
+        model->observations(),
+        window_size,
+        per_origin,
+        time_dimension,
+        max_horizon,
+        num_threads,
+        refit_every,
+        num_newton_steps,
+        chain_length
+    );
+}
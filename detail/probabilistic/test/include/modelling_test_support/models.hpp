@@ -0,0 +1,110 @@
+#ifndef PROBABILISTIC_TEST_MODELS_HPP_GUARD
+#define PROBABILISTIC_TEST_MODELS_HPP_GUARD
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <torch/torch.h>
+#include <libtorch_support/indexing.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/model/ARARCHTX.hpp>
+#include <modelling/model/Ensemble.hpp>
+
+// An ARARCHTX model of the series "X", without exogenous regressors, and
+// without ARCH terms if arch is undefined. Unless the variance transformation
+// is crimped, the variance parameters are bounded below by zero.
+inline std::shared_ptr<ProbabilisticModule> make_ararchtx(
+    double var_transformation_crimp = 0.5,
+    double var_transformation_catch = 0.1,
+    torch::Tensor ar = torch::tensor({0.3, 0.1}, torch::kDouble),
+    torch::Tensor arch = torch::tensor({0.2}, torch::kDouble)
+) {
+    ShapelyParameter null_param;
+    null_param.enable = false;
+
+    bool positive_variance = var_transformation_crimp == 0.0;
+    ShapelyParameter mu = {torch::full({1}, 0.2, torch::kDouble), -10.0, 10.0, 1.0, 1.0};
+    ShapelyParameter ar_param = {std::move(ar), -1.0, 1.0, 1.0, 1.0};
+    ShapelyParameter sigma2 = {torch::full({1}, 0.8, torch::kDouble), positive_variance ? 0.0 : -10.0, 10.0, 1.0, 1.0};
+    ShapelyParameter arch_param = null_param;
+    if (arch.defined()) {
+        arch_param = {std::move(arch), positive_variance ? 0.0 : -1.0, 1.0, 1.0, 1.0};
+    }
+
+    NamedShapelyParameters sp = {{
+        {"mu", mu},
+        {"mean_exogenous_coef", null_param},
+        {"ar", ar_param},
+        {"sigma2", sigma2},
+        {"var_exogenous_coef", null_param},
+        {"arch", arch_param}
+    }};
+
+    auto regressand_name = torch::zeros({2}, torch::kChar);
+    regressand_name.index_put_({0}, static_cast<int64_t>('X'));
+
+    Buffers b = {{
+        torch::full({}, var_transformation_crimp, torch::kDouble),
+        torch::full({}, var_transformation_catch, torch::kDouble),
+        regressand_name
+    }};
+
+    return ManufactureARARCHTX(sp, b);
+}
+
+// An Ensemble of two ARARCHTX models of the series "X", whose weights and
+// components are both optimised.
+inline std::shared_ptr<ProbabilisticModule> make_ensemble(bool optimise_components = true) {
+    std::vector<std::shared_ptr<ProbabilisticModule>> components = {
+        make_ararchtx(),
+        make_ararchtx(0.5, 0.1, torch::tensor({0.1}, torch::kDouble), torch::tensor({0.3}, torch::kDouble))
+    };
+
+    ShapelyParameter weights = {torch::tensor({0.4, 0.6}, torch::kDouble), 0.0, 1.0, 1.0, 1.0};
+
+    NamedShapelyParameters sp = {{
+        {"weights", weights}
+    }};
+
+    Buffers b = {{
+        torch::full({}, true, torch::kBool),    // optimise_weights
+        torch::full({}, false, torch::kBool),   // fixed_weights
+        torch::full({}, optimise_components, torch::kBool),     // optimise_components
+        torch::full({}, !optimise_components, torch::kBool)     // fixed_components
+    }};
+
+    return ManufactureEnsemble(std::move(components), sp, b);
+}
+
+// num_draws small perturbations of the parameters of model that are not fixed.
+inline CollapsedTensor<std::string> perturbed_parameters(const ProbabilisticModule& model, int64_t num_draws) {
+    torch::OrderedDict<std::string, torch::Tensor> parameters;
+    for (const auto& item : model.named_parameters(/*recurse=*/true, /*include_fixed=*/false)) {
+        parameters.insert(item.key(), item.value().detach().reshape({-1}));
+    }
+    auto collapsed = collapse_vector(parameters);
+    auto p = collapsed.tensor.size(0);
+    collapsed.tensor = collapsed.tensor.unsqueeze(0).repeat({num_draws, 1})
+        + 0.01*torch::normal(0.0, 1.0, {num_draws, p}, c10::nullopt, torch::kDouble);
+    return collapsed;
+}
+
+// A clone of model with the parameters in row draw of parameters.
+inline std::shared_ptr<ProbabilisticModule> clone_with_draw(
+    const ProbabilisticModule& model,
+    const CollapsedTensor<std::string>& parameters,
+    int64_t draw
+) {
+    auto out = model.clone_probabilistic_module();
+    torch::OrderedDict<std::string, torch::Tensor> draw_parameters;
+    for (const auto& item : out->named_parameters(/*recurse=*/true, /*include_fixed=*/true)) {
+        const auto *index = parameters.indices.find(item.key());
+        if (index) {
+            draw_parameters.insert(item.key(), parameters.tensor.index({draw, *index}).reshape(item.value().sizes()).clone());
+        }
+    }
+    out->set_parameters(draw_parameters);
+    return out;
+}
+
+#endif
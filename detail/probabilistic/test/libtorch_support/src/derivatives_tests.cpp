@@ -1,4 +1,5 @@
 #include <cmath>
+#include <string>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/data/test_case.hpp>
 #include <torch/torch.h>
@@ -123,3 +124,75 @@ BOOST_DATA_TEST_CASE(
 
 }
 
+
+BOOST_AUTO_TEST_CASE(jacobian_shared_test) {
+    torch::Tensor a = torch::rand({3}, torch::requires_grad().dtype(torch::kDouble));
+    torch::Tensor b = torch::rand({2, 2}, torch::requires_grad().dtype(torch::kDouble));
+    torch::Tensor unused = torch::rand({2}, torch::requires_grad().dtype(torch::kDouble));
+    torch::OrderedDict<std::string, torch::Tensor> x;
+    x.insert("a", a);
+    x.insert("b", b);
+    x.insert("unused", unused);
+
+    // y[i][j] = a[i]^3*b[j].sum()
+    torch::Tensor y = a.pow(3).unsqueeze(1)*b.sum(1).unsqueeze(0);
+
+    for (auto mode : {JacobianMode::Forward, JacobianMode::Reverse}) {
+        auto dydx = jacobian(y, x, mode, /*create_graph=*/true, /*allow_unused=*/true);
+        for (const auto& item : x) {
+            auto expected = jacobian(y, item.value(), mode, false, true);
+            BOOST_TEST(torch::allclose(dydx[item.key()].detach(), expected));
+        }
+        BOOST_TEST(static_cast<torch::Tensor>(dydx["unused"].eq(0.0).all()).item<bool>());
+
+        // The second derivatives need the grad_output of the first backward
+        // passes, so check they survive them.
+        auto d2ydada = jacobian(dydx["a"], a, mode);
+        auto expected = torch::zeros({3, 2, 3, 3}, torch::kDouble);
+        auto a_detach = a.detach();
+        auto b_sums = b.detach().sum(1);
+        for (int64_t i = 0; i != 3; ++i) {
+            for (int64_t j = 0; j != 2; ++j) {
+                expected.index_put_({i, j, i, i}, 6.0*a_detach[i]*b_sums[j]);
+            }
+        }
+        BOOST_TEST(torch::allclose(d2ydada, expected));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hessian_test) {
+    torch::Tensor a = torch::rand({3}, torch::requires_grad().dtype(torch::kDouble));
+    torch::Tensor b = torch::rand({2, 2}, torch::requires_grad().dtype(torch::kDouble));
+    torch::Tensor linear = torch::rand({2}, torch::requires_grad().dtype(torch::kDouble));
+    torch::Tensor unused = torch::rand({2}, torch::requires_grad().dtype(torch::kDouble));
+    torch::OrderedDict<std::string, torch::Tensor> x;
+    x.insert("a", a);
+    x.insert("linear", linear);
+    x.insert("b", b);
+    x.insert("unused", unused);
+
+    torch::Tensor y = (a.pow(3).sum()*b.exp().sum()).log() + linear.sum() + (a.unsqueeze(1)*b.sum(0)).sin().sum();
+
+    torch::OrderedDict<std::string, torch::Tensor> gradient;
+    auto hess = hessian(y, x, &gradient, /*allow_unused=*/true);
+    auto expected_gradient = jacobian(y, x, JacobianMode::Reverse, /*create_graph=*/true, /*allow_unused=*/true);
+
+    for (const auto& item_i : x) {
+        const auto& key_i = item_i.key();
+        const auto& expected_gradient_i = expected_gradient[key_i];
+        BOOST_TEST(!gradient[key_i].requires_grad());
+        BOOST_TEST(torch::allclose(gradient[key_i], expected_gradient_i.detach()));
+        for (const auto& item_j : x) {
+            const auto& key_j = item_j.key();
+            // The gradients for linear and unused are constants, so their rows are zero.
+            auto expected_hess_ij = expected_gradient_i.requires_grad() ?
+                jacobian(expected_gradient_i, item_j.value(), JacobianMode::Reverse, false, true) :
+                torch::zeros(hess[key_i][key_j].sizes(), torch::kDouble);
+            BOOST_TEST(torch::allclose(hess[key_i][key_j], expected_hess_ij));
+        }
+    }
+
+    // The diagonal blocks are exactly symmetric.
+    auto hess_b_b = hess["b"]["b"].reshape({4, 4});
+    BOOST_TEST(torch::equal(hess_b_b, hess_b_b.t()));
+}
@@ -0,0 +1,53 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/masked.hpp>
+#include <libtorch_support/missing.hpp>
+#include <seed_torch_rng.hpp>
+
+BOOST_AUTO_TEST_CASE(masked_handle_na_test) {
+    seed_torch_rng();
+
+    auto x = torch::normal(0.0, 1.0, {4, 6}, c10::nullopt, torch::kDouble);
+    x.index_put_({1, 2}, missing::na);
+    x.index_put_({3, 0}, missing::na);
+    auto s = (torch::rand({6}, torch::kDouble) + 0.5).requires_grad_();
+    auto c = torch::normal(0.0, 1.0, {6}, c10::nullopt, torch::requires_grad().dtype(torch::kDouble));
+
+    // Elementwise.
+    auto elementwise_op = [](const torch::Tensor& a, const torch::Tensor& b) {
+        return (a - b).square()/b - b.log();
+    };
+    auto expected = missing::handle_na(elementwise_op, x, s);
+    auto masked = missing::handle_na_elementwise(elementwise_op, x, s);
+    BOOST_TEST(torch::equal(missing::isna(expected), missing::isna(masked)));
+    BOOST_TEST(static_cast<torch::Tensor>(expected - masked).abs().max().lt(1e-12).item<bool>());
+    auto expected_grad = torch::autograd::grad({expected.sum()}, {s}).at(0);
+    auto masked_grad = torch::autograd::grad({masked.sum()}, {s}).at(0);
+    BOOST_TEST(static_cast<torch::Tensor>(expected_grad - masked_grad).abs().max().lt(1e-9).item<bool>());
+
+    // Matrix by vector.
+    expected = missing::handle_na(torch::matmul, x, c);
+    masked = missing::handle_na_matmul(x, c);
+    BOOST_TEST(torch::equal(missing::isna(expected), missing::isna(masked)));
+    BOOST_TEST(static_cast<torch::Tensor>(expected - masked).abs().max().lt(1e-12).item<bool>());
+    expected_grad = torch::autograd::grad({expected.sum()}, {c}).at(0);
+    masked_grad = torch::autograd::grad({masked.sum()}, {c}).at(0);
+    BOOST_TEST(static_cast<torch::Tensor>(expected_grad - masked_grad).abs().max().lt(1e-9).item<bool>());
+
+    // Matrix by matrix.
+    auto y = x.t().clone();
+    expected = missing::handle_na(torch::matmul, x, y);
+    masked = missing::handle_na_matmul(x, y);
+    BOOST_TEST(torch::equal(missing::isna(expected), missing::isna(masked)));
+    BOOST_TEST(static_cast<torch::Tensor>(expected - masked).abs().max().lt(1e-12).item<bool>());
+
+    // Reduction over the last dimension.
+    expected = missing::handle_na([](const torch::Tensor& a) { return a.logsumexp({-1}); }, x);
+    masked = missing::reduce(
+        [](const torch::Tensor& a, int64_t dim) { return a.logsumexp({dim}); },
+        missing::MaskedTensor(x),
+        -1
+    ).to_na();
+    BOOST_TEST(torch::equal(missing::isna(expected), missing::isna(masked)));
+    BOOST_TEST(static_cast<torch::Tensor>(expected - masked).abs().max().lt(1e-12).item<bool>());
+}
@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <libtorch_support/moments.hpp>
+#include <libtorch_support/time_series.hpp>
+#include <seed_torch_rng.hpp>
+
+BOOST_AUTO_TEST_CASE(lagged_cross_covariance_matrices_test) {
+    seed_torch_rng();
+
+    int64_t t_dim = 1;
+    auto x = torch::normal(0.0, 1.0, {2, 30, 3}, c10::nullopt, torch::kDouble);
+    x.index_put_({torch::rand({2, 30, 3}, torch::kDouble).lt(0.2)}, missing::na);
+    // A column missing at all but the last few times, so that some lags
+    // have no pairs at all.
+    x.index_put_({torch::indexing::Slice(), torch::indexing::Slice(0, 26), 2}, missing::na);
+
+    int64_t num_lags = 6;
+    auto covariances = lagged_cross_covariance_matrices(x, t_dim, num_lags);
+    BOOST_TEST(covariances.size(0) == num_lags);
+    for (int64_t j = 0; j != num_lags; ++j) {
+        auto expected = cross_covariance_matrix(x, lag(x, t_dim, j));
+        auto actual = covariances[j];
+        BOOST_TEST(torch::equal(missing::isna(expected), missing::isna(actual)));
+        BOOST_TEST(static_cast<torch::Tensor>(expected - actual).abs().max().lt(1e-12).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(truncated_kernel_asymptotic_covariance_matrix_test) {
+    seed_torch_rng();
+
+    int64_t t_dim = 0;
+    torch::OrderedDict<std::string, torch::Tensor> x;
+    x.insert("a", torch::normal(0.0, 1.0, {50, 2}, c10::nullopt, torch::kDouble));
+    x.insert("b", torch::normal(0.0, 1.0, {50, 3}, c10::nullopt, torch::kDouble));
+    x["b"].index_put_({torch::indexing::Slice(0, 10)}, missing::na);
+    x["b"].index_put_({torch::indexing::Slice(), 2}, missing::na);
+
+    auto actual = truncated_kernel_asymptotic_covariance_matrix(x, t_dim);
+
+    // The lags run up to the square root of the sample size, 50.
+    auto expected = cross_covariance_matrix(x, x);
+    for (int64_t j = 1; j != 7; ++j) {
+        auto lag_multiplier = (50.0 - j)/50.0;
+        auto cov_x_x_lagged_t = cross_covariance_matrix(x, lag(x, t_dim, j));
+        expected += lag_multiplier*(cov_x_x_lagged_t + transpose(cov_x_x_lagged_t));
+    }
+
+    for (const auto& item_i : expected) {
+        for (const auto& item_j : item_i.value()) {
+            const auto& actual_ij = actual[item_i.key()][item_j.key()];
+            BOOST_TEST(torch::equal(missing::isna(item_j.value()), missing::isna(actual_ij)));
+            BOOST_TEST(static_cast<torch::Tensor>(item_j.value() - actual_ij).abs().max().lt(1e-12).item<bool>());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(truncated_kernel_num_lags_test) {
+    // Values below one, which the lag count was once taken from, would give
+    // no lags beyond lag zero. The sample size, 16, gives four.
+    int64_t t_dim = 0;
+    torch::OrderedDict<std::string, torch::Tensor> x;
+    x.insert("a", torch::linspace(-1.0, 1.0, 16, torch::kDouble).reshape({16, 1}));
+
+    torch::OrderedDict<std::string, std::vector<torch::indexing::TensorIndex>> index_set;
+    index_set.insert("a", {torch::indexing::Slice()});
+    BOOST_TEST(truncated_kernel_num_lags(sample_size(x, index_set)) == 4);
+
+    // The series is a trend, so its autocovariances at lags one, two and
+    // three are all far from zero, and the covariance must include them.
+    auto actual = truncated_kernel_asymptotic_covariance_matrix(x, t_dim)["a"]["a"];
+    auto expected = cross_covariance_matrix(x, x)["a"]["a"];
+    for (int64_t j = 1; j != 4; ++j) {
+        auto cov_x_x_lagged_t = cross_covariance_matrix(x, lag(x, t_dim, j))["a"]["a"];
+        expected = expected + (16.0 - j)/16.0*(cov_x_x_lagged_t + cov_x_x_lagged_t.t());
+    }
+    BOOST_TEST(static_cast<torch::Tensor>(expected - actual).abs().max().lt(1e-12).item<bool>());
+    BOOST_TEST(static_cast<torch::Tensor>(actual - cross_covariance_matrix(x, x)["a"]["a"]).abs().max().gt(1e-3).item<bool>());
+}
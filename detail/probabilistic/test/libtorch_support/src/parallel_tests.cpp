@@ -0,0 +1,33 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/parallel.hpp>
+
+BOOST_AUTO_TEST_CASE(parallel_for_test) {
+    int64_t n = 100;
+
+    // Each task runs exactly once, whatever the number of workers.
+    for (int64_t num_workers : {1, 2, 7, 200}) {
+        std::vector<std::atomic<int>> calls(n);
+        for (auto& c : calls) { c = 0; }
+        parallel_for(n, num_workers, 1, [&](int64_t i) { ++calls.at(i); });
+        for (const auto& c : calls) {
+            BOOST_TEST(c == 1);
+        }
+    }
+
+    // Tensor results come back in input order.
+    std::vector<torch::Tensor> out(n);
+    parallel_for(n, 4, 0, [&](int64_t i) {
+        out.at(i) = torch::full({}, static_cast<double>(i), torch::kDouble);
+    });
+    BOOST_TEST(torch::equal(torch::stack(out), torch::arange(n, torch::kDouble)));
+
+    // Exceptions are rethrown on the calling thread.
+    BOOST_CHECK_THROW(
+        parallel_for(n, 4, 1, [](int64_t i) { if (i == 50) { throw std::runtime_error("task 50"); } }),
+        std::runtime_error
+    );
+}
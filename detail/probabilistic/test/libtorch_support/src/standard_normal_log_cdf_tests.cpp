@@ -4,6 +4,7 @@
 #include <libtorch_support/standard_normal_log_cdf.hpp>
 #include <seed_torch_rng.hpp>
 
+#include <cmath>
 #include <iostream>
 
 constexpr double n_sqrt2_inv = -0.7071067811865475244008443621048490392848359376884740365883398689;
@@ -20,3 +21,23 @@ BOOST_AUTO_TEST_CASE(standard_normal_log_cdf_test) {
     BOOST_TEST(static_cast<torch::Tensor>((grad_log_cdf_stable - grad_log_cdf_unstable).abs().sum().lt(1e-6)).item<bool>());
 }
 
+
+BOOST_AUTO_TEST_CASE(standard_normal_log_cdf_tails_test) {
+    auto z = torch::tensor({-40.0, -5.0, 0.0, 5.0, 40.0}, torch::requires_grad().dtype(torch::kDouble));
+    auto log_cdf = standard_normal_log_cdf(z);
+
+    // log Phi(z) ~ -z^2/2 - log(-z) - log(2 pi)/2 far in the lower tail, and 0 far in the upper.
+    BOOST_TEST(std::abs(log_cdf[0].item<double>() - (-800.0 - std::log(40.0) - 0.5*std::log(2.0*std::acos(-1.0)) + std::log1p(-1.0/1600.0 + 3.0/(1600.0*1600.0)))) < 1e-6);
+    BOOST_TEST(std::abs(log_cdf[2].item<double>() - std::log(0.5)) < 1e-12);
+    BOOST_TEST(log_cdf[4].item<double>() == 0.0);
+    BOOST_TEST(static_cast<torch::Tensor>(log_cdf.isfinite().all()).item<bool>());
+
+    // Second derivatives, of which the first is phi/Phi, and the second -phi/Phi(z + phi/Phi).
+    auto first = torch::autograd::grad({log_cdf.sum()}, {z}, {}, true, true).at(0);
+    auto second = torch::autograd::grad({first.sum()}, {z}).at(0);
+    BOOST_TEST(static_cast<torch::Tensor>((second + first.detach()*(z.detach() + first.detach())).abs().max().lt(1e-8)).item<bool>());
+    BOOST_TEST(static_cast<torch::Tensor>(second.le(0.0).all()).item<bool>());
+
+    auto with_na = standard_normal_log_cdf(torch::tensor({std::nan(""), 1.0}, torch::kDouble));
+    BOOST_TEST(std::isnan(with_na[0].item<double>()));
+}
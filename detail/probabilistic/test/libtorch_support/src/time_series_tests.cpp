@@ -0,0 +1,34 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <libtorch_support/time_series.hpp>
+
+BOOST_AUTO_TEST_CASE(time_series_take_times_test) {
+    auto x = torch::arange(10, torch::kDouble).reshape({2, 5});
+    auto times = torch::tensor({0, 1, 2, -1, 4, 3, 5, 2}, torch::kLong).reshape({2, 4});
+
+    auto y = take_times(x, times);
+    BOOST_REQUIRE(y.sizes() == torch::IntArrayRef({2, 2, 4}));
+    for (int64_t b = 0; b != 2; ++b) {
+        for (int64_t i = 0; i != 2; ++i) {
+            for (int64_t j = 0; j != 4; ++j) {
+                auto t = times[b][j].item<int64_t>();
+                if (t < 0 || t >= 5) {
+                    BOOST_TEST(missing::isna(y[b][i][j].item<double>()));
+                } else {
+                    BOOST_TEST(y[b][i][j].item<double>() == x[i][t].item<double>());
+                }
+            }
+        }
+    }
+
+    // Along a time dimension other than the last.
+    auto y_t = take_times(x.t(), times, 0);
+    BOOST_REQUIRE(y_t.sizes() == torch::IntArrayRef({2, 4, 2}));
+    BOOST_TEST(torch::equal(missing::isna(y_t), missing::isna(y.transpose(1, 2))));
+    BOOST_TEST(torch::equal(y_t.masked_fill(missing::isna(y_t), 0.0), y.transpose(1, 2).masked_fill(missing::isna(y.transpose(1, 2)), 0.0)));
+
+    // A single resample keeps the shape of x.
+    auto y_1 = take_times(x, times[0]);
+    BOOST_TEST(y_1.sizes() == torch::IntArrayRef({2, 4}));
+}
@@ -2,11 +2,15 @@
 #include <torch/torch.h>
 #include <libtorch_support/derivatives.hpp>
 #include <libtorch_support/logsubexp.hpp>
+#include <libtorch_support/missing.hpp>
 #include <modelling/distribution/Normal.hpp>
 #include <modelling/distribution/Mixture.hpp>
+#include <modelling/score/TickScore.hpp>
 #include <seed_torch_rng.hpp>
 #include <cmath>
 #include <memory>
+#include <stdexcept>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE(mixture_test) {
     seed_torch_rng();
@@ -47,3 +51,205 @@ BOOST_AUTO_TEST_CASE(mixture_test) {
     BOOST_TEST(static_cast<torch::Tensor>(X_logccdf_x - X_ccdf_x.log()).abs().sum().lt(1e-6).item<bool>());
 }
 
+
+BOOST_AUTO_TEST_CASE(mixture_component_cache_test) {
+    seed_torch_rng();
+
+    auto mean_1 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble);
+    auto std_dev_1 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square();
+    std::shared_ptr<Distribution> X1 = ManufactureNormal({{"X", mean_1}}, {{"X", std_dev_1}});
+
+    auto mean_2 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble);
+    auto std_dev_2 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square();
+    std::shared_ptr<Distribution> X2 = ManufactureNormal({{"X", mean_2}}, {{"X", std_dev_2}});
+
+    auto x = ManufactureMixture({X1, X2}, torch::full({2}, 0.5, torch::kDouble))->draw();
+    auto cache = std::make_shared<MixtureComponentCache>(std::vector<std::shared_ptr<Distribution>>{X1, X2}, x);
+    BOOST_TEST(cache->is_cached(x));
+    BOOST_TEST(!cache->is_cached({{"X", x[0].value().clone()}}));
+
+    // Reuse the cache across different weights, as when fitting the weights alone.
+    for (double w : {0.5, 0.1, 0.9}) {
+        auto weights = torch::tensor({w, 1.0 - w}, torch::kDouble);
+        auto X = ManufactureMixture({X1, X2}, weights);
+        auto X_cached = ManufactureMixture(cache, weights);
+
+        BOOST_TEST(static_cast<torch::Tensor>(X->log_density(x)[0].value() - X_cached->log_density(x)[0].value()).abs().sum().lt(1e-12).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>(X->cdf(x)[0].value() - X_cached->cdf(x)[0].value()).abs().sum().lt(1e-12).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>(
+            X->log_interval_probability(-0.5, 1.0)[0].value() - X_cached->log_interval_probability(-0.5, 1.0)[0].value()
+        ).abs().sum().lt(1e-12).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>(
+            X->log_interval_complement_probability(-0.5, 1.0)[0].value() - X_cached->log_interval_complement_probability(-0.5, 1.0)[0].value()
+        ).abs().sum().lt(1e-12).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mixture_quantile_test) {
+    seed_torch_rng();
+
+    auto mean_1 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble);
+    auto std_dev_1 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square() + 0.1;
+    std::shared_ptr<Distribution> X1 = ManufactureNormal({{"X", mean_1}}, {{"X", std_dev_1}});
+
+    auto mean_2 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble) + 3.0;
+    auto std_dev_2 = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square() + 0.1;
+    std::shared_ptr<Distribution> X2 = ManufactureNormal({{"X", mean_2}}, {{"X", std_dev_2}});
+
+    auto weights = torch::tensor({0.3, 0.7}, torch::requires_grad().dtype(torch::kDouble));
+    auto X = ManufactureMixture({X1, X2}, weights);
+
+    // cdf(quantile(p)) = p, for each element at once.
+    auto p = torch::rand({10}, torch::kDouble)*0.98 + 0.01;
+    p.index_put_({4}, missing::na);
+    auto q = X->quantile({{"X", p}})[0].value();
+    BOOST_TEST(missing::isna(q[4].item<double>()));
+    auto q_present = torch::cat({q.slice(0, 0, 4), q.slice(0, 5)});
+    auto p_present = torch::cat({p.slice(0, 0, 4), p.slice(0, 5)});
+    auto cdf_q = X->cdf({{"X", q.detach()}})[0].value().detach();
+    BOOST_TEST(static_cast<torch::Tensor>(torch::cat({cdf_q.slice(0, 0, 4), cdf_q.slice(0, 5)}) - p_present).abs().max().lt(1e-10).item<bool>());
+
+    // The gradient with respect to the weights matches finite differences.
+    auto grad = torch::autograd::grad({q_present.sum()}, {weights}).at(0);
+    double eps = 1e-6;
+    auto q_shifted = ManufactureMixture({X1, X2}, torch::tensor({0.3 + eps, 0.7}, torch::kDouble))->quantile({{"X", p}})[0].value().detach();
+    auto finite_difference = (torch::cat({q_shifted.slice(0, 0, 4), q_shifted.slice(0, 5)}) - q_present.detach()).sum()/eps;
+    BOOST_TEST(static_cast<torch::Tensor>(grad[0] - finite_difference).abs().lt(1e-4).item<bool>());
+
+    // Coincident components have every component quantile at the same finite
+    // value, and the gradient with respect to them still matches finite
+    // differences.
+    auto mean_same = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).requires_grad_();
+    auto std_dev_same = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square() + 0.1;
+    std::shared_ptr<Distribution> Y = ManufactureNormal({{"X", mean_same}}, {{"X", std_dev_same}});
+    auto p_same = torch::rand({10}, torch::kDouble)*0.98 + 0.01;
+    auto q_same = ManufactureMixture({Y, Y}, torch::tensor({0.3, 0.7}, torch::kDouble))->quantile({{"X", p_same}})[0].value();
+    auto grad_same = torch::autograd::grad({q_same.sum()}, {mean_same}).at(0);
+    std::shared_ptr<Distribution> Y_shifted = ManufactureNormal({{"X", mean_same.detach() + eps}}, {{"X", std_dev_same}});
+    auto q_same_shifted = ManufactureMixture({Y_shifted, Y_shifted}, torch::tensor({0.3, 0.7}, torch::kDouble))->quantile({{"X", p_same}})[0].value().detach();
+    auto finite_difference_same = (q_same_shifted - q_same.detach())/eps;
+    BOOST_TEST(static_cast<torch::Tensor>(grad_same - finite_difference_same).abs().max().lt(1e-4).item<bool>());
+
+    // So tick scores of mixtures are defined.
+    auto x = X->draw();
+    auto tick_score = ManufactureTickScore(0.1)->score(*X, x)[0].value();
+    BOOST_TEST(static_cast<torch::Tensor>(tick_score.isfinite().all()).item<bool>());
+}
+
+BOOST_AUTO_TEST_CASE(mixture_of_normals_test) {
+    seed_torch_rng();
+
+    std::vector<std::shared_ptr<Distribution>> components;
+    for (int64_t k = 0; k != 3; ++k) {
+        auto mean_k = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble) + k;
+        auto std_dev_k = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square() + 0.1;
+        components.emplace_back(ManufactureNormal({{"X", mean_k}}, {{"X", std_dev_k}}));
+    }
+    auto weights = torch::tensor({0.2, 0.3, 0.5}, torch::kDouble);
+
+    auto X = ManufactureMixture(components, weights);
+    auto X_fused = ManufactureMixtureOfNormals(components, weights);
+
+    auto x = X->draw();
+    x[0].value().index_put_({3}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> lb = {{"X", x[0].value() - 0.5}};
+
+    auto agrees = [](const torch::Tensor& lhs, const torch::Tensor& rhs) {
+        auto both_na = missing::isna(lhs).logical_and(missing::isna(rhs));
+        return static_cast<torch::Tensor>((lhs - rhs).abs().lt(1e-10).logical_or(both_na).all()).item<bool>();
+    };
+
+    BOOST_TEST(agrees(X->density(x)[0].value(), X_fused->density(x)[0].value()));
+    BOOST_TEST(agrees(X->log_density(x)[0].value(), X_fused->log_density(x)[0].value()));
+    BOOST_TEST(agrees(X->cdf(x)[0].value(), X_fused->cdf(x)[0].value()));
+    BOOST_TEST(agrees(X->log_cdf(x)[0].value(), X_fused->log_cdf(x)[0].value()));
+    BOOST_TEST(agrees(X->ccdf(x)[0].value(), X_fused->ccdf(x)[0].value()));
+    BOOST_TEST(agrees(X->log_ccdf(x)[0].value(), X_fused->log_ccdf(x)[0].value()));
+    BOOST_TEST(agrees(X->interval_probability(lb, x)[0].value(), X_fused->interval_probability(lb, x)[0].value()));
+    BOOST_TEST(agrees(X->log_interval_probability(lb, x)[0].value(), X_fused->log_interval_probability(lb, x)[0].value()));
+    BOOST_TEST(agrees(X->interval_complement_probability(lb, x)[0].value(), X_fused->interval_complement_probability(lb, x)[0].value()));
+    BOOST_TEST(agrees(X->log_interval_complement_probability(lb, x)[0].value(), X_fused->log_interval_complement_probability(lb, x)[0].value()));
+    BOOST_TEST(agrees(X->log_interval_probability(-0.5, 1.0)[0].value(), X_fused->log_interval_probability(-0.5, 1.0)[0].value()));
+    BOOST_TEST(missing::isna(X_fused->log_density(x)[0].value()[3].item<double>()));
+
+    auto p = torch::rand({10}, torch::kDouble)*0.98 + 0.01;
+    BOOST_TEST(static_cast<torch::Tensor>((X->quantile({{"X", p}})[0].value() - X_fused->quantile({{"X", p}})[0].value()).abs().max().lt(1e-8)).item<bool>());
+
+    BOOST_TEST(X_fused->draw()[0].value().sizes() == x[0].value().sizes());
+
+    std::vector<std::shared_ptr<Distribution>> mixed_components = {components.front(), std::shared_ptr<Distribution>(ManufactureMixture(components, weights))};
+    BOOST_CHECK_THROW(ManufactureMixtureOfNormals(mixed_components, torch::full({2}, 0.5, torch::kDouble)), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(mixture_draw_test) {
+    seed_torch_rng();
+
+    // Well separated components, with weights stacked along a leading batch dimension.
+    std::shared_ptr<Distribution> X1 = ManufactureNormal({{"X", torch::zeros({2, 5000}, torch::kDouble)}}, {{"X", torch::ones({2, 5000}, torch::kDouble)}});
+    std::shared_ptr<Distribution> X2 = ManufactureNormal({{"X", torch::full({2, 5000}, 100.0, torch::kDouble)}}, {{"X", torch::ones({2, 5000}, torch::kDouble)}});
+    auto weights = torch::tensor({{0.9, 0.1}, {0.2, 0.8}}, torch::kDouble);
+
+    for (const auto& X : {ManufactureMixture({X1, X2}, weights), ManufactureMixtureOfNormals({X1, X2}, weights)}) {
+        auto x = X->draw()[0].value();
+        BOOST_TEST(x.sizes() == torch::IntArrayRef({2, 5000}));
+        auto second = x.gt(50.0).to(torch::kDouble).mean(1);
+        BOOST_TEST(static_cast<torch::Tensor>((second - torch::tensor({0.1, 0.8}, torch::kDouble)).abs().lt(0.02).all()).item<bool>());
+
+        // Only the elements asked for are drawn, in order.
+        auto mask = torch::zeros({2, 5000}, torch::kBool);
+        mask.index_put_({1, torch::indexing::Slice(0, 100)}, true);
+        auto x_at = X->draw_at({{"X", mask}})[0].value();
+        BOOST_TEST(x_at.sizes() == torch::IntArrayRef({100}));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(evaluate_test) {
+    seed_torch_rng();
+
+    std::vector<std::shared_ptr<Distribution>> components;
+    for (int64_t k = 0; k != 2; ++k) {
+        auto mean_k = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble) + k;
+        auto std_dev_k = torch::normal(0.0, 1.0, {10}, c10::nullopt, torch::kDouble).square() + 0.1;
+        components.emplace_back(ManufactureNormal({{"X", mean_k}}, {{"X", std_dev_k}}));
+    }
+    auto weights = torch::tensor({0.4, 0.6}, torch::kDouble);
+
+    auto x = components.front()->draw();
+    x[0].value().index_put_({2}, missing::na);
+
+    DistributionEvaluationRequest request;
+    request.log_density = true;
+    request.cdf = true;
+    request.log_cdf = true;
+    request.log_ccdf = true;
+    request.log_interval_probability = true;
+    request.log_interval_complement_probability = true;
+    request.open_lower_bound = -0.5;
+    request.closed_upper_bound = 1.0;
+
+    auto agrees = [](const torch::OrderedDict<std::string, torch::Tensor>& lhs, const torch::OrderedDict<std::string, torch::Tensor>& rhs) {
+        const auto& lhs_i = lhs[0].value();
+        const auto& rhs_i = rhs[0].value();
+        auto both_na = missing::isna(lhs_i).logical_and(missing::isna(rhs_i));
+        return static_cast<torch::Tensor>((lhs_i - rhs_i).abs().lt(1e-10).logical_or(both_na).all()).item<bool>();
+    };
+
+    // Each quantity evaluated together agrees with the same quantity evaluated alone.
+    for (const auto& X : {std::shared_ptr<Distribution>(components.front()), std::shared_ptr<Distribution>(ManufactureMixture(components, weights)), std::shared_ptr<Distribution>(ManufactureMixtureOfNormals(components, weights))}) {
+        auto evaluation = X->evaluate(x, request);
+        BOOST_TEST(agrees(evaluation.log_density, X->log_density(x)));
+        BOOST_TEST(agrees(evaluation.cdf, X->cdf(x)));
+        BOOST_TEST(agrees(evaluation.log_cdf, X->log_cdf(x)));
+        BOOST_TEST(agrees(evaluation.log_ccdf, X->log_ccdf(x)));
+        BOOST_TEST(agrees(evaluation.log_interval_probability, X->log_interval_probability(-0.5, 1.0)));
+        BOOST_TEST(agrees(evaluation.log_interval_complement_probability, X->log_interval_complement_probability(-0.5, 1.0)));
+        BOOST_TEST(missing::isna(evaluation.log_density[0].value()[2].item<double>()));
+    }
+
+    // Quantities not asked for are left empty.
+    DistributionEvaluationRequest log_density_only;
+    log_density_only.log_density = true;
+    auto evaluation = components.front()->evaluate(x, log_density_only);
+    BOOST_TEST(evaluation.log_density.size() == 1);
+    BOOST_TEST(evaluation.cdf.is_empty());
+}
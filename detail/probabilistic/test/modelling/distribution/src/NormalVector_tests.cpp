@@ -0,0 +1,33 @@
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <modelling/distribution/NormalVector.hpp>
+#include <seed_torch_rng.hpp>
+
+BOOST_AUTO_TEST_CASE(normal_vector_generate_test) {
+    seed_torch_rng();
+
+    auto mu = torch::normal(0.0, 1.0, {5}, c10::nullopt, torch::kDouble);
+    auto A = torch::normal(0.0, 1.0, {5, 5}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices;
+    indices.insert("a", torch::indexing::Slice(0, 2));
+    indices.insert("b", torch::indexing::Slice(2, 5));
+    auto dist = ManufactureNormalVectorDetail(mu, A, indices);
+
+    auto draws = dist->generate(1000, 0, 0.0);
+    BOOST_TEST(draws["a"].sizes() == torch::IntArrayRef({1000, 2}));
+    BOOST_TEST(draws["b"].sizes() == torch::IntArrayRef({1000, 3}));
+
+    // Each draw is mu + A z, for the corresponding row z of the buffer.
+    auto Z = torch::normal(0.0, 1.0, {4, 5}, c10::nullopt, torch::kDouble);
+    auto from_buffer = dist->generate_from_standard_normal(Z);
+    for (int64_t i = 0; i != 4; ++i) {
+        auto expected = mu + torch::matmul(A, Z[i]);
+        for (const auto& item : indices) {
+            auto difference = from_buffer[item.key()][i] - expected.index({item.value()});
+            BOOST_TEST(static_cast<torch::Tensor>(difference.abs().max()).lt(1e-12).item<bool>());
+        }
+    }
+
+    BOOST_CHECK_THROW(dist->generate_from_standard_normal(torch::zeros({4, 3}, torch::kDouble)), std::logic_error);
+}
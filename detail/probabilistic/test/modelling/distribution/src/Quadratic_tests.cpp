@@ -0,0 +1,107 @@
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <modelling/distribution/Normal.hpp>
+#include <modelling/distribution/NormalVector.hpp>
+#include <modelling/distribution/Quadratic.hpp>
+#include <seed_torch_rng.hpp>
+
+BOOST_AUTO_TEST_CASE(quadratic_generate_test) {
+    seed_torch_rng();
+
+    auto mu = torch::normal(0.0, 1.0, {5}, c10::nullopt, torch::kDouble);
+    auto A = torch::normal(0.0, 1.0, {5, 5}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices;
+    indices.insert("a", torch::indexing::Slice(0, 2));
+    indices.insert("b", torch::indexing::Slice(2, 4));
+    indices.insert("c", 4);
+    std::shared_ptr<Distribution> dist = ManufactureNormalVectorDetail(mu, A, indices);
+
+    // Linear coefficients for b and c only, and no quadratic block for b with b.
+    torch::OrderedDict<std::string, torch::Tensor> linear;
+    linear.insert("b", torch::normal(0.0, 1.0, {2}, c10::nullopt, torch::kDouble));
+    linear.insert("c", torch::normal(0.0, 1.0, {1}, c10::nullopt, torch::kDouble));
+    torch::OrderedDict<std::string, torch::OrderedDict<std::string, torch::Tensor>> quadratic;
+    torch::OrderedDict<std::string, torch::Tensor> quadratic_a;
+    quadratic_a.insert("a", torch::normal(0.0, 1.0, {2, 2}, c10::nullopt, torch::kDouble));
+    quadratic_a.insert("b", torch::normal(0.0, 1.0, {2, 2}, c10::nullopt, torch::kDouble));
+    quadratic.insert("a", quadratic_a);
+
+    double intercept = 0.5;
+    auto Q = ManufactureQuadratic("Q", dist, intercept, linear, quadratic);
+
+    int64_t sample_size = 7;
+    seed_torch_rng();
+    auto draws = Q->generate(sample_size, 0, 0.0)["Q"];
+    BOOST_TEST(draws.sizes() == torch::IntArrayRef({sample_size}));
+
+    // The same draws of dist, with the quadratic form evaluated one draw at a time.
+    seed_torch_rng();
+    auto dist_draws = dist->generate(sample_size, 0, 0.0);
+    for (int64_t i = 0; i != sample_size; ++i) {
+        auto a = dist_draws["a"][i];
+        auto b = dist_draws["b"][i];
+        auto c = dist_draws["c"][i];
+        auto expected = intercept +
+                        torch::dot(b, linear["b"]) +
+                        c*linear["c"][0] +
+                        torch::dot(a, torch::matmul(quadratic_a["a"], a)) +
+                        torch::dot(a, torch::matmul(quadratic_a["b"], b));
+        BOOST_TEST(static_cast<torch::Tensor>((draws[i] - expected).abs()).lt(1e-12).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(quadratic_cumulants_quantile_test) {
+    seed_torch_rng();
+
+    auto mu = torch::normal(0.0, 1.0, {4}, c10::nullopt, torch::kDouble);
+    auto A = 0.5*torch::normal(0.0, 1.0, {4, 4}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::indexing::TensorIndex> indices;
+    indices.insert("a", torch::indexing::Slice(0, 4));
+    std::shared_ptr<Distribution> dist = ManufactureNormalVectorDetail(mu, A, indices);
+
+    torch::OrderedDict<std::string, torch::Tensor> linear;
+    linear.insert("a", torch::normal(0.0, 1.0, {4}, c10::nullopt, torch::kDouble));
+    torch::OrderedDict<std::string, torch::OrderedDict<std::string, torch::Tensor>> quadratic;
+    torch::OrderedDict<std::string, torch::Tensor> quadratic_a;
+    quadratic_a.insert("a", torch::normal(0.0, 1.0, {4, 4}, c10::nullopt, torch::kDouble));
+    quadratic.insert("a", quadratic_a);
+
+    auto Q = ManufactureQuadratic("Q", dist, 0.3, linear, quadratic);
+
+    // The closed-form mean and variance against those of many draws.
+    auto kappa = Q->cumulants(3)["Q"];
+    auto draws = Q->generate(200000, 0, 0.0)["Q"];
+    auto sd = draws.std().item<double>();
+    BOOST_TEST(std::abs(kappa[0].item<double>() - draws.mean().item<double>()) < 0.02*sd);
+    BOOST_TEST(std::abs(kappa[1].item<double>() - draws.var().item<double>()) < 0.02*kappa[1].item<double>());
+
+    // The saddlepoint cdf against the empirical cdf, and quantile as its inverse.
+    for (double p : {0.05, 0.3, 0.7, 0.95}) {
+        auto q = Q->quantile(p)["Q"].item<double>();
+        BOOST_TEST(std::abs(Q->cdf(q)["Q"].item<double>() - p) < 1e-6);
+        BOOST_TEST(std::abs(draws.le(q).to(torch::kDouble).mean().item<double>() - p) < 0.02);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(quadratic_non_gaussian_test) {
+    seed_torch_rng();
+
+    // A Normal is not given as a transformation of standard normal draws, so
+    // the closed-form methods are unavailable, and say why.
+    std::shared_ptr<Distribution> dist = ManufactureNormal(
+        {{"a", torch::zeros({2}, torch::kDouble)}},
+        {{"a", torch::ones({2}, torch::kDouble)}}
+    );
+    torch::OrderedDict<std::string, torch::Tensor> linear;
+    linear.insert("a", torch::ones({2}, torch::kDouble));
+    auto Q = ManufactureQuadratic("Q", dist, 0.0, linear);
+
+    auto mentions_gaussian = [](const std::runtime_error& e) {
+        return std::string(e.what()).find("Gaussian") != std::string::npos;
+    };
+    BOOST_CHECK_EXCEPTION(Q->cumulants(2), std::runtime_error, mentions_gaussian);
+    BOOST_CHECK_EXCEPTION(Q->cdf(0.0), std::runtime_error, mentions_gaussian);
+}
@@ -0,0 +1,37 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/ParameterDraws.hpp>
+#include <modelling/score/LogScore.hpp>
+#include <modelling_test_support/models.hpp>
+#include <seed_torch_rng.hpp>
+#include <memory>
+
+BOOST_AUTO_TEST_CASE(ararchtx_parameter_draws_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {80}, c10::nullopt, torch::kDouble);
+    x.index_put_({30}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    auto log_score = ManufactureLogScore();
+    double barrier_multiplier = 0.5;
+
+    // Draws that perturb the parameters of the model.
+    int64_t num_draws = 4;
+    auto collapsed = perturbed_parameters(*model, num_draws);
+
+    ParameterDraws draws(*model, collapsed);
+    BOOST_TEST(draws.size() == num_draws);
+    auto scores = draws.average_scores(observations, *log_score, barrier_multiplier);
+    BOOST_REQUIRE(scores.sizes() == torch::IntArrayRef({num_draws}));
+
+    for (int64_t i = 0; i != num_draws; ++i) {
+        auto& module_i = draws.module(i);
+        auto score_i = log_score->average(*module_i.forward(observations), observations, module_i.barrier(observations, barrier_multiplier));
+        BOOST_TEST(static_cast<torch::Tensor>(scores[i] - score_i).abs().lt(1e-6).item<bool>());
+    }
+}
@@ -0,0 +1,139 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <libtorch_support/time_series.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/inference/ParametricBootstrap.hpp>
+#include <modelling/inference/MovingBlockBootstrap.hpp>
+#include <modelling/inference/SamplingDistribution.hpp>
+#include <modelling/score/CensoredLogScore.hpp>
+#include <modelling/score/LogScore.hpp>
+#include <modelling_test_support/models.hpp>
+#include <seed_torch_rng.hpp>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(ararchtx_bootstrap_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {120}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    FitPlan plan;
+    plan.maximum_optimiser_iterations = 50;
+    model->fit(observations, ManufactureLogScore(), plan, nullptr);
+
+    int64_t num_replications = 6;
+    std::vector<std::shared_ptr<SamplingDistribution>> sds = {
+        ManufactureParametricBootstrap(model, num_replications, 50, 0.0, 2),
+        ManufactureMovingBlockBootstrap(model, num_replications, 20, 2, 2)
+    };
+
+    int64_t num_draws = 10;
+    for (const auto& sd : sds) {
+        auto draws = sd->get_parameter_distribution()->generate(num_draws, 0, 0.0);
+        auto centered = sd->get_centered_parameter_estimate_distribution()->generate(num_draws, 0, 0.0);
+        for (const auto& item : model->named_parameters(/*recurse=*/true, /*include_fixed=*/false)) {
+            BOOST_REQUIRE(draws.contains(item.key()));
+            BOOST_TEST(draws[item.key()].size(0) == num_draws);
+            BOOST_TEST(draws[item.key()].size(-1) == item.value().reshape({-1}).size(0));
+            BOOST_TEST(static_cast<torch::Tensor>(draws[item.key()].isfinite().all()).item<bool>());
+            BOOST_TEST(centered[item.key()].sizes() == draws[item.key()].sizes());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(moving_block_times_test) {
+    seed_torch_rng();
+
+    int64_t num_replications = 4;
+    int64_t sample_size = 50;
+    int64_t block_size = 7;
+    int64_t gap_size = 2;
+    auto times = moving_block_times(num_replications, sample_size, block_size, gap_size);
+
+    // Eight blocks, the last of one time, with a gap between each.
+    BOOST_REQUIRE(times.sizes() == torch::IntArrayRef({num_replications, sample_size + 7*gap_size}));
+    auto times_a = times.accessor<int64_t, 2>();
+    for (int64_t r = 0; r != num_replications; ++r) {
+        int64_t num_times = 0;
+        int64_t t = 0;
+        while (t != times.size(1)) {
+            // A block: consecutive times of the source series.
+            auto this_block_size = std::min(block_size, sample_size - num_times);
+            auto start = times_a[r][t];
+            BOOST_TEST(start >= 0);
+            BOOST_TEST(start <= sample_size - block_size);
+            for (int64_t i = 0; i != this_block_size; ++i) {
+                BOOST_TEST(times_a[r][t + i] == start + i);
+            }
+            t += this_block_size;
+            num_times += this_block_size;
+
+            // Then a gap, unless the resample is full.
+            if (num_times == sample_size) break;
+            for (int64_t i = 0; i != gap_size; ++i) {
+                BOOST_TEST(times_a[r][t + i] == -1);
+            }
+            t += gap_size;
+        }
+        BOOST_TEST(t == times.size(1));
+        BOOST_TEST(num_times == sample_size);
+    }
+
+    // The resampled series holds the source series at the times, and is
+    // missing in the gaps.
+    auto x = torch::normal(0.0, 1.0, {sample_size}, c10::nullopt, torch::kDouble);
+    auto resampled = take_times(x, times);
+    auto in_block = times.ge(0);
+    BOOST_TEST(torch::equal(resampled.masked_select(in_block), x.index({times.masked_select(in_block)})));
+    BOOST_TEST(static_cast<torch::Tensor>(missing::isna(resampled).eq(in_block.logical_not()).all()).item<bool>());
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_bootstrap_num_threads_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {120}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    // ARARCHTX has no kernel for stacked parameters with the censored log
+    // score, so the refits are fit separately, on the threads.
+    std::shared_ptr<const ScoringRule> scoring_rule = ManufactureCensoredLogScore(-2.0, 2.0);
+    FitPlan plan;
+    plan.maximum_optimiser_iterations = 50;
+    model->fit(observations, scoring_rule, plan, nullptr);
+
+    int64_t num_replications = 5;
+    seed_torch_rng();
+    auto replicate_observations = model->draw_replicate_observations(num_replications, 120, 50, 0.0);
+    std::vector<char> success_serial;
+    auto serial = model->fit_replications(replicate_observations, scoring_rule, plan, &success_serial, 1);
+    std::vector<char> success_threaded;
+    auto threaded = model->fit_replications(replicate_observations, scoring_rule, plan, &success_threaded, 3);
+    BOOST_TEST(success_serial == success_threaded);
+    for (int64_t r = 0; r != num_replications; ++r) {
+        auto parameters_threaded = threaded.at(r)->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
+        for (const auto& item : serial.at(r)->named_parameters(/*recurse=*/true, /*include_fixed=*/false)) {
+            BOOST_TEST(torch::equal(item.value(), parameters_threaded[item.key()]));
+        }
+    }
+
+    // The same holds for the sampling distribution the refits give.
+    int64_t num_draws = 10;
+    seed_torch_rng();
+    auto sd_serial = ManufactureParametricBootstrap(model, num_replications, 50, 0.0, 1);
+    seed_torch_rng();
+    auto draws_serial = sd_serial->get_parameter_distribution()->generate(num_draws, 0, 0.0);
+    seed_torch_rng();
+    auto sd_threaded = ManufactureParametricBootstrap(model, num_replications, 50, 0.0, 3);
+    seed_torch_rng();
+    auto draws_threaded = sd_threaded->get_parameter_distribution()->generate(num_draws, 0, 0.0);
+    for (const auto& item : draws_serial) {
+        BOOST_TEST(torch::equal(item.value(), draws_threaded[item.key()]));
+    }
+}
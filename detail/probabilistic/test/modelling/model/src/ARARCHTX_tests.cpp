@@ -0,0 +1,150 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <modelling/missingness_index.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/model/ARARCHTX.hpp>
+#include <modelling/score/LogScore.hpp>
+#include <modelling_test_support/models.hpp>
+#include <seed_torch_rng.hpp>
+#include <memory>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(ararchtx_fused_average_score_test) {
+    seed_torch_rng();
+
+    for (double vtcrimp : {0.0, 0.5}) {
+        std::shared_ptr<ProbabilisticModule> model = make_ararchtx(vtcrimp, 0.1, torch::tensor({0.3, 0.2, 0.1}, torch::kDouble), torch::tensor({0.2, 0.1}, torch::kDouble));
+
+        auto x = torch::normal(0.0, 1.0, {60}, c10::nullopt, torch::kDouble);
+        x.index_put_({20}, missing::na);
+        x.index_put_({41}, missing::na);
+        torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+        auto log_score = ManufactureLogScore();
+        double barrier_multiplier = 0.5;
+
+        auto parameters = model->parameters();
+
+        auto fused = model->fused_average_score(observations, *log_score, barrier_multiplier);
+        BOOST_REQUIRE(fused.defined());
+        auto fused_grad = torch::autograd::grad({fused}, parameters);
+
+        auto unfused = log_score->average(*model->forward(observations), observations, model->barrier(observations, barrier_multiplier));
+        auto unfused_grad = torch::autograd::grad({unfused}, parameters);
+
+        // The barrier in ARARCHTX::barrier is single precision.
+        BOOST_TEST(static_cast<torch::Tensor>(fused - unfused).abs().lt(1e-6).item<bool>());
+        for (decltype(parameters.size()) i = 0; i != parameters.size(); ++i) {
+            BOOST_TEST(static_cast<torch::Tensor>(fused_grad.at(i) - unfused_grad.at(i)).abs().max().lt(1e-6).item<bool>());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_fit_replications_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    int64_t num_replications = 3;
+    auto x = torch::normal(0.0, 1.0, {num_replications, 80}, c10::nullopt, torch::kDouble);
+    x.index_put_({1, 30}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    auto log_score = ManufactureLogScore();
+    double barrier_multiplier = 0.5;
+
+    // Stacked parameters, with distinct rows, score each replication as its own module would.
+    auto stacked = model->clone_probabilistic_module();
+    auto stacked_parameters = stacked->parameters();
+    {
+        torch::NoGradGuard no_grad;
+        for (auto& p : stacked_parameters) {
+            std::vector<int64_t> repeats(p.dim() + 1, 1);
+            repeats.front() = num_replications;
+            auto rows = p.detach().unsqueeze(0).repeat(repeats);
+            p.set_data(rows + 0.01*torch::arange(num_replications, torch::kDouble).reshape({-1, 1}));
+        }
+    }
+    auto scores = stacked->fused_average_scores(observations, *log_score, barrier_multiplier);
+    BOOST_REQUIRE(scores.defined());
+    BOOST_TEST(scores.sizes() == torch::IntArrayRef({num_replications}));
+    for (int64_t r = 0; r != num_replications; ++r) {
+        auto model_r = model->clone_probabilistic_module();
+        auto parameters_r = model_r->parameters();
+        {
+            torch::NoGradGuard no_grad;
+            for (decltype(parameters_r.size()) i = 0; i != parameters_r.size(); ++i) {
+                parameters_r.at(i).set_data(stacked_parameters.at(i).detach().select(0, r).clone());
+            }
+        }
+        torch::OrderedDict<std::string, torch::Tensor> observations_r = {{"X", x.select(0, r)}};
+        auto score_r = model_r->fused_average_score(observations_r, *log_score, barrier_multiplier);
+        BOOST_TEST(static_cast<torch::Tensor>(scores.index({r}) - score_r).abs().lt(1e-6).item<bool>());
+    }
+
+    // Each replication's fit lands where a fit to that replication alone does.
+    FitPlan plan;
+    plan.barrier_begin = 1e-3;
+    plan.barrier_end = 1e-3;
+    plan.tolerance_change = 1e-12;
+    plan.maximum_optimiser_iterations = 500;
+    std::vector<char> success;
+    auto fit_models = model->fit_replications(observations, log_score, plan, &success);
+    BOOST_REQUIRE(fit_models.size() == static_cast<size_t>(num_replications));
+    BOOST_REQUIRE(success.size() == static_cast<size_t>(num_replications));
+    for (int64_t r = 0; r != num_replications; ++r) {
+        BOOST_TEST(success.at(r));
+        torch::OrderedDict<std::string, torch::Tensor> observations_r = {{"X", x.select(0, r)}};
+        auto fit_r = model->clone_probabilistic_module();
+        BOOST_REQUIRE(fit_r->fit(observations_r, log_score, plan, nullptr));
+        auto score_fit = fit_models.at(r)->fused_average_score(observations_r, *log_score, plan.barrier_end);
+        auto score_r = fit_r->fused_average_score(observations_r, *log_score, plan.barrier_end);
+        BOOST_TEST(static_cast<torch::Tensor>(score_fit - score_r).abs().lt(1e-6).item<bool>());
+        auto parameters_fit = fit_models.at(r)->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
+        for (const auto& item : fit_r->named_parameters(/*recurse=*/true, /*include_fixed=*/false)) {
+            BOOST_TEST(static_cast<torch::Tensor>(parameters_fit[item.key()] - item.value()).abs().max().lt(1e-3).item<bool>());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_draw_replicate_observations_test) {
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx(0.0, 0.0);
+
+    int64_t num_paths = 37;
+    int64_t sample_size = 50;
+
+    seed_torch_rng();
+    auto serial = model->draw_replicate_observations(num_paths, sample_size, 20, 0.0, 1)["X"];
+    seed_torch_rng();
+    auto threaded = model->draw_replicate_observations(num_paths, sample_size, 20, 0.0, 4)["X"];
+    BOOST_TEST(serial.sizes() == torch::IntArrayRef({num_paths, sample_size}));
+    BOOST_TEST(torch::equal(serial, threaded));
+    BOOST_TEST(!serial.isnan().any().item<bool>());
+
+    seed_torch_rng();
+    auto one_path = model->draw_replicate_observations(1, sample_size, 20, 0.0)["X"];
+    seed_torch_rng();
+    auto single = model->draw_observations(sample_size, 20, 0.0)["X"];
+    BOOST_TEST(torch::equal(one_path.select(0, 0), single));
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_scores_missingness_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx(0.0, 0.0, torch::tensor({0.3, 0.1}, torch::kDouble), torch::Tensor());
+
+    auto x = torch::normal(0.0, 1.0, {2, 40}, c10::nullopt, torch::kDouble);
+    x.index_put_({0, 10}, missing::na);
+    x.index_put_({1, 25}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    auto log_score = ManufactureLogScore();
+    auto scores = log_score->score(*model->forward(observations), observations);
+    MissingnessIndex scores_missingness(scores);
+
+    // Each series loses its first two scores to the lags, and three more to each missing value.
+    BOOST_TEST(scores_missingness.sample_size() == 2*(40 - 2 - 3));
+    BOOST_TEST(torch::equal(scores_missingness.series_sample_sizes()["X"], torch::full({2}, 35, torch::kLong)));
+    BOOST_TEST(static_cast<torch::Tensor>(log_score->average(scores, scores_missingness) - log_score->average(scores)).abs().lt(1e-12).item<bool>());
+}
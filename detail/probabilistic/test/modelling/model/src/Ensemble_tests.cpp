@@ -0,0 +1,159 @@
+#include <boost/test/unit_test.hpp>
+#include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <libtorch_support/time_series.hpp>
+#include <modelling/distribution/Mixture.hpp>
+#include <modelling/model/ProbabilisticModule.hpp>
+#include <modelling/model/Ensemble.hpp>
+#include <modelling/score/LogScore.hpp>
+#include <modelling/score/ScoringRule.hpp>
+#include <modelling_test_support/models.hpp>
+#include <seed_torch_rng.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(ensemble_forward_batch_test) {
+    seed_torch_rng();
+
+    auto model = make_ensemble();
+
+    auto x = torch::normal(0.0, 1.0, {50}, c10::nullopt, torch::kDouble);
+    x.index_put_({12}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    // Each row perturbs the weights as well as the components, so each row
+    // of the batch mixes with its own weights.
+    int64_t num_draws = 3;
+    auto collapsed = perturbed_parameters(*model, num_draws);
+    BOOST_REQUIRE(collapsed.indices.contains(shapely_parameter_raw_name("weights")));
+
+    torch::NoGradGuard no_grad;
+    auto batch_observations = broadcast_batch(observations, num_draws);
+    auto batch_forecasts = model->forward_batch(collapsed, observations);
+    // The barrier on the weights is only defined once forward has set them.
+    auto batch_model = model->clone_batch(collapsed);
+    batch_model->forward(batch_observations);
+    auto batch_barrier = batch_model->barrier(batch_observations, 0.5)["X"];
+    auto log_density = batch_forecasts->log_density(batch_observations)["X"];
+    auto cdf = batch_forecasts->cdf(batch_observations)["X"];
+    BOOST_REQUIRE(log_density.sizes() == torch::IntArrayRef({num_draws, 50}));
+    BOOST_REQUIRE(cdf.sizes() == torch::IntArrayRef({num_draws, 50}));
+
+    for (int64_t i = 0; i != num_draws; ++i) {
+        auto model_i = clone_with_draw(*model, collapsed, i);
+        auto forecasts_i = model_i->forward(observations);
+        auto log_density_i = forecasts_i->log_density(observations)["X"];
+        auto cdf_i = forecasts_i->cdf(observations)["X"];
+        auto present = missing::is_present(log_density_i);
+        BOOST_TEST(static_cast<torch::Tensor>(present.eq(missing::is_present(log_density[i])).all()).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>((log_density[i] - log_density_i).masked_select(present).abs().max().lt(1e-12)).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>((cdf[i] - cdf_i).masked_select(present).abs().max().lt(1e-12)).item<bool>());
+
+        // The barriers are single precision.
+        auto barrier_i = model_i->barrier(observations, 0.5)["X"];
+        BOOST_TEST(static_cast<torch::Tensor>((batch_barrier[i] - barrier_i).abs().max().lt(1e-5)).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ensemble_update_fit_fixed_components_test) {
+    seed_torch_rng();
+
+    // The components are fixed, so only the weights are fit or updated.
+    auto model = make_ensemble(/*optimise_components=*/false);
+
+    auto x = torch::normal(0.0, 1.0, {120}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+    auto observations_before = SampleSplitter(100).in_sample(observations);
+    auto observations_after = SampleSplitter(101).in_sample(observations);
+
+    auto log_score = ManufactureLogScore();
+    FitPlan plan;
+    plan.barrier_begin = 1e-3;
+    plan.barrier_end = 1e-3;
+    plan.maximum_optimiser_iterations = 500;
+    model->fit(observations_before, log_score, plan, nullptr);
+
+    torch::OrderedDict<std::string, torch::Tensor> parameters_before;
+    for (const auto& item : model->named_parameters()) {
+        parameters_before.insert(item.key(), item.value().detach().clone());
+    }
+
+    BOOST_REQUIRE(model->update_fit(observations_after, 2));
+
+    auto weights_name = shapely_parameter_raw_name("weights");
+    for (const auto& item : model->named_parameters()) {
+        if (item.key() != weights_name) {
+            BOOST_TEST(torch::equal(item.value(), parameters_before[item.key()]));
+        }
+    }
+}
+
+// The log score, recording whether every forecast it scores is a fused
+// mixture of Normals.
+class MixtureOfNormalsRecordingLogScore : public ScoringRule {
+    public:
+        std::string name(void) const override {
+            return "MixtureOfNormalsRecordingLogScore";
+        }
+
+        torch::OrderedDict<std::string, torch::Tensor> score(
+            const Distribution& forecasts,
+            const torch::OrderedDict<std::string, torch::Tensor>& observations
+        ) const override {
+            ++num_scored;
+            all_mixtures_of_normals = all_mixtures_of_normals && is_mixture_of_normals(forecasts);
+            return log_score->score(forecasts, observations);
+        }
+
+        mutable int64_t num_scored = 0;
+        mutable bool all_mixtures_of_normals = true;
+
+    private:
+        std::shared_ptr<const ScoringRule> log_score = ManufactureLogScore();
+};
+
+BOOST_AUTO_TEST_CASE(ensemble_mixture_of_normals_test) {
+    seed_torch_rng();
+
+    auto x = torch::normal(0.0, 1.0, {60}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    FitPlan plan;
+    plan.maximum_optimiser_iterations = 20;
+
+    // With the components frozen, the fit mixes the cached component
+    // forecasts, which must still be fused, as must the forecasts after.
+    for (bool optimise_components : {true, false}) {
+        auto model = make_ensemble(optimise_components);
+        auto scoring_rule = std::make_shared<MixtureOfNormalsRecordingLogScore>();
+        model->fit(observations, scoring_rule, plan, nullptr);
+        BOOST_TEST(scoring_rule->num_scored > 0);
+        BOOST_TEST(scoring_rule->all_mixtures_of_normals);
+        BOOST_TEST(is_mixture_of_normals(*model->forward(observations)));
+    }
+
+    // At the cached observations, the mixtures of the cached components read
+    // the stacked component values from the cache, whatever their weights,
+    // rather than evaluating the Normal kernels again.
+    std::vector<std::shared_ptr<Distribution>> components = {
+        make_ararchtx()->forward(observations),
+        make_ararchtx(0.5, 0.1, torch::tensor({0.1}, torch::kDouble), torch::tensor({0.3}, torch::kDouble))->forward(observations)
+    };
+    auto cache = std::make_shared<MixtureComponentCache>(components, observations);
+    for (const auto& weights : {torch::tensor({0.4, 0.6}, torch::kDouble), torch::tensor({0.7, 0.3}, torch::kDouble)}) {
+        auto cached = ManufactureMixtureOfNormals(cache, weights);
+        auto uncached = ManufactureMixtureOfNormals(components, weights);
+        BOOST_TEST(is_mixture_of_normals(*cached));
+        BOOST_TEST(static_cast<torch::Tensor>(cached->log_density(observations)["X"] - uncached->log_density(observations)["X"]).abs().max().lt(1e-12).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>(cached->cdf(observations)["X"] - uncached->cdf(observations)["X"]).abs().max().lt(1e-12).item<bool>());
+    }
+    for (const auto& op_name : {"log_density", "cdf"}) {
+        bool restacked = false;
+        cache->stacked(op_name, [&restacked]() {
+            restacked = true;
+            return torch::OrderedDict<std::string, torch::Tensor>();
+        });
+        BOOST_TEST(!restacked);
+    }
+}
@@ -2,10 +2,21 @@
 #include <boost/test/data/test_case.hpp>
 #include <boost/test/data/monomorphic.hpp>
 #include <torch/torch.h>
+#include <libtorch_support/missing.hpp>
+#include <libtorch_support/moments.hpp>
+#include <libtorch_support/time_series.hpp>
+#include <modelling/functional/average_score.hpp>
+#include <modelling/functional/empirical_coverage.hpp>
+#include <modelling/functional/window_average.hpp>
 #include <modelling/model/ProbabilisticModule.hpp>
 #include <modelling/model/ARARCHTX.hpp>
+#include <modelling/model/AutoRegressive.hpp>
+#include <modelling/inference/ParameterDraws.hpp>
+#include <modelling/score/LogScore.hpp>
+#include <modelling_test_support/models.hpp>
 #include <seed_torch_rng.hpp>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 
 namespace bdata = boost::unit_test::data;
@@ -89,3 +100,185 @@ BOOST_DATA_TEST_CASE(generate_test, module_dataset(), model) {
 }
 */
 
+BOOST_AUTO_TEST_CASE(ararchtx_forward_batch_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {50}, c10::nullopt, torch::kDouble);
+    x.index_put_({12}, missing::na);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    int64_t num_draws = 3;
+    auto collapsed = perturbed_parameters(*model, num_draws);
+
+    torch::NoGradGuard no_grad;
+    auto log_density = model->forward_batch(collapsed, observations)->log_density(broadcast_batch(observations, num_draws))["X"];
+    BOOST_REQUIRE(log_density.sizes() == torch::IntArrayRef({num_draws, 50}));
+
+    ParameterDraws draws(*model, collapsed);
+    for (int64_t i = 0; i != num_draws; ++i) {
+        auto log_density_i = draws.module(i).forward(observations)->log_density(observations)["X"];
+        auto present = missing::is_present(log_density_i);
+        BOOST_TEST(static_cast<torch::Tensor>(present.eq(missing::is_present(log_density[i])).all()).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>((log_density[i] - log_density_i).masked_select(present).abs().max().lt(1e-12)).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(autoregressive_forward_batch_test) {
+    seed_torch_rng();
+
+    ShapelyParameter coefficients_guess = {torch::tensor({0.3, 0.2, 0.1}, torch::kDouble), -1.0, 1.0, 1.0, 1.0};
+    NamedShapelyParameters sp = {{
+        {"ar", coefficients_guess}
+    }};
+    auto ar = std::make_shared<AutoRegressive<Linear>>(sp, "ar");
+
+    int64_t num_draws = 4;
+    auto coefficients = torch::tensor({0.3, 0.2, 0.1}, torch::kDouble).unsqueeze(0).repeat({num_draws, 1})
+        + 0.05*torch::normal(0.0, 1.0, {num_draws, 3}, c10::nullopt, torch::kDouble);
+
+    auto x = torch::normal(0.0, 1.0, {40}, c10::nullopt, torch::kDouble);
+    x.index_put_({17}, missing::na);
+
+    torch::NoGradGuard no_grad;
+    auto batch_ar = std::dynamic_pointer_cast<AutoRegressive<Linear>>(ar->clone());
+    batch_ar->named_parameters()[shapely_parameter_raw_name("ar")].set_data(coefficients.clone());
+    auto batch_mean = batch_ar->forward(x.unsqueeze(0).expand({num_draws, 40}));
+    BOOST_REQUIRE(batch_mean.sizes() == torch::IntArrayRef({num_draws, 40}));
+
+    for (int64_t i = 0; i != num_draws; ++i) {
+        auto ar_i = std::dynamic_pointer_cast<AutoRegressive<Linear>>(ar->clone());
+        ar_i->named_parameters()[shapely_parameter_raw_name("ar")].set_data(coefficients[i].clone());
+        auto mean_i = ar_i->forward(x);
+        auto present = missing::is_present(mean_i);
+        BOOST_TEST(static_cast<torch::Tensor>(present.eq(missing::is_present(batch_mean[i])).all()).item<bool>());
+        BOOST_TEST(static_cast<torch::Tensor>((batch_mean[i] - mean_i).masked_select(present).abs().max().lt(1e-12)).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_window_average_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {80}, c10::nullopt, torch::kDouble);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+
+    FitPlan plan;
+    plan.maximum_optimiser_iterations = 20;
+    model->fit(observations, ManufactureLogScore(), plan, nullptr);
+
+    // Forecasting only up to the time the functional reads gives the same
+    // forecasts there, so the same coverage, as forecasting all times.
+    auto functional = [](
+        const Distribution& forecast_distributions,
+        const torch::OrderedDict<std::string, torch::Tensor>& observations,
+        const SampleSplitter& splitter
+    ) {
+        return splitter.h_steps_ahead(forecast_distributions.cdf(observations), 1)[0].value();
+    };
+    auto all_times = expanding_window_average(functional, model, observations, 72, -1, -1, 1);
+    auto read_times = expanding_window_average(functional, model, observations, 72, -1, 1, 1);
+    BOOST_TEST(static_cast<torch::Tensor>(all_times - read_times).abs().lt(1e-12).item<bool>());
+
+    // The origins are split into chains of chain_length origins whatever the
+    // number of threads, so spreading the chains over threads, with or without
+    // Newton updates between full refits, gives the same fits at every origin.
+    int64_t chain_length = 3;
+    for (int64_t refit_every : {1, 3}) {
+        auto serial = expanding_window_average(functional, model, observations, 72, -1, 1, 1, refit_every, 1, chain_length);
+        for (int64_t num_threads : {2, 3}) {
+            auto threaded = expanding_window_average(functional, model, observations, 72, -1, 1, num_threads, refit_every, 1, chain_length);
+            BOOST_TEST(static_cast<torch::Tensor>(serial - threaded).abs().lt(1e-12).item<bool>());
+        }
+    }
+    auto coverage_serial = empirical_coverage_expanding_window(model, observations, 0.05, 0.95, false, 72, -1, 1, 1, 1, chain_length);
+    auto coverage_threaded = empirical_coverage_expanding_window(model, observations, 0.05, 0.95, false, 72, -1, 2, 1, 1, chain_length);
+    BOOST_TEST(torch::equal(coverage_serial, coverage_threaded));
+
+    // Rolling windows, with one result for each origin T from the window size
+    // on, each from a fit to the times in [T - window_size, T) only, warm
+    // started from the fit to the window before. The functional also reports
+    // the length and first time of its window.
+    int64_t window_size = 70;
+    auto num_origins = 80 - window_size;
+    auto window_functional = [&](
+        const Distribution& forecast_distributions,
+        const torch::OrderedDict<std::string, torch::Tensor>& observations,
+        const SampleSplitter& splitter
+    ) {
+        auto window = splitter.in_sample(observations)[0].value();
+        return torch::stack({
+            torch::full({}, window.size(-1), torch::kDouble),
+            window[0],
+            functional(forecast_distributions, observations, splitter).reshape({})
+        });
+    };
+    torch::Tensor per_origin;
+    auto rolling = rolling_window_average(window_functional, model, observations, window_size, &per_origin, -1, 1, 2);
+    BOOST_REQUIRE(per_origin.sizes() == torch::IntArrayRef({num_origins, 3}));
+    BOOST_TEST(static_cast<torch::Tensor>(rolling - average(per_origin)).abs().lt(1e-12).item<bool>());
+
+    torch::Tensor coverage_per_origin;
+    auto rolling_coverage = empirical_coverage_rolling_window(model, observations, 0.05, 0.95, false, window_size, &coverage_per_origin);
+    BOOST_REQUIRE(coverage_per_origin.sizes() == torch::IntArrayRef({num_origins}));
+    BOOST_TEST(static_cast<torch::Tensor>(rolling_coverage - average(coverage_per_origin)).abs().lt(1e-12).item<bool>());
+
+    auto log_score = ManufactureLogScore();
+    torch::Tensor score_per_origin;
+    auto rolling_score = average_score_rolling_window(model, observations, log_score, window_size, &score_per_origin);
+    BOOST_REQUIRE(score_per_origin.sizes() == torch::IntArrayRef({num_origins}));
+    BOOST_TEST(static_cast<torch::Tensor>(rolling_score - average(score_per_origin)).abs().lt(1e-12).item<bool>());
+
+    // One chain, so each window is fit from the fit to the window before, and
+    // the first from the parameters of model.
+    auto manual = model->clone_probabilistic_module();
+    for (int64_t i = 0; i != num_origins; ++i) {
+        auto T = window_size + i;
+        BOOST_TEST(per_origin[i][0].item<double>() == window_size);
+        BOOST_TEST(per_origin[i][1].item<double>() == x[T - window_size].item<double>());
+
+        auto window_observations = SampleSplitter(T - window_size).out_of_sample(SampleSplitter(T + 2).in_sample(observations));
+        SampleSplitter splitter(window_size);
+        manual->fit(splitter.in_sample(window_observations), model->scoring_rule(), model->fit_plan(), nullptr);
+        auto forecasts = manual->forward(window_observations);
+        auto expected = functional(*forecasts, window_observations, splitter);
+        BOOST_TEST(static_cast<torch::Tensor>(per_origin[i][2] - expected).abs().lt(1e-8).item<bool>());
+        auto expected_score = log_score->average(splitter.h_steps_ahead(log_score->score(*forecasts, window_observations), 1));
+        BOOST_TEST(static_cast<torch::Tensor>(score_per_origin[i] - expected_score).abs().lt(1e-8).item<bool>());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ararchtx_update_fit_test) {
+    seed_torch_rng();
+
+    std::shared_ptr<ProbabilisticModule> model = make_ararchtx();
+
+    auto x = torch::normal(0.0, 1.0, {120}, c10::nullopt, torch::kDouble);
+    SampleSplitter splitter(100);
+    torch::OrderedDict<std::string, torch::Tensor> observations = {{"X", x}};
+    auto observations_before = splitter.in_sample(observations);
+    auto observations_after = SampleSplitter(101).in_sample(observations);
+
+    auto log_score = ManufactureLogScore();
+    FitPlan plan;
+    plan.barrier_begin = 1e-3;
+    plan.barrier_end = 1e-3;
+    plan.maximum_optimiser_iterations = 500;
+    model->fit(observations_before, log_score, plan, nullptr);
+
+    // Newton steps from the fit to one observation fewer land close to a full refit.
+    auto updated = model->clone_probabilistic_module();
+    auto score_before = log_score->average(*updated->forward(observations_after), observations_after, updated->barrier(observations_after, plan.barrier_end));
+    BOOST_REQUIRE(updated->update_fit(observations_after, 2));
+    auto score_after = log_score->average(*updated->forward(observations_after), observations_after, updated->barrier(observations_after, plan.barrier_end));
+    BOOST_TEST(static_cast<torch::Tensor>(score_after - score_before).gt(-1e-10).item<bool>());
+
+    auto refit = model->clone_probabilistic_module();
+    refit->fit(observations_after, log_score, plan, nullptr);
+    auto updated_parameters = updated->named_parameters(/*recurse=*/true, /*include_fixed=*/false);
+    for (const auto& item : refit->named_parameters(/*recurse=*/true, /*include_fixed=*/false)) {
+        BOOST_TEST(static_cast<torch::Tensor>(updated_parameters[item.key()] - item.value()).abs().max().lt(1e-3).item<bool>());
+    }
+}